@@ -37,6 +37,7 @@
 #include <math.h>
 #include <vector>
 #include <queue>
+#include <algorithm>
 #include "../ssd.h"
 
 using namespace ssd;
@@ -64,6 +65,23 @@ LogPageBlock::~LogPageBlock()
 	delete [] aPages;
 }
 
+/* The list link is not stored, FTLs that chain log blocks relink them */
+void LogPageBlock::save(Snapshot &snapshot) const
+{
+	snapshot.write(pages, BLOCK_SIZE * sizeof(int));
+	snapshot.write(aPages, BLOCK_SIZE * sizeof(long));
+	snapshot.put(address);
+	snapshot.put(numPages);
+}
+
+void LogPageBlock::load(Snapshot &snapshot)
+{
+	snapshot.read(pages, BLOCK_SIZE * sizeof(int));
+	snapshot.read(aPages, BLOCK_SIZE * sizeof(long));
+	snapshot.get(address);
+	snapshot.get(numPages);
+}
+
 /* Comparison class for use by FTL to sort the LogPageBlock compared to the number of pages written. */
 bool LogPageBlock::operator() (const LogPageBlock& lhs, const LogPageBlock& rhs) const
 {
@@ -71,7 +89,8 @@ bool LogPageBlock::operator() (const LogPageBlock& lhs, const LogPageBlock& rhs)
 }
 
 FtlImpl_Bast::FtlImpl_Bast(Controller &controller):
-	FtlParent(controller)
+	FtlParent(controller),
+	random(1)
 {
 
 	// Detect required number of bits for logical address size
@@ -87,6 +106,10 @@ FtlImpl_Bast::FtlImpl_Bast(Controller &controller):
 	for (uint i=0;i<NUMBER_OF_ADDRESSABLE_BLOCKS;i++)
 		data_list[i] = -1;
 
+	data_list_memory = add_memory("data block map");
+	set_memory(data_list_memory, NUMBER_OF_ADDRESSABLE_BLOCKS * MAP_ENTRY_BYTES);
+	log_map_memory = add_memory("log block maps");
+
 	printf("Total mapping table size: %luKB\n", NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(uint) / 1024);
 	printf("Using BAST FTL.\n");
 }
@@ -163,7 +186,7 @@ enum status FtlImpl_Bast::write(Event &event)
 		controller.get_free_page(logBlockAddress);
 		event.set_address(logBlockAddress);
 	} else {
-		if (!is_sequential(logBlock, lba, event))
+		if (!is_sequential(logBlock, lba, event) && !partial_merge(logBlock, lba, event))
 			random_merge(logBlock, lba, event);
 
 		allocate_new_logblock(logBlock, lba, event);
@@ -193,53 +216,75 @@ enum status FtlImpl_Bast::write(Event &event)
 
 enum status FtlImpl_Bast::trim(Event &event)
 {
-	// Find block
-	long lookupBlock = (event.get_logical_address() >> addressShift);
-	Address eventAddress = Address(event.get_logical_address(), PAGE);
-
-	LogPageBlock *logBlock = NULL;
-	if (log_map.find(lookupBlock) != log_map.end())
-		logBlock = log_map[lookupBlock];
-
-	controller.stats.numMemoryRead++;
+	ulong start = event.get_logical_address();
+	ulong end = start + event.get_size();
 
 	Address returnAddress;
 
-	if (logBlock != NULL && logBlock->pages[eventAddress.page] != -1) // If page is in the log block
+	// Handle the extent one logical block at a time.
+	for (ulong blockStart = start - start % BLOCK_SIZE; blockStart < end; blockStart += BLOCK_SIZE)
 	{
-		returnAddress = Address(logBlock->address.get_linear_address()+logBlock->pages[eventAddress.page], PAGE);
-		Block *lBlock = controller.get_block_pointer(returnAddress);
-		lBlock->invalidate_page(returnAddress.page);
+		ulong first = std::max(start, blockStart);
+		ulong last = std::min(end, blockStart + BLOCK_SIZE);
 
-		logBlock->pages[eventAddress.page] = -1; // Reset the mapping
+		// Find block
+		long lookupBlock = (blockStart >> addressShift);
 
-		if (lBlock->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
-		{
-			dispose_logblock(logBlock, lookupBlock);
-			Block_manager::instance()->erase_and_invalidate(event, returnAddress, LOG);
-		}
-
-	}
+		LogPageBlock *logBlock = NULL;
+		if (log_map.find(lookupBlock) != log_map.end())
+			logBlock = log_map[lookupBlock];
 
-	if (data_list[lookupBlock] != -1) // Datablock
-	{
-		Address dataAddress = Address(data_list[lookupBlock]+event.get_logical_address() % BLOCK_SIZE , PAGE);
-		Block *dBlock = controller.get_block_pointer(dataAddress);
-		dBlock->invalidate_page(dataAddress.page);
+		controller.stats.numMemoryRead++;
 
-		if (dBlock->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
+		if (last - first == BLOCK_SIZE) // The whole block is trimmed, erase its log and data block directly.
 		{
-			data_list[lookupBlock] = -1;
-			Block_manager::instance()->erase_and_invalidate(event, dataAddress, DATA);
+			if (logBlock != NULL)
+			{
+				Address logAddress = logBlock->address;
+				dispose_logblock(logBlock, lookupBlock);
+				Block_manager::instance()->erase_and_invalidate(event, logAddress, LOG);
+			}
+
+			if (data_list[lookupBlock] != -1)
+			{
+				Address dataAddress = Address(data_list[lookupBlock], BLOCK);
+				data_list[lookupBlock] = -1;
+				Block_manager::instance()->erase_and_invalidate(event, dataAddress, DATA);
+			}
+
+			continue;
 		}
 
+		for (ulong lpn=first;lpn<last;lpn++)
+		{
+			uint offset = lpn % BLOCK_SIZE;
+
+			if (logBlock != NULL && logBlock->pages[offset] != -1) // If page is in the log block
+			{
+				returnAddress = Address(logBlock->address.get_linear_address()+logBlock->pages[offset], PAGE);
+				logBlock->pages[offset] = -1; // Reset the mapping
+
+				if (trim_page(event, returnAddress, LOG))
+				{
+					dispose_logblock(logBlock, lookupBlock);
+					logBlock = NULL;
+				}
+			}
+
+			// Datablock, only written pages. Empty ones still take in-place writes.
+			if (data_list[lookupBlock] != -1 && controller.get_state(Address(data_list[lookupBlock]+offset, PAGE)) == VALID)
+			{
+				if (trim_page(event, Address(data_list[lookupBlock]+offset, PAGE), DATA))
+					data_list[lookupBlock] = -1;
+			}
+		}
 	}
 
 	event.set_address(returnAddress);
 	event.set_noop(true);
 
 	// Statistics
-	controller.stats.numFTLTrim++;
+	controller.stats.numFTLTrim += event.get_size();
 
 	return controller.issue(event);
 }
@@ -249,7 +294,7 @@ void FtlImpl_Bast::allocate_new_logblock(LogPageBlock *logBlock, long lba, Event
 {
 	if (log_map.size() >= BAST_LOG_BLOCK_LIMIT)
 	{
-		int victim = random()%log_map.size()-1;
+		int victim = random.below(log_map.size())-1;
 		std::map<long, LogPageBlock*>::iterator it = log_map.begin();
 
 		for (int i=0;i<victim;i++)
@@ -258,7 +303,7 @@ void FtlImpl_Bast::allocate_new_logblock(LogPageBlock *logBlock, long lba, Event
 		long exLogicalBlock = (*it).first;
 		LogPageBlock *exLogBlock = (*it).second;
 
-		if (!is_sequential(exLogBlock, exLogicalBlock, event))
+		if (!is_sequential(exLogBlock, exLogicalBlock, event) && !partial_merge(exLogBlock, exLogicalBlock, event))
 			random_merge(exLogBlock, exLogicalBlock, event);
 
 		controller.stats.numPageBlockToPageConversion++;
@@ -269,12 +314,14 @@ void FtlImpl_Bast::allocate_new_logblock(LogPageBlock *logBlock, long lba, Event
 
 	//printf("Using new log block with address: %lu Block: %u\n", logBlock->address.get_linear_address(), logBlock->address.block);
 	log_map[lba] = logBlock;
+	set_memory(log_map_memory, log_map.size() * (2 + BLOCK_SIZE) * MAP_ENTRY_BYTES);
 }
 
 void FtlImpl_Bast::dispose_logblock(LogPageBlock *logBlock, long lba)
 {
 	log_map.erase(lba);
 	delete logBlock;
+	set_memory(log_map_memory, log_map.size() * (2 + BLOCK_SIZE) * MAP_ENTRY_BYTES);
 }
 
 bool FtlImpl_Bast::is_sequential(LogPageBlock* logBlock, long lba, Event &event)
@@ -294,6 +341,8 @@ bool FtlImpl_Bast::is_sequential(LogPageBlock* logBlock, long lba, Event &event)
 
 	if (isSequential)
 	{
+		double start = event.get_time_taken();
+
 		Block_manager::instance()->promote_block(DATA);
 
 		// Add to empty list i.e. switch without erasing the datablock.
@@ -306,13 +355,67 @@ bool FtlImpl_Bast::is_sequential(LogPageBlock* logBlock, long lba, Event &event)
 		data_list[lba] = logBlock->address.get_linear_address();
 		dispose_logblock(logBlock, lba);
 
-		controller.stats.numLogMergeSwitch++;
 		update_map_block(event);
+		controller.stats.add_merge(MERGE_SWITCH, event.get_time_taken() - start);
 	}
 
 	return isSequential;
 }
 
+bool FtlImpl_Bast::partial_merge(LogPageBlock *logBlock, long lba, Event &event)
+{
+	/* Partial merge is possible when the log block holds an in-place written
+	 * prefix of the logical block. i.e. page i at offset i for the first pages
+	 * and nothing written after them.
+	 * 1. Copy the remaining valid data block pages into the log block at their offsets.
+	 * 2. Erase the data block.
+	 * 3. Promote the log block as data block.
+	 */
+	uint numPages = 0;
+	while (numPages < BLOCK_SIZE && logBlock->pages[numPages] == (int)numPages)
+		numPages++;
+
+	if (numPages == 0 || numPages == BLOCK_SIZE || controller.get_num_valid(&logBlock->address) != numPages)
+		return false;
+
+	for (uint i=numPages;i<BLOCK_SIZE;i++)
+		if (logBlock->pages[i] != -1)
+			return false;
+
+	double start = event.get_time_taken();
+
+	if (data_list[lba] != -1)
+	{
+		for (uint i=numPages;i<BLOCK_SIZE;i++)
+		{
+			Address readAddress = Address(data_list[lba] + i, PAGE);
+			if (controller.get_state(readAddress) != VALID)
+				continue;
+
+			if (copy_page(event, readAddress, Address(logBlock->address.get_linear_address() + i, PAGE), true) == FAILURE) { assert(false); }
+
+			// Statistics
+			controller.stats.numFTLRead++;
+			controller.stats.numFTLWrite++;
+			controller.stats.numGCRead++;
+			controller.stats.numGCWrite++;
+		}
+
+		Address a = Address(data_list[lba], PAGE);
+		Block_manager::instance()->erase_and_invalidate(event, a, DATA);
+	}
+
+	Block_manager::instance()->promote_block(DATA);
+
+	data_list[lba] = logBlock->address.get_linear_address();
+	dispose_logblock(logBlock, lba);
+
+	update_map_block(event);
+	controller.stats.add_merge(MERGE_PARTIAL, event.get_time_taken() - start);
+
+	return true;
+}
+
 bool FtlImpl_Bast::random_merge(LogPageBlock *logBlock, long lba, Event &event)
 {
 	/* Do merge (n reads, n writes and 2 erases (gc'ed))
@@ -325,7 +428,8 @@ bool FtlImpl_Bast::random_merge(LogPageBlock *logBlock, long lba, Event &event)
 	 * 6. put data and log block into the invalidate list.
 	 */
 
-	Address eventAddress = Address(event.get_logical_address(), PAGE);
+	double start = event.get_time_taken();
+
 	Address newDataBlock = Block_manager::instance()->get_free_block(DATA, event);
 
 	int t=0;
@@ -346,23 +450,13 @@ bool FtlImpl_Bast::random_merge(LogPageBlock *logBlock, long lba, Event &event)
 		if (controller.get_state(readAddress) == INVALID) // A page might be invalidated by trim
 			continue;
 
-		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
-		readEvent.set_address(readAddress);
-		controller.issue(readEvent);
-
-		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
-		writeEvent.set_address(Address(newDataBlock.get_linear_address() + i, PAGE));
-		writeEvent.set_payload((char*)page_data + readAddress.get_linear_address() * PAGE_SIZE);
-		writeEvent.set_replace_address(readAddress);
-		controller.issue(writeEvent);
+		if (copy_page(event, readAddress, Address(newDataBlock.get_linear_address() + i, PAGE), true) == FAILURE) { assert(false); }
 
-		//event.consolidate_metaevent(writeEvent);
-		event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken());
 		// Statistics
 		controller.stats.numFTLRead++;
 		controller.stats.numFTLWrite++;
-		controller.stats.numWLRead++;
-		controller.stats.numWLWrite++;
+		controller.stats.numGCRead++;
+		controller.stats.numGCWrite++;
 		t++;
 	}
 
@@ -384,27 +478,91 @@ bool FtlImpl_Bast::random_merge(LogPageBlock *logBlock, long lba, Event &event)
 
 	dispose_logblock(logBlock, lba);
 
-	controller.stats.numLogMergeFull++;
+	controller.stats.add_merge(MERGE_FULL, event.get_time_taken() - start);
 	return true;
 }
 
 void FtlImpl_Bast::update_map_block(Event &event)
 {
-	Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time());
+	Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_sub_event_time());
 	writeEvent.set_address(Address(0, PAGE));
 	writeEvent.set_noop(true);
 
 	controller.issue(writeEvent);
 
-	event.incr_time_taken(writeEvent.get_time_taken());
+	event.incr_time_taken(writeEvent.get_time_taken(), COMPONENT_MAPPING);
 
 	controller.stats.numGCWrite++;
 	controller.stats.numFTLWrite++;
 }
 
 
+/*
+ * Builds the state after the log blocks of a fill have been merged: every
+ * written logical block has a data block holding its pages at their offsets,
+ * and no log blocks are in use.
+ */
+enum status FtlImpl_Bast::precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed)
+{
+	std::vector<ulong> order;
+	if (precondition_order(pattern, fill_fraction, seed, order) == FAILURE)
+		return FAILURE;
+
+	Event event = Event(WRITE, 0, 1, 0.0);
+	for (ulong i = 0; i < order.size(); i++)
+	{
+		long lba = order[i] >> addressShift;
+
+		if (data_list[lba] == -1)
+			data_list[lba] = Block_manager::instance()->get_free_block(DATA, event).get_linear_address();
+
+		precondition_page(Address(data_list[lba] + order[i] % BLOCK_SIZE, PAGE));
+	}
+	return SUCCESS;
+}
+
 void FtlImpl_Bast::print_ftl_statistics()
 {
 	Block_manager::instance()->print_statistics();
 }
 
+void FtlImpl_Bast::get_host_memory(std::vector<Ftl_memory> &usage) const
+{
+	usage[data_list_memory].host = NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(long);
+	usage[log_map_memory].host = log_map.size() * (MAP_NODE_BYTES + sizeof(std::pair<const long, LogPageBlock*>) + sizeof(LogPageBlock) + BLOCK_SIZE * (sizeof(int) + sizeof(long)));
+}
+
+
+void FtlImpl_Bast::save(Snapshot &snapshot) const
+{
+	snapshot.write(data_list, NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(long));
+	snapshot.put((ulong) log_map.size());
+	for (std::map<long, LogPageBlock*>::const_iterator it = log_map.begin(); it != log_map.end(); ++it)
+	{
+		snapshot.put(it->first);
+		it->second->save(snapshot);
+	}
+	snapshot.put(random);
+}
+
+void FtlImpl_Bast::load(Snapshot &snapshot)
+{
+	snapshot.read(data_list, NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(long));
+
+	for (std::map<long, LogPageBlock*>::iterator it = log_map.begin(); it != log_map.end(); ++it)
+		delete it->second;
+	log_map.clear();
+
+	ulong count = 0;
+	snapshot.get(count);
+	for (ulong i = 0; i < count && snapshot.good(); i++)
+	{
+		long lba;
+		snapshot.get(lba);
+		LogPageBlock *logBlock = new LogPageBlock();
+		logBlock->load(snapshot);
+		log_map[lba] = logBlock;
+	}
+	snapshot.get(random);
+	set_memory(log_map_memory, log_map.size() * (2 + BLOCK_SIZE) * MAP_ENTRY_BYTES);
+}
@@ -34,6 +34,7 @@
 #include <math.h>
 #include <vector>
 #include <queue>
+#include <algorithm>
 #include <iostream>
 #include "../ssd.h"
 
@@ -50,10 +51,16 @@ FtlImpl_BDftl::FtlImpl_BDftl(Controller &controller):
 	FtlImpl_DftlParent(controller)
 {
 	block_map = new BPage[NUMBER_OF_ADDRESSABLE_BLOCKS];
-	trim_map = new bool[NUMBER_OF_ADDRESSABLE_BLOCKS*BLOCK_SIZE];
+	trim_map.assign(NUMBER_OF_ADDRESSABLE_BLOCKS*BLOCK_SIZE, false);
 
 	inuseBlock = NULL;
 
+	// A block map entry holds the PBN, the next page and the optimal flag
+	block_map_memory = add_memory("block map");
+	set_memory(block_map_memory, NUMBER_OF_ADDRESSABLE_BLOCKS * (MAP_ENTRY_BYTES + 2));
+	trim_map_memory = add_memory("trim map");
+	set_memory(trim_map_memory, trim_map.size() / 8);
+
 	printf("Using BDFTL.\n");
 }
 
@@ -62,7 +69,6 @@ FtlImpl_BDftl::FtlImpl_BDftl(Controller &controller):
 FtlImpl_BDftl::~FtlImpl_BDftl(void)
 {
 	delete[] block_map;
-	delete[] trim_map;
 	return;
 }
 
@@ -97,7 +103,7 @@ enum status FtlImpl_BDftl::read(Event &event)
 		}
 	}
 
-	event.incr_time_taken(RAM_READ_DELAY*2);
+	event.incr_time_taken(RAM_READ_DELAY*2, COMPONENT_MAPPING);
 	controller.stats.numMemoryRead += 2; // Block-level lookup + range check
 	controller.stats.numFTLRead++; // Page read
 
@@ -129,7 +135,7 @@ enum status FtlImpl_BDftl::write(Event &event)
 			if (block_map[dlbn].nextPage == dppn)
 			{
 				controller.stats.numMemoryWrite++; // Update next page
-				event.incr_time_taken(RAM_WRITE_DELAY);
+				event.incr_time_taken(RAM_WRITE_DELAY, COMPONENT_MAPPING);
 				event.set_address(Address(block_map[dlbn].pbn + dppn, PAGE));
 				block_map[dlbn].nextPage++;
 				handled = true;
@@ -167,15 +173,16 @@ enum status FtlImpl_BDftl::write(Event &event)
 						trans_map.replace(trans_map.begin()+startAdr+i, current);
 
 						cmt++;
+						update_cmt_memory();
 
-						event.incr_time_taken(RAM_WRITE_DELAY);
+						event.incr_time_taken(RAM_WRITE_DELAY, COMPONENT_MAPPING);
 						controller.stats.numMemoryWrite++;
 					}
 
 				}
 
 				// 4. Set block to non optimal
-				event.incr_time_taken(RAM_WRITE_DELAY);
+				event.incr_time_taken(RAM_WRITE_DELAY, COMPONENT_MAPPING);
 				controller.stats.numMemoryWrite++;
 				block_map[dlbn].optimal = false;
 
@@ -219,7 +226,7 @@ enum status FtlImpl_BDftl::write(Event &event)
 	}
 
 	controller.stats.numMemoryRead += 3; // Block-level lookup + range check + optimal check
-	event.incr_time_taken(RAM_READ_DELAY*3);
+	event.incr_time_taken(RAM_READ_DELAY*3, COMPONENT_MAPPING);
 	controller.stats.numFTLWrite++; // Page writes
 
 	return controller.issue(event);
@@ -270,72 +277,107 @@ long FtlImpl_BDftl::get_free_biftl_page(Event &event)
 
 enum status FtlImpl_BDftl::trim(Event &event)
 {
-	uint dlpn = event.get_logical_address();
-	uint dlbn = dlpn / BLOCK_SIZE;
-
-	// Update trim map
-	trim_map[dlpn] = true;
+	ulong start = event.get_logical_address();
+	ulong end = start + event.get_size();
 
-	// Block-level lookup
-	if (block_map[dlbn].optimal)
+	// Handle the extent one logical block at a time.
+	for (ulong addressStart = start - start % BLOCK_SIZE; addressStart < end; addressStart += BLOCK_SIZE)
 	{
-		Address address = Address(block_map[dlbn].pbn+event.get_logical_address()%BLOCK_SIZE, PAGE);
-		Block *block = controller.get_block_pointer(address);
-		block->invalidate_page(address.page);
+		ulong first = std::max(start, addressStart);
+		ulong last = std::min(end, addressStart + BLOCK_SIZE);
+		uint dlbn = addressStart / BLOCK_SIZE;
 
-		if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
-		{
-			block_map[dlbn].pbn = -1;
-			block_map[dlbn].nextPage = 0;
-			Block_manager::instance()->erase_and_invalidate(event, address, DATA);
-		}
-	} else { // DFTL lookup
+		// Update trim map
+		for (ulong dlpn=first;dlpn<last;dlpn++)
+			trim_map[dlpn] = true;
 
-		MPage current = trans_map[dlpn];
-		if (current.ppn != -1)
+		// Block-level lookup
+		if (block_map[dlbn].optimal)
 		{
-			Address address = Address(current.ppn, PAGE);
-			Block *block = controller.get_block_pointer(address);
-			block->invalidate_page(address.page);
+			if (block_map[dlbn].pbn != -1u)
+			{
+				bool erased = false;
 
-			evict_specific_page_from_cache(event, dlpn);
+				if (last - first == BLOCK_SIZE)
+				{
+					// The whole block is trimmed, erase it without touching its pages.
+					Address address = Address(block_map[dlbn].pbn, BLOCK);
+					Block_manager::instance()->erase_and_invalidate(event, address, DATA);
+					erased = true;
+				}
+				else
+				{
+					// Pages from nextPage on are still empty and are written in order later.
+					ulong written = std::min(last, addressStart + block_map[dlbn].nextPage);
+					for (ulong dlpn=first;dlpn<written && !erased;dlpn++)
+						erased = trim_page(event, Address(block_map[dlbn].pbn+dlpn%BLOCK_SIZE, PAGE), DATA);
+
+					// Every written page is trimmed, so retire the block. Its empty
+					// pages cannot take the trimmed offsets again.
+					Address address = Address(block_map[dlbn].pbn, BLOCK);
+					Block *block = controller.get_block_pointer(address);
+					if (!erased && block->get_pages_valid() == block->get_pages_invalid())
+					{
+						Block_manager::instance()->erase_and_invalidate(event, address, DATA);
+						erased = true;
+					}
+				}
 
-			// Update translation map to default values.
-			update_translation_map(current, -1);
-			trans_map.replace(trans_map.begin()+dlpn, current);
+				if (erased)
+				{
+					block_map[dlbn].pbn = -1;
+					block_map[dlbn].nextPage = 0;
+				}
+			}
+		} else { // DFTL lookup
 
-			event.incr_time_taken(RAM_READ_DELAY);
-			event.incr_time_taken(RAM_WRITE_DELAY);
-			controller.stats.numMemoryRead++;
-			controller.stats.numMemoryWrite++;
-		}
+			for (ulong dlpn=first;dlpn<last;dlpn++)
+			{
+				MPage current = trans_map[dlpn];
+				if (current.ppn == -1)
+					continue;
 
-		// Update trim map and update block map if all pages are trimmed. i.e. the state are reseted to optimal.
-		long addressStart = dlpn - dlpn % BLOCK_SIZE;
-		bool allTrimmed = true;
-		for (uint i=addressStart;i<addressStart+BLOCK_SIZE;i++)
-		{
-			if (!trim_map[i])
-				allTrimmed = false;
-		}
+				trim_page(event, Address(current.ppn, PAGE), DATA);
 
-		controller.stats.numMemoryRead++; // Trim map looping
+				evict_specific_page_from_cache(event, dlpn);
 
-		if (allTrimmed)
-		{
-			block_map[dlbn].pbn = -1;
-			block_map[dlbn].nextPage = 0;
-			block_map[dlbn].optimal = true;
-			controller.stats.numMemoryWrite++; // Update block_map.
+				// Update translation map to default values.
+				update_translation_map(current, -1);
+				trans_map.replace(trans_map.begin()+dlpn, current);
+
+				event.incr_time_taken(RAM_READ_DELAY, COMPONENT_MAPPING);
+				event.incr_time_taken(RAM_WRITE_DELAY, COMPONENT_MAPPING);
+				controller.stats.numMemoryRead++;
+				controller.stats.numMemoryWrite++;
+			}
+
+			// Update trim map and update block map if all pages are trimmed. i.e. the state are reseted to optimal.
+			bool allTrimmed = true;
+			for (ulong i=addressStart;i<addressStart+BLOCK_SIZE;i++)
+			{
+				if (!trim_map[i])
+					allTrimmed = false;
+			}
+
+			controller.stats.numMemoryRead++; // Trim map looping
+
+			if (allTrimmed)
+			{
+				block_map[dlbn].pbn = -1;
+				block_map[dlbn].nextPage = 0;
+				block_map[dlbn].optimal = true;
+				controller.stats.numMemoryWrite++; // Update block_map.
+			}
 		}
+
+		event.incr_time_taken(RAM_READ_DELAY*2, COMPONENT_MAPPING);
+		controller.stats.numMemoryRead += 2; // Block-level lookup + range check
 	}
 
 	event.set_address(Address(0, PAGE));
 	event.set_noop(true);
 
-	event.incr_time_taken(RAM_READ_DELAY*2);
-	controller.stats.numMemoryRead += 2; // Block-level lookup + range check
-	controller.stats.numFTLTrim++; // Page trim
+	controller.stats.numFTLTrim += event.get_size(); // Page trims
 
 	return controller.issue(event);
 }
@@ -351,31 +393,14 @@ void FtlImpl_BDftl::cleanup_block(Event &event, Block *block)
 	for (uint i=0;i<BLOCK_SIZE;i++)
 	{
 		assert(block->get_state(i) != EMPTY);
-		// When valid, two events are create, one for read and one for write. They are chained and the controller are
-		// called to execute them. The execution time is then added to the real event.
+		// When valid, the page is moved to the GC block of its plane. The
+		// execution time is then added to the real event.
 		if (block->get_state(i) == VALID)
 		{
-			// Set up events.
-			Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
-			readEvent.set_address(Address(block->get_physical_address()+i, PAGE));
-
-			// Execute read event
-			if (controller.issue(readEvent) == FAILURE)
-				printf("Data block copy failed.");
+			Address victimAddress = Address(block->get_physical_address()+i, PAGE);
+			Address dataBlockAddress = Address(get_free_gc_page(event, victimAddress), PAGE);
 
-			// Get new address to write to and invalidate previous
-			Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
-			Address dataBlockAddress = Address(get_free_data_page(event, false), PAGE);
-			writeEvent.set_address(dataBlockAddress);
-			writeEvent.set_replace_address(Address(block->get_physical_address()+i, PAGE));
-
-			// Setup the write event to read from the right place.
-			writeEvent.set_payload((char*)page_data + (block->get_physical_address()+i) * PAGE_SIZE);
-
-			if (controller.issue(writeEvent) == FAILURE)
-				printf("Data block copy failed.");
-
-			event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken());
+			if (copy_page(event, victimAddress, dataBlockAddress, true) == FAILURE) { assert(false); }
 
 			// Update GTD
 			long dataPpn = dataBlockAddress.get_linear_address();
@@ -387,8 +412,8 @@ void FtlImpl_BDftl::cleanup_block(Event &event, Block *block)
 			// Statistics
 			controller.stats.numFTLRead++;
 			controller.stats.numFTLWrite++;
-			controller.stats.numWLRead++;
-			controller.stats.numWLWrite++;
+			controller.stats.numGCRead++;
+			controller.stats.numGCWrite++;
 			controller.stats.numMemoryRead++; // Block->get_state(i) == VALID
 			controller.stats.numMemoryWrite =+ 3; // GTD Update (2) + translation invalidate (1)
 		}
@@ -420,18 +445,66 @@ void FtlImpl_BDftl::cleanup_block(Event &event, Block *block)
 			current.create_ts = event.get_start_time();
 			current.cached = true;
 			cmt++;
+			update_cmt_memory();
 		}
 
 		trans_map.replace(trans_map.begin()+real_vpn, current);
 	}
 }
 
+/*
+ * A sequential fill leaves every logical block in its own physical block,
+ * mapped at block level. Random writes to fresh blocks are handled by the
+ * page-level DFTL mapping, so a random fill maps every page there.
+ */
+enum status FtlImpl_BDftl::precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed)
+{
+	std::vector<ulong> order;
+	if (precondition_order(pattern, fill_fraction, seed, order) == FAILURE)
+		return FAILURE;
+
+	Event event = Event(WRITE, 0, 1, 0.0);
+	for (ulong i = 0; i < order.size(); i++)
+	{
+		ulong dlpn = order[i];
+		uint dlbn = dlpn / BLOCK_SIZE;
+
+		if (pattern == PRECONDITION_SEQUENTIAL)
+		{
+			if (block_map[dlbn].pbn == -1u)
+				block_map[dlbn].pbn = Block_manager::instance()->get_free_block(DATA, event).get_linear_address();
+
+			precondition_page(Address(block_map[dlbn].pbn + dlpn % BLOCK_SIZE, PAGE));
+			block_map[dlbn].nextPage++;
+			continue;
+		}
+
+		block_map[dlbn].optimal = false;
+
+		long free_page = get_free_data_page(event, false);
+
+		MPage current = trans_map[dlpn];
+		update_translation_map(current, free_page);
+		trans_map.replace(trans_map.begin()+dlpn, current);
+
+		precondition_page(Address(free_page, PAGE));
+	}
+	return SUCCESS;
+}
+
 // Returns true if the next page is in a new block
 bool FtlImpl_BDftl::block_next_new()
 {
 	return (currentDataPage == -1 || currentDataPage % BLOCK_SIZE == BLOCK_SIZE -1);
 }
 
+void FtlImpl_BDftl::get_host_memory(std::vector<Ftl_memory> &usage) const
+{
+	FtlImpl_DftlParent::get_host_memory(usage);
+	usage[block_map_memory].host = NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(BPage);
+	usage[trim_map_memory].host = trim_map.capacity() / 8;
+}
+
 void FtlImpl_BDftl::print_ftl_statistics()
 {
 	printf("FTL Stats:\n");
@@ -453,3 +526,30 @@ void FtlImpl_BDftl::print_ftl_statistics()
 	Block_manager::instance()->print_statistics();
 }
 
+
+void FtlImpl_BDftl::save(Snapshot &snapshot) const
+{
+	FtlImpl_DftlParent::save(snapshot);
+	snapshot.write(block_map, NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(BPage));
+	snapshot.put(trim_map);
+
+	std::queue<Block*> queue = blockQueue;
+	snapshot.put((ulong) queue.size());
+	for (; !queue.empty(); queue.pop())
+		snapshot.put_block(queue.front());
+	snapshot.put_block(inuseBlock);
+}
+
+void FtlImpl_BDftl::load(Snapshot &snapshot)
+{
+	FtlImpl_DftlParent::load(snapshot);
+	snapshot.read(block_map, NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(BPage));
+	snapshot.get(trim_map);
+
+	blockQueue = std::queue<Block*>();
+	ulong count = 0;
+	snapshot.get(count);
+	for (ulong i = 0; i < count && snapshot.good(); i++)
+		blockQueue.push(snapshot.get_block(*this));
+	inuseBlock = snapshot.get_block(*this);
+}
@@ -102,26 +102,28 @@ enum status FtlImpl_Dftl::write(Event &event)
 
 enum status FtlImpl_Dftl::trim(Event &event)
 {
-	uint dlpn = event.get_logical_address();
+	ulong start = event.get_logical_address();
+	ulong end = start + event.get_size();
 
 	event.set_address(Address(0, PAGE));
 
-	MPage current = trans_map[dlpn];
-
-	if (current.ppn != -1)
+	for (ulong dlpn = start; dlpn < end; dlpn++)
 	{
-		Address address = Address(current.ppn, PAGE);
-		Block *block = controller.get_block_pointer(address);
-		block->invalidate_page(address.page);
+		MPage current = trans_map[dlpn];
+
+		if (current.ppn != -1)
+		{
+			trim_page(event, Address(current.ppn, PAGE), DATA);
 
-		evict_specific_page_from_cache(event, dlpn);
+			evict_specific_page_from_cache(event, dlpn);
 
-		update_translation_map(current, -1);
+			update_translation_map(current, -1);
 
-		trans_map.replace(trans_map.begin()+dlpn, current);
+			trans_map.replace(trans_map.begin()+dlpn, current);
+		}
 	}
 
-	controller.stats.numFTLTrim++;
+	controller.stats.numFTLTrim += event.get_size();
 
 	return controller.issue(event);
 }
@@ -137,33 +139,14 @@ void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 	for (uint i=0;i<BLOCK_SIZE;i++)
 	{
 		assert(block->get_state(i) != EMPTY);
-		// When valid, two events are create, one for read and one for write. They are chained and the controller are
-		// called to execute them. The execution time is then added to the real event.
+		// When valid, the page is moved to the GC block of its plane. The
+		// execution time is then added to the real event.
 		if (block->get_state(i) == VALID)
 		{
-			// Set up events.
-			Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
-			readEvent.set_address(Address(block->get_physical_address()+i, PAGE));
-
-			// Execute read event
-			if (controller.issue(readEvent) == FAILURE)
-				printf("Data block copy failed.");
-
-			// Get new address to write to and invalidate previous
-			Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
-			Address dataBlockAddress = Address(get_free_data_page(event, false), PAGE);
-
-			writeEvent.set_address(dataBlockAddress);
-
-			writeEvent.set_replace_address(Address(block->get_physical_address()+i, PAGE));
+			Address victimAddress = Address(block->get_physical_address()+i, PAGE);
+			Address dataBlockAddress = Address(get_free_gc_page(event, victimAddress), PAGE);
 
-			// Setup the write event to read from the right place.
-			writeEvent.set_payload((char*)page_data + (block->get_physical_address()+i) * PAGE_SIZE);
-
-			if (controller.issue(writeEvent) == FAILURE)
-				printf("Data block copy failed.");
-
-			event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken());
+			if (copy_page(event, victimAddress, dataBlockAddress, true) == FAILURE) { assert(false); }
 
 			// Update GTD
 			long dataPpn = dataBlockAddress.get_linear_address();
@@ -175,8 +158,8 @@ void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 			// Statistics
 			controller.stats.numFTLRead++;
 			controller.stats.numFTLWrite++;
-			controller.stats.numWLRead++;
-			controller.stats.numWLWrite++;
+			controller.stats.numGCRead++;
+			controller.stats.numGCWrite++;
 			controller.stats.numMemoryRead++; // Block->get_state(i) == VALID
 			controller.stats.numMemoryWrite =+ 3; // GTD Update (2) + translation invalidate (1)
 		}
@@ -208,6 +191,7 @@ void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 			current.create_ts = event.get_start_time();
 			current.cached = true;
 			cmt++;
+			update_cmt_memory();
 		}
 
 		trans_map.replace(trans_map.begin()+real_vpn, current);
@@ -219,3 +203,27 @@ void FtlImpl_Dftl::print_ftl_statistics()
 {
 	Block_manager::instance()->print_statistics();
 }
+
+/*
+ * Data pages are placed like write() places them. The CMT is left empty, as
+ * after a restart, so no translation pages are written.
+ */
+enum status FtlImpl_Dftl::precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed)
+{
+	std::vector<ulong> order;
+	if (precondition_order(pattern, fill_fraction, seed, order) == FAILURE)
+		return FAILURE;
+
+	Event event = Event(WRITE, 0, 1, 0.0);
+	for (ulong i = 0; i < order.size(); i++)
+	{
+		long free_page = get_free_data_page(event, false);
+
+		MPage current = trans_map[order[i]];
+		update_translation_map(current, free_page);
+		trans_map.replace(trans_map.begin()+order[i], current);
+
+		precondition_page(Address(free_page, PAGE));
+	}
+	return SUCCESS;
+}
@@ -66,6 +66,7 @@ FtlImpl_DftlParent::FtlImpl_DftlParent(Controller &controller):
 	cmt = 0;
 	currentDataPage = -1;
 	currentTranslationPage = -1;
+	currentGCPage.assign(SSD_SIZE * PACKAGE_SIZE * DIE_SIZE, -1);
 
 	// Detect required number of bits for logical address size
 	addressSize = log(NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE)/log(2);
@@ -86,18 +87,37 @@ FtlImpl_DftlParent::FtlImpl_DftlParent(Controller &controller):
 		trans_map.push_back(MPage(i));
 
 	reverse_trans_map = new long[ssdSize];
+
+	// The GTD maps every translation page, the CMT holds (lpn, ppn) pairs;
+	// the translation pages themselves are in flash
+	gtd_memory = add_memory("GTD");
+	set_memory(gtd_memory, (ssdSize + addressPerPage - 1) / addressPerPage * MAP_ENTRY_BYTES);
+	cmt_memory = add_memory("CMT", true);
+	translation_memory = add_memory("translation pages");
+}
+
+void FtlImpl_DftlParent::update_cmt_memory(void)
+{
+	set_memory(cmt_memory, cmt * 2 * MAP_ENTRY_BYTES);
+}
+
+/* trans_map holds every page mapping with its cache state, the CMT is the
+ * cached subset of it */
+void FtlImpl_DftlParent::get_host_memory(std::vector<Ftl_memory> &usage) const
+{
+	usage[translation_memory].host = trans_map.size() * (sizeof(MPage) + MAP_NODE_BYTES + sizeof(void *) + sizeof(long));
 }
 
 void FtlImpl_DftlParent::consult_GTD(long dlpn, Event &event)
 {
 	// Simulate that we goto translation map and read the mapping page.
-	Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+	Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_sub_event_time());
 	readEvent.set_address(Address(0, PAGE));
 	readEvent.set_noop(true);
 
 	if (controller.issue(readEvent) == FAILURE) { assert(false);}
 	//event.consolidate_metaevent(readEvent);
-	event.incr_time_taken(readEvent.get_time_taken());
+	event.incr_time_taken(readEvent.get_time_taken(), COMPONENT_MAPPING);
 	controller.stats.numFTLRead++;
 }
 
@@ -113,7 +133,7 @@ bool FtlImpl_DftlParent::lookup_CMT(long dlpn, Event &event)
 	if (!trans_map[dlpn].cached)
 		return false;
 
-	event.incr_time_taken(RAM_READ_DELAY);
+	event.incr_time_taken(RAM_READ_DELAY, COMPONENT_MAPPING);
 	controller.stats.numMemoryRead++;
 
 	return true;
@@ -137,6 +157,23 @@ long FtlImpl_DftlParent::get_free_data_page(Event &event, bool insert_events)
 	return currentDataPage;
 }
 
+/*
+ * Returns a free page for a page moved out of the victim block during GC.
+ * Each plane keeps its own GC block, allocated on the same plane when
+ * possible, so valid pages can be moved with copy-back.
+ */
+long FtlImpl_DftlParent::get_free_gc_page(Event &event, const Address &victim)
+{
+	long &currentPage = currentGCPage[victim.get_linear_address() / (BLOCK_SIZE * PLANE_SIZE)];
+
+	if (currentPage == -1 || currentPage % BLOCK_SIZE == BLOCK_SIZE -1)
+		currentPage = Block_manager::instance()->get_free_block(DATA, event, victim).get_linear_address();
+	else
+		currentPage++;
+
+	return currentPage;
+}
+
 FtlImpl_DftlParent::~FtlImpl_DftlParent(void)
 {
 	delete[] reverse_trans_map;
@@ -182,6 +219,7 @@ void FtlImpl_DftlParent::resolve_mapping(Event &event, bool isWrite)
 		trans_map.replace(trans_map.begin()+dlpn, current);
 
 		cmt++;
+		update_cmt_memory();
 	}
 }
 
@@ -213,19 +251,20 @@ void FtlImpl_DftlParent::evict_page_from_cache(Event &event)
 			}
 
 			// Simulate the write to translate page
-			Event write_event = Event(WRITE, event.get_logical_address(), 1, event.get_start_time());
+			Event write_event = Event(WRITE, event.get_logical_address(), 1, event.get_sub_event_time());
 			write_event.set_address(Address(0, PAGE));
 			write_event.set_noop(true);
 
 			if (controller.issue(write_event) == FAILURE) {	assert(false);}
 
-			event.incr_time_taken(write_event.get_time_taken());
+			event.incr_time_taken(write_event.get_time_taken(), COMPONENT_MAPPING);
 			controller.stats.numFTLWrite++;
 			controller.stats.numGCWrite++;
 		}
 
 		// Remove page from cache.
 		cmt--;
+		update_cmt_memory();
 
 		evictPage.cached = false;
 		reset_MPage(evictPage);
@@ -261,19 +300,20 @@ void FtlImpl_DftlParent::evict_specific_page_from_cache(Event &event, long lba)
 			}
 
 			// Simulate the write to translate page
-			Event write_event = Event(WRITE, event.get_logical_address(), 1, event.get_start_time());
+			Event write_event = Event(WRITE, event.get_logical_address(), 1, event.get_sub_event_time());
 			write_event.set_address(Address(0, PAGE));
 			write_event.set_noop(true);
 
 			if (controller.issue(write_event) == FAILURE) {	assert(false);}
 
-			event.incr_time_taken(write_event.get_time_taken());
+			event.incr_time_taken(write_event.get_time_taken(), COMPONENT_MAPPING);
 			controller.stats.numFTLWrite++;
 			controller.stats.numGCWrite++;
 		}
 
 		// Remove page from cache.
 		cmt--;
+		update_cmt_memory();
 
 		evictPage.cached = false;
 		reset_MPage(evictPage);
@@ -284,5 +324,74 @@ void FtlImpl_DftlParent::evict_specific_page_from_cache(Event &event, long lba)
 void FtlImpl_DftlParent::update_translation_map(FtlImpl_DftlParent::MPage &mpage, long ppn)
 {
 	mpage.ppn = ppn;
-	reverse_trans_map[ppn] = mpage.vpn;
+
+	// ppn -1 unmaps the page (trim)
+	if (ppn != -1)
+		reverse_trans_map[ppn] = mpage.vpn;
+}
+
+/* The CMT eviction order breaks ties by history, so the last visited order
+ * is stored next to the mapping pages. */
+void FtlImpl_DftlParent::save(Snapshot &snapshot) const
+{
+	snapshot.put(cmt);
+	snapshot.put(currentDataPage);
+	snapshot.put(currentTranslationPage);
+	snapshot.put(currentGCPage);
+
+	snapshot.put((ulong) trans_map.size());
+	for (MpageByID::const_iterator it = trans_map.get<0>().begin(); it != trans_map.get<0>().end(); ++it)
+		snapshot.put(*it);
+	for (MpageByLastVisited::const_iterator it = trans_map.get<1>().begin(); it != trans_map.get<1>().end(); ++it)
+		snapshot.put(it->vpn);
+
+	snapshot.write(reverse_trans_map, trans_map.size() * sizeof(long));
+}
+
+void FtlImpl_DftlParent::load(Snapshot &snapshot)
+{
+	snapshot.get(cmt);
+	snapshot.get(currentDataPage);
+	snapshot.get(currentTranslationPage);
+	snapshot.get(currentGCPage);
+
+	ulong count = 0;
+	snapshot.get(count);
+	if (!snapshot.good() || count != trans_map.size())
+	{
+		fprintf(stderr, "DFTL error: %s: snapshot does not match the mapping table\n", __func__);
+		return;
+	}
+
+	std::vector<MPage> mpages;
+	mpages.reserve(count);
+	for (ulong i = 0; i < count; i++)
+	{
+		MPage mpage(i);
+		snapshot.get(mpage);
+		mpages.push_back(mpage);
+	}
+
+	// Insert in last visited order, then put the pages back in vpn order.
+	trans_map.clear();
+	for (ulong i = 0; i < count && snapshot.good(); i++)
+	{
+		long vpn = 0;
+		snapshot.get(vpn);
+		if (vpn >= 0 && (ulong) vpn < count)
+			trans_map.push_back(mpages[vpn]);
+	}
+	if (!snapshot.good() || trans_map.size() != count)
+	{
+		fprintf(stderr, "DFTL error: %s: snapshot does not match the mapping table\n", __func__);
+		return;
+	}
+
+	std::vector<boost::reference_wrapper<const MPage> > by_vpn(count, boost::cref(*trans_map.begin()));
+	for (MpageByID::iterator it = trans_map.begin(); it != trans_map.end(); ++it)
+		by_vpn[it->vpn] = boost::cref(*it);
+	trans_map.rearrange(by_vpn.begin());
+
+	snapshot.read(reverse_trans_map, count * sizeof(long));
+	update_cmt_memory();
 }
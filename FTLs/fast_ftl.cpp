@@ -25,6 +25,7 @@
 #include <math.h>
 #include <vector>
 #include <queue>
+#include <algorithm>
 #include <iostream>
 #include <signal.h>
 #include "../ssd.h"
@@ -53,6 +54,12 @@ FtlImpl_Fast::FtlImpl_Fast(Controller &controller):
 
 	log_pages = NULL;
 
+	data_list_memory = add_memory("data block map");
+	set_memory(data_list_memory, NUMBER_OF_ADDRESSABLE_BLOCKS * MAP_ENTRY_BYTES);
+	pin_list_memory = add_memory("pin list");
+	log_map_memory = add_memory("log block maps");
+	update_log_memory();
+
 	printf("Total mapping table size: %luKB\n", NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(uint) / 1024);
 	printf("Using FAST FTL.\n");
 }
@@ -81,6 +88,7 @@ void FtlImpl_Fast::initialize_log_pages()
 		next->next = newLPB;
 		next = newLPB;
 	}
+	update_log_memory();
 }
 enum status FtlImpl_Fast::read(Event &event)
 {
@@ -187,68 +195,79 @@ enum status FtlImpl_Fast::trim(Event &event)
 {
 	initialize_log_pages();
 
-	// Find block
-	long lookupBlock = (event.get_logical_address() >> addressShift);
-	uint lbnOffset = event.get_logical_address() % BLOCK_SIZE;
-
-	Address eventAddress = Address(event.get_logical_address(), PAGE);
-
-	LogPageBlock *currentBlock = log_pages;
+	ulong start = event.get_logical_address();
+	ulong end = start + event.get_size();
 
-	bool found = false;
-	while (!found && currentBlock != NULL)
+	// Pages of the extent can be anywhere in the RW log blocks, walk them once.
+	// The RW log blocks are reclaimed by the random merge, so they are only
+	// invalidated here.
+	for (LogPageBlock *currentBlock = log_pages; currentBlock != NULL; currentBlock = currentBlock->next)
 	{
 		for (int i=0;i<currentBlock->numPages;i++)
 		{
-			if (currentBlock->aPages[i] == (long)event.get_logical_address())
-			{
-				Address address = Address(currentBlock->address.get_linear_address() + i, PAGE);
-				Block *block = controller.get_block_pointer(address);
-				block->invalidate_page(address.page);
-
-				currentBlock->aPages[i] = -1;
+			if (currentBlock->aPages[i] < (long)start || currentBlock->aPages[i] >= (long)end)
+				continue;
 
-				if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
-				{
-					Block_manager::instance()->erase_and_invalidate(event, currentBlock->address, LOG);
-					data_list[lookupBlock] = -1;
-				}
+			Address address = Address(currentBlock->address.get_linear_address() + i, PAGE);
+			controller.get_block_pointer(address)->invalidate_page(address.page);
 
-				// Cancel the while and for loop
-				found = true;
-				break;
-			}
+			currentBlock->aPages[i] = -1;
 		}
-
-		currentBlock = currentBlock->next;
 	}
 
-	if (!found)
+	// Handle the SW log block and the data blocks one logical block at a time.
+	for (ulong blockStart = start - start % BLOCK_SIZE; blockStart < end; blockStart += BLOCK_SIZE)
 	{
-		if (sequential_logicalblock_address == lookupBlock && sequential_offset > lbnOffset)
-		{
-			Address address = Address(sequential_address.get_linear_address() + lbnOffset, PAGE);
-			Block *block = controller.get_block_pointer(address);
-			block->invalidate_page(address.page);
+		ulong first = std::max(start, blockStart);
+		ulong last = std::min(end, blockStart + BLOCK_SIZE);
+		bool wholeBlock = (last - first == BLOCK_SIZE);
+
+		// Find block
+		long lookupBlock = (blockStart >> addressShift);
 
-			if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
+		if (sequential_logicalblock_address == lookupBlock)
+		{
+			if (wholeBlock)
 			{
-				Block_manager::instance()->erase_and_invalidate(event, address, LOG);
+				Block_manager::instance()->erase_and_invalidate(event, sequential_address, LOG);
 				sequential_logicalblock_address = -1;
 			}
-
+			else
+			{
+				for (ulong lpn=first;lpn<last && lpn % BLOCK_SIZE < sequential_offset;lpn++)
+				{
+					if (trim_page(event, Address(sequential_address.get_linear_address() + lpn % BLOCK_SIZE, PAGE), LOG))
+					{
+						sequential_logicalblock_address = -1;
+						break;
+					}
+				}
+			}
 		}
-		else if (data_list[lookupBlock] != -1) // If page is in the data block
-		{
-			Address address = Address(data_list[lookupBlock] + lbnOffset , PAGE);
 
-			Block *block = controller.get_block_pointer(address);
-			block->invalidate_page(address.page);
-
-			if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
+		if (data_list[lookupBlock] != -1) // If pages are in the data block
+		{
+			if (wholeBlock)
 			{
-				Block_manager::instance()->erase_and_invalidate(event, address, LOG);
+				Address address = Address(data_list[lookupBlock], BLOCK);
 				data_list[lookupBlock] = -1;
+				Block_manager::instance()->erase_and_invalidate(event, address, DATA);
+			}
+			else
+			{
+				// Only written pages are trimmed, empty ones still take in-place writes.
+				for (ulong lpn=first;lpn<last;lpn++)
+				{
+					Address address = Address(data_list[lookupBlock] + lpn % BLOCK_SIZE, PAGE);
+					if (controller.get_state(address) != VALID)
+						continue;
+
+					if (trim_page(event, address, DATA))
+					{
+						data_list[lookupBlock] = -1;
+						break;
+					}
+				}
 			}
 		}
 	}
@@ -260,13 +279,15 @@ enum status FtlImpl_Fast::trim(Event &event)
 	Block_manager::instance()->insert_events(event);
 
 	// Statistics
-	controller.stats.numFTLTrim++;
+	controller.stats.numFTLTrim += event.get_size();
 
 	return controller.issue(event);
 }
 
 void FtlImpl_Fast::switch_sequential(Event &event)
 {
+	double start = event.get_time_taken();
+
 	// Add to empty list i.e. switch without erasing the datablock.
 
 	if (data_list[sequential_logicalblock_address] != -1)
@@ -276,7 +297,50 @@ void FtlImpl_Fast::switch_sequential(Event &event)
 
 	update_map_block(event);
 
-	controller.stats.numLogMergeSwitch++;
+	controller.stats.add_merge(MERGE_SWITCH, event.get_time_taken() - start);
+}
+
+/*
+ * The SW log block is always written in-place from offset 0, so it can be
+ * completed with the remaining pages of its data block and take its place
+ * instead of copying both blocks into a new block.
+ */
+bool FtlImpl_Fast::partial_sequential(Event &event)
+{
+	if (sequential_offset == 0 || sequential_offset >= BLOCK_SIZE)
+		return false;
+
+	double start = event.get_time_taken();
+
+	long dataBlock = data_list[sequential_logicalblock_address];
+	if (dataBlock != -1)
+	{
+		for (uint i=sequential_offset;i<BLOCK_SIZE;i++)
+		{
+			Address readAddress = Address(dataBlock + i, PAGE);
+			if (get_state(readAddress) != VALID)
+				continue;
+
+			if (copy_page(event, readAddress, Address(sequential_address.get_linear_address() + i, PAGE), false) == FAILURE) { assert(false); }
+
+			// Statistics
+			controller.stats.numFTLRead++;
+			controller.stats.numFTLWrite++;
+			controller.stats.numGCRead++;
+			controller.stats.numGCWrite++;
+		}
+
+		Block_manager::instance()->invalidate(Address(dataBlock, BLOCK), DATA);
+	}
+
+	// Update mapping
+	data_list[sequential_logicalblock_address] = sequential_address.get_linear_address();
+
+	update_map_block(event);
+
+	controller.stats.add_merge(MERGE_PARTIAL, event.get_time_taken() - start);
+
+	return true;
 }
 
 void FtlImpl_Fast::merge_sequential(Event &event)
@@ -284,9 +348,12 @@ void FtlImpl_Fast::merge_sequential(Event &event)
 	if (sequential_logicalblock_address == -1)
 		return;
 
-	// Do merge (n reads, n writes and 2 erases (gc'ed))
-	Address eventAddress = Address(event.get_logical_address(), PAGE);
+	if (partial_sequential(event))
+		return;
+
+	double start = event.get_time_taken();
 
+	// Do merge (n reads, n writes and 2 erases (gc'ed))
 	Address newDataBlock = Block_manager::instance()->get_free_block(DATA, event);
 	//printf("Using new data block with address: %lu Block: %u\n", newDataBlock.get_linear_address(), newDataBlock.block);
 
@@ -306,22 +373,13 @@ void FtlImpl_Fast::merge_sequential(Event &event)
 		else
 			continue; // Empty page
 
-		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
-		readEvent.set_address(readAddress);
-		if (controller.issue(readEvent) == FAILURE) { printf("Read failed\n"); return; }
-
-		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
-		writeEvent.set_payload((char*)page_data + readAddress.get_linear_address() * PAGE_SIZE);
-		writeEvent.set_address(Address(newDataBlock.get_linear_address() + i, PAGE));
-		if (controller.issue(writeEvent) == FAILURE) {  printf("Write failed\n"); return; }
-
-		event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken());
+		if (copy_page(event, readAddress, Address(newDataBlock.get_linear_address() + i, PAGE), false) == FAILURE) { assert(false); }
 
 		// Statistics
 		controller.stats.numFTLRead++;
 		controller.stats.numFTLWrite++;
-		controller.stats.numWLRead++;
-		controller.stats.numWLWrite++;
+		controller.stats.numGCRead++;
+		controller.stats.numGCWrite++;
 	}
 
 	// Invalidate inactive pages
@@ -332,19 +390,21 @@ void FtlImpl_Fast::merge_sequential(Event &event)
 	// Update mapping
 	data_list[sequential_logicalblock_address] = newDataBlock.get_linear_address();
 
-	controller.stats.numLogMergeFull++;
-
 	update_map_block(event);
+
+	controller.stats.add_merge(MERGE_FULL, event.get_time_taken() - start);
 }
 
 bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 {
+	double start = event.get_time_taken();
+
 	std::map<long, bool> mergeBlocks;
 
 	// Find blocks to merge
 	for (int i=0;i<logBlock->numPages;i++)
 	{
-		event.incr_time_taken(RAM_READ_DELAY);
+		event.incr_time_taken(RAM_READ_DELAY, COMPONENT_MAPPING);
 
 		long victimLBA = (logBlock->aPages[i] >> addressShift);
 		if (victimLBA != -1)
@@ -379,7 +439,7 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 			// Go though the pages and see if any falls into the same category as the current logical block
 			for (int i=lpb->numPages-1;i>0;i--)
 			{
-				event.incr_time_taken(RAM_READ_DELAY);
+				event.incr_time_taken(RAM_READ_DELAY, COMPONENT_MAPPING);
 
 				if (lpb->aPages[i] == -1u)
 					continue;
@@ -395,29 +455,17 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 					}
 					else if (get_state(writeAddress) == EMPTY)
 					{
-						// Read the active log address
-						Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+						// Copy the active log address
 						Address readAddress = Address(lpb->address.get_linear_address()+i, PAGE);
-						readEvent.set_address(readAddress);
-
-						if (controller.issue(readEvent) == FAILURE) { printf("failed\n"); return false; }
-						//event.consolidate_metaevent(readEvent);
-
-						Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
-						writeEvent.set_payload((char*)page_data + readAddress.get_linear_address() * PAGE_SIZE);
-						writeEvent.set_address(writeAddress);
-
-						if (controller.issue(writeEvent) == FAILURE) { printf("failed\n"); return false; }
-						//event.consolidate_metaevent(writeEvent);
-						event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken());
+						if (copy_page(event, readAddress, writeAddress, false) == FAILURE) { assert(false); }
 
 						pinned[lpb->aPages[i]%BLOCK_SIZE] = true;
 
 						// Statistics
 						controller.stats.numFTLRead++;
 						controller.stats.numFTLWrite++;
-						controller.stats.numWLRead++;
-						controller.stats.numWLWrite++;
+						controller.stats.numGCRead++;
+						controller.stats.numGCWrite++;
 					}
 				}
 			}
@@ -426,7 +474,7 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 		// Merge the data block with the pages from the log
 		for (uint i=0;i<BLOCK_SIZE;i++)
 		{
-			event.incr_time_taken(RAM_READ_DELAY);
+			event.incr_time_taken(RAM_READ_DELAY, COMPONENT_MAPPING);
 
 			Address writeAddress = Address(mergeAddress.get_linear_address() + i, PAGE);
 			if (get_state(writeAddress) == EMPTY && pinned[i] == false)
@@ -434,27 +482,16 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 				Address readAddress = Address(data_list[victimLBA] + i, PAGE);
 				if (get_state(readAddress) == VALID)
 				{
-					Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
-					readEvent.set_address(readAddress);
-					if (controller.issue(readEvent) == FAILURE) { printf("failed\n"); return false;	}
-					//event.consolidate_metaevent(readEvent);
-
-					// Write the page to merge address
-					Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
-					writeEvent.set_payload((char*)page_data + readAddress.get_linear_address() * PAGE_SIZE);
-					writeEvent.set_address(writeAddress);
-					if (controller.issue(writeEvent) == FAILURE) { printf("failed\n"); return false;	}
-					//event.consolidate_metaevent(writeEvent);
-
-					event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken());
+					// Copy the page to merge address
+					if (copy_page(event, readAddress, writeAddress, false) == FAILURE) { assert(false); }
 
 					pinned[i] = true;
 
 					// Statistics
 					controller.stats.numFTLRead++;
 					controller.stats.numFTLWrite++;
-					controller.stats.numWLRead++;
-					controller.stats.numWLWrite++;
+					controller.stats.numGCRead++;
+					controller.stats.numGCWrite++;
 				}
 			}
 		}
@@ -466,10 +503,10 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 
 	}
 
-	controller.stats.numLogMergeFull++;
-
 	update_map_block(event);
 
+	controller.stats.add_merge(MERGE_FULL, event.get_time_taken() - start);
+
 	return true;
 }
 
@@ -583,21 +620,118 @@ bool FtlImpl_Fast::write_to_log_block(Event &event, long logicalBlockAddress)
 
 void FtlImpl_Fast::update_map_block(Event &event)
 {
-	Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time());
+	Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_sub_event_time());
 	writeEvent.set_address(Address(0, PAGE));
 	writeEvent.set_noop(true);
 
 	controller.issue(writeEvent);
 
-	event.incr_time_taken(writeEvent.get_time_taken());
+	event.incr_time_taken(writeEvent.get_time_taken(), COMPONENT_MAPPING);
 
 	controller.stats.numGCWrite++;
 	controller.stats.numFTLWrite++;
 }
 
 
+/*
+ * The first write of a logical page goes to its offset in the data block, so
+ * a fill leaves only data blocks, allocated in the order they are first
+ * written. The log blocks are allocated first, as on the first request.
+ */
+enum status FtlImpl_Fast::precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed)
+{
+	std::vector<ulong> order;
+	if (precondition_order(pattern, fill_fraction, seed, order) == FAILURE)
+		return FAILURE;
+
+	initialize_log_pages();
+
+	Event event = Event(WRITE, 0, 1, 0.0);
+	for (ulong i = 0; i < order.size(); i++)
+	{
+		long logicalBlockAddress = order[i] >> addressShift;
+
+		if (data_list[logicalBlockAddress] == -1)
+			data_list[logicalBlockAddress] = Block_manager::instance()->get_free_block(DATA, event).get_linear_address();
+
+		pin_list[order[i]] = true;
+		precondition_page(Address(data_list[logicalBlockAddress] + order[i] % BLOCK_SIZE, PAGE));
+	}
+	return SUCCESS;
+}
+
 void FtlImpl_Fast::print_ftl_statistics()
 {
 	Block_manager::instance()->print_statistics();
 }
 
+
+/* The SW log block maps its LBN, PBN and fill offset, every RW log block its
+ * PBN and the logical page of each of its pages */
+void FtlImpl_Fast::update_log_memory(void)
+{
+	ulong blocks = 0;
+	for (LogPageBlock *block = log_pages; block != NULL; block = block->next)
+		blocks++;
+	set_memory(log_map_memory, (3 + blocks * (1 + BLOCK_SIZE)) * MAP_ENTRY_BYTES);
+}
+
+void FtlImpl_Fast::get_host_memory(std::vector<Ftl_memory> &usage) const
+{
+	ulong blocks = 0;
+	for (LogPageBlock *block = log_pages; block != NULL; block = block->next)
+		blocks++;
+	usage[data_list_memory].host = NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(long);
+	usage[pin_list_memory].host = NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE * sizeof(bool);
+	usage[log_map_memory].host = blocks * (sizeof(LogPageBlock) + BLOCK_SIZE * (sizeof(int) + sizeof(long)));
+}
+
+void FtlImpl_Fast::save(Snapshot &snapshot) const
+{
+	snapshot.write(data_list, NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(long));
+	snapshot.write(pin_list, NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE * sizeof(bool));
+	snapshot.put(sequential_logicalblock_address);
+	snapshot.put(sequential_address);
+	snapshot.put(sequential_offset);
+	snapshot.put(log_page_next);
+
+	ulong count = 0;
+	for (LogPageBlock *block = log_pages; block != NULL; block = block->next)
+		count++;
+	snapshot.put(count);
+	for (LogPageBlock *block = log_pages; block != NULL; block = block->next)
+		block->save(snapshot);
+}
+
+void FtlImpl_Fast::load(Snapshot &snapshot)
+{
+	snapshot.read(data_list, NUMBER_OF_ADDRESSABLE_BLOCKS * sizeof(long));
+	snapshot.read(pin_list, NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE * sizeof(bool));
+	snapshot.get(sequential_logicalblock_address);
+	snapshot.get(sequential_address);
+	snapshot.get(sequential_offset);
+	snapshot.get(log_page_next);
+
+	while (log_pages != NULL)
+	{
+		LogPageBlock *next = log_pages->next;
+		delete log_pages;
+		log_pages = next;
+	}
+
+	// The RW log block list is rebuilt in order; empty until first used.
+	ulong count = 0;
+	snapshot.get(count);
+	LogPageBlock *last = NULL;
+	for (ulong i = 0; i < count && snapshot.good(); i++)
+	{
+		LogPageBlock *block = new LogPageBlock();
+		block->load(snapshot);
+		if (last == NULL)
+			log_pages = block;
+		else
+			last->next = block;
+		last = block;
+	}
+	update_log_memory();
+}
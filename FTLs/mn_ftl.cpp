@@ -1,152 +1,426 @@
-#include <cstddef>
 #include <new>
+#include <assert.h>
 #include <stdio.h>
+#include <vector>
+#include <map>
+#include <algorithm>
 #include "../ssd.h"
 
 using namespace ssd;
 
-FtlImpl_Mnftl::FtlImpl_Mnftl(Controller &controller):
-    FtlImpl_DftlParent(controller)
+FtlImpl_MNftl::FtlImpl_MNftl(Controller &controller): 
+    FtlParent(controller)
 {
-    printf("DEBUG: Constructor Start\n");
-    printf("Using MNFTL (Strict OOB-based Mapping).\n");
-    
-    uint total_logical_pages = ssd::NUMBER_OF_ADDRESSABLE_BLOCKS * ssd::BLOCK_SIZE;
-    
-    // Safety check: Initialize the translation map if the parent class hasn't done so.
-    if (trans_map.size() < total_logical_pages) {
-        printf("DEBUG: Initializing trans_map for %u pages...\n", total_logical_pages);
-        for (ulong i = trans_map.size(); i < total_logical_pages; i++) {
-            MPage m_page(i);
-            m_page.ppn = -1;       // Initialize as unmapped
-            m_page.cached = false; // Not in SRAM cache initially
-            trans_map.push_back(m_page);
-        }
+    P = BLOCK_SIZE;
+    Q = MNFTL_OOB_SIZE / MNFTL_ENTRY_SIZE;
+    num_pmd = (P + Q - 1) / Q;
+
+    has_current_block = false;
+    current_page_offset = 0;
+    current_block = Address(0, NONE);
+
+    // LPN kept in the OOB of every physical page, read back by GC
+    page_lpn.assign(NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE, -1);
+
+    bml_memory = add_memory("BML");
+    pmd_memory = add_memory("PMD");
+    pmt_memory = add_memory("PMT (flash)");
+
+    printf("Using MNFTL\n");
+    printf("P (pages per block) = %u\n", P);
+    printf("Q (entries per PMT) = %u\n", Q);
+    printf("NUM_PMD = %u\n", num_pmd);
+}
+
+FtlImpl_MNftl::~FtlImpl_MNftl(void)
+{
+    return;
+}
+
+// allocate a new physical block and set it as current_block
+void FtlImpl_MNftl::allocate_new_current_block(Event &event)
+{
+    // Step 6 in Algorithm 1: Allocate new block as PBN
+    Address blk = Block_manager::instance()->get_free_block(event);
+    // store full address
+    current_block = blk;
+    current_block.valid = BLOCK;
+    has_current_block = true;
+    current_page_offset = 0;
+
+    // Update BML: append the block's linear address, block indices repeat
+    // across planes
+    BML.push_back(current_block.get_linear_address());
+    update_map_memory();
+}
+
+// SRAM holds one BML entry per block and NUM_PMD anchors per mapped LBN
+void FtlImpl_MNftl::update_map_memory(void)
+{
+    set_memory(bml_memory, BML.size() * MAP_ENTRY_BYTES);
+    set_memory(pmd_memory, PMD.size() * num_pmd * MAP_ENTRY_BYTES);
+}
+
+void FtlImpl_MNftl::get_host_memory(std::vector<Ftl_memory> &usage) const
+{
+    usage[bml_memory].host = BML.capacity() * sizeof(ulong);
+    usage[pmd_memory].host = PMD.size() * (MAP_NODE_BYTES + sizeof(std::pair<const uint, std::vector<long> >) + num_pmd * sizeof(long));
+    usage[pmt_memory].host = PMT.size() * (MAP_NODE_BYTES + sizeof(std::pair<const uint, std::vector< std::vector<long> > >) + num_pmd * (sizeof(std::vector<long>) + Q * sizeof(long))) + page_lpn.capacity() * sizeof(long);
+}
+
+// allocate next free page within current block
+// return linear ppn; outAddr is full Address of allocated page
+ulong FtlImpl_MNftl::alloc_page_in_current_block(Event &event, Address &outAddr)
+{
+    assert(has_current_block);
+    // start from block address
+    Address addr = current_block;
+    // ask controller for next free page in that block
+    controller.get_free_page(addr);   // modifies addr to page-level linear address
+    // keep track
+    outAddr = addr;
+    // compute relative page offset inside block (optional)
+    // current_page_offset can be incremented by caller
+    return addr.get_linear_address();
+}
+
+enum status FtlImpl_MNftl::read(Event &event)
+{
+    controller.stats.numFTLRead++;
+
+    ulong lpn = event.get_logical_address();
+    uint lbn  = lpn / P;
+    uint bo   = lpn % P;
+
+    // Step 2: PMD_INDEX, MAP_SLOT
+    uint pmd_index = bo / Q;
+    uint map_slot  = bo % Q;
+
+    // No mapping exists
+    if (PMD.find(lbn) == PMD.end())
+    {
+        event.set_noop(true);
+        event.set_address(Address(0, PAGE));
+        return controller.issue(event);
+    }
+
+    // Step 2: tempPPN ← PPN_<PMD_INDEX>
+    long anchor_ppn = PMD[lbn][pmd_index];
+    if (anchor_ppn == -1)
+    {
+        event.set_noop(true);
+        event.set_address(Address(0, PAGE));
+        return controller.issue(event);
+    }
+
+    // Step 3: Retrieve PMT_<PMD_INDEX> from OOB of tempPPN
+    event.incr_time_taken(OOB_READ_DELAY, COMPONENT_MAPPING);
+
+    // Step 5: PPN ← PMT_<PMD_INDEX>[MAP_SLOT]
+    long ppn = PMT[lbn][pmd_index][map_slot];
+    if (ppn == -1)
+    {
+        event.set_noop(true);
+        event.set_address(Address(0, PAGE));
+        return controller.issue(event);
     }
+
+    // Step 6: Retrieve data from the PPN
+    event.set_address(Address((ulong)ppn, PAGE));
+    return controller.issue(event);
 }
 
-FtlImpl_Mnftl::~FtlImpl_Mnftl(void)
+
+enum status FtlImpl_MNftl::write(Event &event)
 {
+    controller.stats.numFTLWrite++;
+
+    ulong lpn = event.get_logical_address();
+    uint lbn = lpn / P;
+    uint bo  = lpn % P;
+
+    // Step 2~14: check current block, allocate if full / none
+    // In the paper: if no usable blocks trigger GC, else allocate.
+    // Block_manager decides whether GC is needed, as for DFTL. GC moves
+    // pages into a new current block, so check again afterwards.
+    if (has_current_block && current_page_offset == P)
+        Block_manager::instance()->insert_events(event);
+
+    if (!has_current_block || current_page_offset == P)
+        allocate_new_current_block(event);
+
+    // Step 16 & 20: compute PMD_INDEX and MAP_SLOT
+    uint pmd_index = bo / Q;
+    uint map_slot  = bo % Q;
+
+    // Step 15: ensure PMD / PMT structures exist for this LBN
+    if (PMD.find(lbn) == PMD.end())
+    {
+        PMD[lbn] = std::vector<long>(num_pmd, -1);
+        update_map_memory();
+    }
+    if (PMT.find(lbn) == PMT.end())
+    {
+        PMT[lbn] = std::vector< std::vector<long> >(num_pmd);
+        for (uint i = 0; i < num_pmd; i++)
+            PMT[lbn][i] = std::vector<long>(Q, -1);
+    }
+
+    // Step 17~19: if previous anchor exists, read PMT from its OOB (simulate)
+    long anchor_ppn = PMD[lbn][pmd_index];
+    if (anchor_ppn != -1)
+    {
+        event.incr_time_taken(OOB_READ_DELAY, COMPONENT_MAPPING);
+        // Actual PMT content already in PMT[lbn][pmd_index]
+    }
+
+    // Step 7 or 13: allocate next free page in current block
+    Address newPageAddr;
+    ulong new_ppn = alloc_page_in_current_block(event, newPageAddr);
+    current_page_offset++;
+
+    // If this logical page had been previously mapped (old ppn), mark replace
+    long old_ppn = PMT[lbn][pmd_index][map_slot];
+    if (old_ppn != -1)
+    {
+        // mark the old ppn page as to be replaced (invalidated)
+        // event later uses replace_address; mimic BD-DFTL style
+        event.set_replace_address(Address((ulong)old_ppn, PAGE));
+    }
+
+    // Step 21: Update PMT slot
+    PMT[lbn][pmd_index][map_slot] = (long)new_ppn;
+    PMD[lbn][pmd_index] = (long)new_ppn;
+    page_lpn[new_ppn] = (long)lpn;
+
+    // Step 22: write data to new_ppn
+    event.set_address(newPageAddr);
+    // rely on controller.issue to perform write
+    return controller.issue(event);
 }
 
-enum status FtlImpl_Mnftl::trim(Event &event)
+/* ---------- MNFTL trim ---------- */
+enum status FtlImpl_MNftl::trim(Event &event)
 {
-    // MNFTL simulation treats TRIM as a no-op for performance stats
+    controller.stats.numFTLTrim += event.get_size();
+
+    ulong start = event.get_logical_address();
+    ulong end   = start + event.get_size();
+
+    for (ulong lpn = start; lpn < end; lpn++)
+    {
+        uint lbn = lpn / P;
+        uint bo  = lpn % P;
+
+        if (PMD.find(lbn) == PMD.end())
+        {
+            // Nothing mapped in this LBN, skip to the next one
+            lpn += P - bo - 1;
+            continue;
+        }
+
+        uint pmd_index = bo / Q;
+        uint map_slot  = bo % Q;
+
+        long ppn = PMT[lbn][pmd_index][map_slot];
+        if (ppn == -1)
+            continue;
+
+        // Invalidate the physical page so GC stops copying it. A block left
+        // without valid pages is erased and leaves the BML.
+        Address address = Address((ulong)ppn, PAGE);
+        if (trim_page(event, address, DATA))
+            remove_from_bml(address.get_linear_address() - address.page);
+        PMT[lbn][pmd_index][map_slot] = -1;
+
+        // Drop the anchor once the whole PMT is unmapped
+        bool empty = true;
+        for (uint slot = 0; slot < Q; slot++)
+            if (PMT[lbn][pmd_index][slot] != -1)
+                empty = false;
+
+        if (empty)
+            PMD[lbn][pmd_index] = -1;
+    }
+
     event.set_noop(true);
-    controller.stats.numFTLTrim++;
+    event.set_address(Address(0, PAGE));
+
     return controller.issue(event);
 }
 
-
- //checks SRAM cache or retrieves from OOB (simulated delay).
- 
-void FtlImpl_Mnftl::resolve_mapping_mn(Event &event, bool write)
+/* ---------- MNFTL garbage collection: cleanup_block (Algorithm 3) ---------- */
+void FtlImpl_MNftl::cleanup_block(Event &event, Block *block)
 {
-    uint dlpn = event.get_logical_address();
+    /*
+     * For each valid page in victim block:
+     *   1) allocate new page in current block (if needed)
+     *   2) move data to new page, invalidating the old page
+     *   3) update mapping (PMT entry + PMD anchor) accordingly
+     * Finally drop the victim from the BML. Block_manager erases it.
+     *
+     * The LPN of each page is read back from its OOB (page_lpn).
+     */
     
-    // Boundary check
-    if (dlpn >= trans_map.size()) return;
+    // Postponed GC (Section 3.3.1):
+    // cost = N * T_rdoob + S * (T_rdpg + T_wrpg) + T_er
+    event.incr_time_taken(num_pmd * OOB_READ_DELAY, COMPONENT_GC);
 
-    // Access via iterator (Random Access Index 0)
-    trans_set::iterator it = trans_map.begin() + dlpn;
-    
-    // Create a local copy to modify state
-    MPage m_page = *it; 
-
-    if (m_page.cached) {
-        //  Cache Hit: Check PMD_INDEX in RAM
-        m_page.last_visited_time = event.get_start_time();
-        event.incr_time_taken(RAM_READ_DELAY); 
-        controller.stats.numCacheHits++;
-    } else {
-        //  Cache Miss: Retrieve PMT from OOB
-        controller.stats.numCacheFaults++; 
-
-        // Evict if cache is full (LRU)
-        if (cmt >= CACHE_DFTL_LIMIT) {
-            evict_page_from_cache(event);
+    for (uint i = 0; i < BLOCK_SIZE; i++)
+    {
+        if (block->get_state(i) != VALID)
+            continue;
+
+        ulong old_ppn = block->get_physical_address() + i;
+
+        /* 1. Ensure current block exists & not full */
+        if (!has_current_block || current_page_offset == P)
+        {
+            allocate_new_current_block(event);
         }
 
+        /* 1b. Allocate new page in current block */
+        Address newPageAddr;
+        ulong new_ppn = alloc_page_in_current_block(event, newPageAddr);
+        current_page_offset++;
+
+        /* 2. Move data to new page (copy-back when on the same plane) */
+        if (copy_page(event, Address(old_ppn, PAGE), newPageAddr, true) == FAILURE) { assert(false); }
+
+        controller.stats.valid_page_copies++;
 
-        // This is the distinct feature of MNFTL compared to DFTL
-        event.incr_time_taken(1.7); 
-        
-        // Update state and load into Cache
-        m_page.cached = true;
-        m_page.last_visited_time = event.get_start_time();
-        cmt++;
-        
-        controller.stats.numMemoryRead++;
-        controller.stats.numMemoryWrite++;
+        /* 3. Update mapping table entry and PMD anchor of the page */
+        long lpn = page_lpn[old_ppn];
+        assert(lpn != -1);
+        uint lbn = lpn / P;
+        uint pmd_index = (lpn % P) / Q;
+        uint map_slot  = (lpn % P) % Q;
+
+        assert(PMT[lbn][pmd_index][map_slot] == (long)old_ppn);
+        PMT[lbn][pmd_index][map_slot] = (long)new_ppn;
+        PMD[lbn][pmd_index] = (long)new_ppn;
+        page_lpn[new_ppn] = lpn;
+
+        // statistics
+        controller.stats.numFTLRead++;
+        controller.stats.numFTLWrite++;
+        controller.stats.numGCRead++;
+        controller.stats.numGCWrite++;
     }
 
-    // Write back the modified copy to the container
-    trans_map.replace(it, m_page); 
+    /* 4. The victim leaves the BML, Block_manager erases it */
+    remove_from_bml(block->get_physical_address());
 }
 
-/*
- MNFTL Read
- */
-enum status FtlImpl_Mnftl::read(Event &event)
+// drop an erased block, given by its linear address, from the BML
+void FtlImpl_MNftl::remove_from_bml(ulong block_address)
+{
+    std::vector<ulong>::iterator it = std::find(BML.begin(), BML.end(), block_address);
+    assert(it != BML.end());
+    BML.erase(it);
+    update_map_memory();
+}
+/* ---------- MNFTL precondition: write() without events ---------- */
+enum status FtlImpl_MNftl::precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed)
 {
-    // Resolve mapping (Simulate OOB lookup if needed)
-    resolve_mapping_mn(event, false);
+    std::vector<ulong> order;
+    if (precondition_order(pattern, fill_fraction, seed, order) == FAILURE)
+        return FAILURE;
 
-    uint dlpn = event.get_logical_address();
-    
-    if (dlpn < trans_map.size()) {
-        trans_set::iterator it = trans_map.begin() + dlpn;
-        MPage current = *it;
-        
-        // [Alg 2: Line 6] Retrieve data from PPN
-        if (current.ppn != -1) {
-            event.set_address(Address(current.ppn, PAGE));
-        } else {
-            // Unmapped address
-            event.set_address(Address(0, PAGE));
-            event.set_noop(true);
+    Event event = Event(WRITE, 0, 1, 0.0);
+    for (ulong i = 0; i < order.size(); i++)
+    {
+        uint lbn = order[i] / P;
+        uint bo  = order[i] % P;
+        uint pmd_index = bo / Q;
+        uint map_slot  = bo % Q;
+
+        if (!has_current_block || current_page_offset == P)
+            allocate_new_current_block(event);
+
+        if (PMD.find(lbn) == PMD.end())
+        {
+            PMD[lbn] = std::vector<long>(num_pmd, -1);
+            PMT[lbn] = std::vector< std::vector<long> >(num_pmd, std::vector<long>(Q, -1));
+            update_map_memory();
         }
-    } else {
-        event.set_address(Address(0, PAGE));
-        event.set_noop(true);
+
+        Address newPageAddr;
+        ulong new_ppn = alloc_page_in_current_block(event, newPageAddr);
+        current_page_offset++;
+
+        PMT[lbn][pmd_index][map_slot] = (long)new_ppn;
+        PMD[lbn][pmd_index] = (long)new_ppn;
+        page_lpn[new_ppn] = (long)order[i];
+
+        precondition_page(newPageAddr);
     }
+    return SUCCESS;
+}
 
-    controller.stats.numFTLRead++;
-    return controller.issue(event);
+void FtlImpl_MNftl::save(Snapshot &snapshot) const
+{
+    snapshot.put(BML);
+
+    snapshot.put((ulong) PMD.size());
+    for (std::map<uint, std::vector<long>>::const_iterator it = PMD.begin(); it != PMD.end(); ++it)
+    {
+        snapshot.put(it->first);
+        snapshot.put(it->second);
+    }
+
+    snapshot.put((ulong) PMT.size());
+    for (std::map<uint, std::vector< std::vector<long> >>::const_iterator it = PMT.begin(); it != PMT.end(); ++it)
+    {
+        snapshot.put(it->first);
+        snapshot.put((ulong) it->second.size());
+        for (uint i = 0; i < it->second.size(); i++)
+            snapshot.put(it->second[i]);
+    }
+
+    snapshot.put(has_current_block);
+    snapshot.put(current_block);
+    snapshot.put(current_page_offset);
 }
 
-/*
-MNFTL Write
- */
-enum status FtlImpl_Mnftl::write(Event &event)
+void FtlImpl_MNftl::load(Snapshot &snapshot)
 {
-    // Allocate PPN (Handled by Block_manager)
-    long free_page = get_free_data_page(event);
-    
-    // Ensure mapping table is loaded
-    resolve_mapping_mn(event, true);
-    
-    uint dlpn = event.get_logical_address();
-    
-    if (dlpn >= trans_map.size()) return FAILURE;
+    snapshot.get(BML);
 
-    trans_set::iterator it = trans_map.begin() + dlpn;
-    MPage current = *it; // Create a local copy of the mapping entry
+    ulong count = 0;
+    PMD.clear();
+    snapshot.get(count);
+    for (ulong i = 0; i < count && snapshot.good(); i++)
+    {
+        uint lbn;
+        snapshot.get(lbn);
+        snapshot.get(PMD[lbn]);
+    }
 
-    // Invalidate old data if it exists
-    if (current.ppn != -1)
-        event.set_replace_address(Address(current.ppn, PAGE));
+    PMT.clear();
+    snapshot.get(count);
+    for (ulong i = 0; i < count && snapshot.good(); i++)
+    {
+        uint lbn;
+        ulong tables = 0;
+        snapshot.get(lbn);
+        snapshot.get(tables);
+        std::vector< std::vector<long> > &pmt = PMT[lbn];
+        pmt.resize(tables);
+        for (ulong j = 0; j < tables && snapshot.good(); j++)
+            snapshot.get(pmt[j]);
+    }
 
-    // Update the mapping slot in the local copy
-    update_translation_map(current, free_page);
-    
-    // Write the updated mapping back to the container.
-    trans_map.replace(it, current);
+    snapshot.get(has_current_block);
+    snapshot.get(current_block);
+    snapshot.get(current_page_offset);
 
-    //Atomic Write
-    // Write Data and OOB (Mapping) simultaneously.
-    event.set_address(Address(free_page, PAGE));
-    
-    controller.stats.numFTLWrite++;
-    return controller.issue(event);
+    // The OOB LPNs follow from the page tables
+    page_lpn.assign(page_lpn.size(), -1);
+    for (std::map<uint, std::vector< std::vector<long> >>::const_iterator it = PMT.begin(); it != PMT.end(); ++it)
+        for (uint i = 0; i < it->second.size(); i++)
+            for (uint slot = 0; slot < it->second[i].size(); slot++)
+                if (it->second[i][slot] != -1)
+                    page_lpn[it->second[i][slot]] = (long)it->first * P + i * Q + slot;
+    update_map_memory();
 }
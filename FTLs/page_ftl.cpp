@@ -23,6 +23,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <math.h>
+#include <algorithm>
 #include "../ssd.h"
 
 using namespace ssd;
@@ -30,10 +31,15 @@ using namespace ssd;
 FtlImpl_Page::FtlImpl_Page(Controller &controller):
 	FtlParent(controller)
 {
-	trim_map = new bool[NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE];
+	trim_map.assign(NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE, false);
 
 	numPagesActive = 0;
 
+	// Pages are not placed, the page map a page FTL needs is only modelled
+	set_memory(add_memory("page map"), NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE * MAP_ENTRY_BYTES);
+	trim_map_memory = add_memory("trim map");
+	set_memory(trim_map_memory, trim_map.size() / 8);
+
 	return;
 }
 
@@ -64,12 +70,12 @@ enum status FtlImpl_Page::write(Event &event)
 	{
 		numPagesActive -= BLOCK_SIZE;
 
-		Event eraseEvent = Event(ERASE, event.get_logical_address(), 1, event.get_start_time());
+		Event eraseEvent = Event(ERASE, event.get_logical_address(), 1, event.get_sub_event_time());
 		eraseEvent.set_address(Address(0, PAGE));
 
 		if (controller.issue(eraseEvent) == FAILURE) printf("Erase failed");
 
-		event.incr_time_taken(eraseEvent.get_time_taken());
+		event.incr_time_taken(eraseEvent.get_time_taken(), COMPONENT_GC);
 
 		controller.stats.numFTLErase++;
 	}
@@ -82,32 +88,44 @@ enum status FtlImpl_Page::write(Event &event)
 
 enum status FtlImpl_Page::trim(Event &event)
 {
-	controller.stats.numFTLTrim++;
-
-	uint dlpn = event.get_logical_address();
-
-	if (!trim_map[event.get_logical_address()])
-		trim_map[event.get_logical_address()] = true;
+	controller.stats.numFTLTrim += event.get_size();
 
-	// Update trim map and update block map if all pages are trimmed. i.e. the state are reseted to optimal.
-	long addressStart = dlpn - dlpn % BLOCK_SIZE;
-	bool allTrimmed = true;
-	for (uint i=addressStart;i<addressStart+BLOCK_SIZE;i++)
-	{
-		if (!trim_map[i])
-			allTrimmed = false;
-	}
+	ulong start = event.get_logical_address();
+	ulong end = start + event.get_size();
 
-	if (allTrimmed)
+	// Handle the extent one logical block at a time.
+	for (ulong addressStart = start - start % BLOCK_SIZE; addressStart < end; addressStart += BLOCK_SIZE)
 	{
-		Event eraseEvent = Event(ERASE, event.get_logical_address(), 1, event.get_start_time());
+		ulong first = std::max(start, addressStart);
+		ulong last = std::min(end, addressStart + BLOCK_SIZE);
+
+		for (ulong i=first;i<last;i++)
+			trim_map[i] = true;
+
+		// Update trim map and update block map if all pages are trimmed. i.e. the state are reseted to optimal.
+		// A block covered by the extent is trimmed without looking at the map.
+		bool allTrimmed = (last - first == BLOCK_SIZE);
+		if (!allTrimmed)
+		{
+			allTrimmed = true;
+			for (ulong i=addressStart;i<addressStart+BLOCK_SIZE;i++)
+			{
+				if (!trim_map[i])
+					allTrimmed = false;
+			}
+		}
+
+		if (!allTrimmed)
+			continue;
+
+		Event eraseEvent = Event(ERASE, event.get_logical_address(), 1, event.get_sub_event_time());
 		eraseEvent.set_address(Address(0, PAGE));
 
 		if (controller.issue(eraseEvent) == FAILURE) printf("Erase failed");
 
-		event.incr_time_taken(eraseEvent.get_time_taken());
+		event.incr_time_taken(eraseEvent.get_time_taken(), COMPONENT_GC);
 
-		for (uint i=addressStart;i<addressStart+BLOCK_SIZE;i++)
+		for (ulong i=addressStart;i<addressStart+BLOCK_SIZE;i++)
 			trim_map[i] = false;
 
 		controller.stats.numFTLErase++;
@@ -117,3 +135,33 @@ enum status FtlImpl_Page::trim(Event &event)
 
 	return SUCCESS;
 }
+
+void FtlImpl_Page::get_host_memory(std::vector<Ftl_memory> &usage) const
+{
+	usage[trim_map_memory].host = trim_map.capacity() / 8;
+}
+
+void FtlImpl_Page::save(Snapshot &snapshot) const
+{
+	snapshot.put(numPagesActive);
+	snapshot.put(trim_map);
+}
+
+void FtlImpl_Page::load(Snapshot &snapshot)
+{
+	snapshot.get(numPagesActive);
+	snapshot.get(trim_map);
+}
+
+/* Pages are not placed by this FTL, only the active page count is kept */
+enum status FtlImpl_Page::precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed)
+{
+	if (numPagesActive != 0)
+	{
+		fprintf(stderr, "Page FTL error: %s: only a fresh drive can be preconditioned\n", __func__);
+		return FAILURE;
+	}
+
+	numPagesActive = (ulong) (fill_fraction * NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE + 0.5);
+	return SUCCESS;
+}
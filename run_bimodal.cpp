@@ -34,6 +34,10 @@ using namespace ssd;
  * 4. Create a report with shows the differences in response time using CDF's.
  *
  * Test assumes a 6GB SSD, with Block-size 64 and Page size 2048 bytes.
+ *
+ * Usage: ./bimodal [fast]
+ * With "fast", step 1 preconditions the device with a random fill of the
+ * startup area instead of simulating the random writes.
  */
 
 int main(int argc, char **argv){
@@ -109,16 +113,25 @@ int main(int argc, char **argv){
 	// 1. Write random to the size of the device
 	srand(1);
 	double afterFormatStartTime = 0;
-	//for (int i=0; i<preIO/3*2;i++)
-	for (int i=0; i<preIO*1.1;i++)
-	//for (int i=0; i<700000;i++)
+	if (argc >= 2 && strcmp(argv[1], "fast") == 0)
 	{
-		long int r = random()%preIO;
-		double d = ssd.event_arrive(WRITE, r, 1, afterFormatStartTime);
-		afterFormatStartTime += d;
-
-		if (i % 10000 == 0)
-			printf("Wrote %i %f\n", i,d );
+		double fill = (double) preIO / ((double) NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE);
+		if (ssd.precondition(PRECONDITION_RANDOM, fill, 1) != SUCCESS)
+			return 1;
+	}
+	else
+	{
+		//for (int i=0; i<preIO/3*2;i++)
+		for (int i=0; i<preIO*1.1;i++)
+		//for (int i=0; i<700000;i++)
+		{
+			long int r = random()%preIO;
+			double d = ssd.event_arrive(WRITE, r, 1, afterFormatStartTime);
+			afterFormatStartTime += d;
+
+			if (i % 10000 == 0)
+				printf("Wrote %i %f\n", i,d );
+		}
 	}
 
 	start_time = afterFormatStartTime;
@@ -131,16 +144,17 @@ int main(int argc, char **argv){
 	int endTrim = 3072*64; //196608
 
 	/* Test 1 */
-	for (int i=startTrim; i<endTrim;i++)
+	// Trims are sent as one extent per block.
+	for (int i=startTrim; i<endTrim;i+=BLOCK_SIZE)
 	{
 
-		trim_time = ssd.event_arrive(TRIM, i, 1, ((start_time+arrive_time)*timeMultiplier));
+		trim_time = ssd.event_arrive(TRIM, i, BLOCK_SIZE, ((start_time+arrive_time)*timeMultiplier));
 		avgsTrim.push_back(trim_time);
 		num_trims++;
 
 		arrive_time += trim_time;
 
-		if (i % 1000 == 0)
+		if (i % (BLOCK_SIZE*16) == 0)
 			printf("Trim: %i %f\n", i, trim_time);
 
 	}
@@ -202,10 +216,10 @@ int main(int argc, char **argv){
 	}
 
 	/* Test 1 */
-	for (int i=startTrim; i<endTrim;i++)
+	for (int i=startTrim; i<endTrim;i+=BLOCK_SIZE)
 	{
 
-		trim_time = ssd.event_arrive(TRIM, i, 1, ((start_time+arrive_time)*timeMultiplier));
+		trim_time = ssd.event_arrive(TRIM, i, BLOCK_SIZE, ((start_time+arrive_time)*timeMultiplier));
 		avgsTrim2.push_back(trim_time);
 		num_trims++;
 
@@ -0,0 +1,124 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* run_counting.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Counting mode test
+ *
+ * Runs the same workload on the configured FTL twice, timed and in counting
+ * mode (COUNTING_MODE), and checks that both leave the same GC, erase and
+ * FTL counters.  Prints the run time of both modes.
+ *
+ * Usage: ./counting [fill_fraction] [ops_multiplier] [seed]
+ * The first fill_fraction of the drive is written sequentially, then
+ * ops_multiplier times as many random requests (70% writes) follow. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "ssd.h"
+
+using namespace ssd;
+
+struct Counter
+{
+	const char *name;
+	long Stats::*member;
+};
+
+static const Counter counters[] = {
+	{"FTL reads", &Stats::numFTLRead},
+	{"FTL writes", &Stats::numFTLWrite},
+	{"FTL erases", &Stats::numFTLErase},
+	{"FTL copy-backs", &Stats::numFTLCopyBack},
+	{"GC reads", &Stats::numGCRead},
+	{"GC writes", &Stats::numGCWrite},
+	{"GC erases", &Stats::numGCErase},
+	{"Valid page copies", &Stats::valid_page_copies},
+	{"WL reads", &Stats::numWLRead},
+	{"WL writes", &Stats::numWLWrite},
+	{"WL erases", &Stats::numWLErase},
+	{"Switch merges", &Stats::numLogMergeSwitch},
+	{"Partial merges", &Stats::numLogMergePartial},
+	{"Full merges", &Stats::numLogMergeFull},
+	{"Block conversions", &Stats::numPageBlockToPageConversion},
+	{"Cache hits", &Stats::numCacheHits},
+	{"Cache faults", &Stats::numCacheFaults},
+	{NULL, NULL}
+};
+
+/* Runs the workload on a new drive and returns its run time in seconds */
+static double run(double fill_fraction, double ops_mul, uint64_t seed, Stats &stats)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	Ssd ssd;
+	Random random(seed);
+	ulong pages = (ulong) (fill_fraction * NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE);
+	ulong ops = (ulong) (ops_mul * pages);
+	double now = 0.0;
+
+	for (ulong lpn = 0; lpn < pages; lpn++, now += 1.0)
+		ssd.event_arrive(WRITE, lpn, 1, now);
+
+	for (ulong i = 0; i < ops; i++, now += 1.0)
+	{
+		ulong lpn = random.below(pages);
+		ssd.event_arrive(random.uniform() < 0.7 ? WRITE : READ, lpn, 1, now);
+	}
+
+	stats = ssd.get_controller().stats;
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+	double fill_fraction = (argc >= 2) ? atof(argv[1]) : 0.5;
+	double ops_mul = (argc >= 3) ? atof(argv[2]) : 2.0;
+	uint64_t seed = (argc >= 4) ? atoll(argv[3]) : 1;
+
+	load_config();
+	print_config(NULL);
+	printf("\n");
+
+	Stats timed, counted;
+	char name[] = "COUNTING_MODE";
+	load_entry(name, 0, 0);
+	double timed_time = run(fill_fraction, ops_mul, seed, timed);
+	load_entry(name, 1, 0);
+	double counted_time = run(fill_fraction, ops_mul, seed, counted);
+
+	int mismatches = 0;
+	printf("%-20s %14s %14s\n", "", "timed", "counting");
+	for (uint i = 0; counters[i].name != NULL; i++)
+	{
+		long a = timed.*counters[i].member;
+		long b = counted.*counters[i].member;
+		printf("%-20s %14ld %14ld%s\n", counters[i].name, a, b, a == b ? "" : "  MISMATCH");
+		if (a != b)
+			mismatches++;
+	}
+	printf("%-20s %14.3f %14.3f  (%.1fx)\n", "Run time (s)", timed_time, counted_time, timed_time / counted_time);
+
+	if (mismatches > 0)
+	{
+		fprintf(stderr, "Counting mode differs from the timed mode in %d counters\n", mismatches);
+		return 1;
+	}
+	printf("Counting mode matches the timed mode\n");
+	return 0;
+}
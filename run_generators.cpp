@@ -0,0 +1,200 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* run_generators.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Workload generator test
+ *
+ * Draws requests from every Generator and checks them against their
+ * distributions: page frequencies for uniform, Zipf and hot/cold, the
+ * address sequence for stride and phase switches.  Then times how many
+ * requests per second each generator fills with next_batch().
+ *
+ * Usage: ./generators */
+
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include "ssd.h"
+
+using namespace ssd;
+
+static const uint BATCH = 4096;
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+	printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+/* Page counts of draws requests */
+static std::vector<ulong> histogram(Generator &generator, ulong draws, double *write_share = NULL)
+{
+	std::vector<ulong> counts(generator.get_pages(), 0);
+	std::vector<Trace_request> batch;
+	ulong drawn = 0, writes = 0;
+	while (drawn < draws)
+	{
+		generator.next_batch(batch, BATCH);
+		for (uint i = 0; i < batch.size(); i++)
+		{
+			counts[batch[i].logical_address]++;
+			if (batch[i].type == WRITE)
+				writes++;
+		}
+		drawn += batch.size();
+	}
+	if (write_share != NULL)
+		*write_share = (double) writes / drawn;
+	return counts;
+}
+
+static void test_uniform(void)
+{
+	Uniform_generator generator(1000, 0.7, 1);
+	double write_share;
+	std::vector<ulong> counts = histogram(generator, 2000000, &write_share);
+	ulong total = 0;
+	double worst = 0.0;
+	for (uint i = 0; i < counts.size(); i++)
+		total += counts[i];
+	for (uint i = 0; i < counts.size(); i++)
+		worst = std::max(worst, fabs(counts[i] * 1000.0 / total - 1.0));
+	check(worst < 0.1, "uniform: every page within 10% of its share");
+	check(fabs(write_share - 0.7) < 0.005, "uniform: write ratio 0.7");
+
+	Uniform_generator large(1UL << 40, 0.5, 2);
+	std::vector<Trace_request> batch;
+	large.next_batch(batch, BATCH);
+	ulong above = 0;
+	bool in_range = true;
+	for (uint i = 0; i < batch.size(); i++)
+	{
+		in_range = in_range && batch[i].logical_address < (1UL << 40);
+		above += batch[i].logical_address >= (1UL << 31);
+	}
+	check(in_range && above > BATCH * 0.99, "uniform: 2^40 pages, addresses past 2^31");
+}
+
+static void test_zipf(double exponent)
+{
+	const ulong pages = 1000;
+	Zipf_generator generator(pages, exponent, 0.5, 3);
+	std::vector<ulong> counts = histogram(generator, 4000000);
+
+	double norm = 0.0;
+	ulong total = 0;
+	for (ulong k = 1; k <= pages; k++)
+		norm += pow((double) k, -exponent);
+	for (ulong i = 0; i < pages; i++)
+		total += counts[i];
+
+	double worst = 0.0;
+	for (ulong k = 1; k <= 10; k++)
+	{
+		double expected = pow((double) k, -exponent) / norm;
+		worst = std::max(worst, fabs((double) counts[k - 1] / total / expected - 1.0));
+	}
+	char what[80];
+	snprintf(what, sizeof(what), "zipf %.2f: ten hottest pages within 2%% of k^-s / H", exponent);
+	check(worst < 0.02, what);
+}
+
+static void test_hot_cold(void)
+{
+	Hot_cold_generator generator(1000, 0.2, 0.8, 0.5, 4);
+	std::vector<ulong> counts = histogram(generator, 1000000);
+	ulong hot = 0, total = 0;
+	for (uint i = 0; i < counts.size(); i++)
+	{
+		total += counts[i];
+		if (i < 200)
+			hot += counts[i];
+	}
+	check(fabs((double) hot / total - 0.8) < 0.005, "hot/cold 20%/80%: 80% of requests to the hot pages");
+}
+
+static void test_stride_and_phases(void)
+{
+	Stride_generator stride(10, 3, 1.0, 5, 1.0, 8);
+	std::vector<Trace_request> batch;
+	stride.next_batch(batch, 5);
+	static const ulong expected[] = {8, 1, 4, 7, 0};
+	bool ok = true;
+	for (uint i = 0; i < 5; i++)
+		ok = ok && batch[i].logical_address == expected[i] && batch[i].type == WRITE;
+	check(ok, "stride 3 from page 8 over 10 pages wraps around");
+
+	Phase_generator phases;
+	phases.add_phase(new Stride_generator(100, 1, 1.0, 6), 3);
+	phases.add_phase(new Stride_generator(100, 1, 0.0, 7, 2.0, 50), 2);
+	phases.next_batch(batch, 7);
+	static const ulong addresses[] = {0, 1, 2, 50, 51, 3, 4};
+	static const double times[] = {0, 1, 2, 3, 5, 7, 8};
+	ok = true;
+	for (uint i = 0; i < 7; i++)
+		ok = ok && batch[i].logical_address == addresses[i] && batch[i].time == times[i]
+				&& batch[i].type == (addresses[i] >= 50 ? READ : WRITE);
+	check(ok, "phases alternate with continuous arrival times");
+}
+
+static void time_generator(const char *name, Generator &generator)
+{
+	const ulong draws = 10000000;
+	std::vector<Trace_request> batch;
+	volatile ulong sink = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (ulong drawn = 0; drawn < draws; drawn += BATCH)
+	{
+		generator.next_batch(batch, BATCH);
+		sink = batch[BATCH - 1].logical_address;
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	(void) sink;
+	printf("%-12s %8.1f M requests/s\n", name, draws / elapsed / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+	test_uniform();
+	test_zipf(0.99);
+	test_zipf(1.0);
+	test_zipf(1.5);
+	test_zipf(0.5);
+	test_hot_cold();
+	test_stride_and_phases();
+
+	printf("\n");
+	Uniform_generator uniform(1UL << 30, 0.7, 1);
+	Zipf_generator zipf(1UL << 30, 0.99, 0.7, 1);
+	Hot_cold_generator hot_cold(1UL << 30, 0.2, 0.8, 0.7, 1);
+	Stride_generator sequential(1UL << 30, 1, 0.7, 1);
+	time_generator("uniform", uniform);
+	time_generator("zipf", zipf);
+	time_generator("hot/cold", hot_cold);
+	time_generator("sequential", sequential);
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "%d generator checks failed\n", failures);
+		return 1;
+	}
+	printf("All generator checks passed\n");
+	return 0;
+}
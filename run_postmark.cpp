@@ -1,54 +1,214 @@
 /* postmark.cpp - Postmark-equivalent random R/W workload (steady-state)
  * Usage:
- *   ./postmark <dataset_MB> <write_ratio> [ops_multiplier] [warmup_multiplier] [seed]
+ *   ./postmark <dataset_MB> <write_ratio> [ops_multiplier] [warmup_multiplier] [seed] [replications] [ci_target] [threads] [snapshot] [prefill]
  *
  * Recommended:
  *   ops_multiplier    = 20  (measured ops = working_set_pages * 20)
  *   warmup_multiplier =  2  (warmup ops   = working_set_pages * 2)
  *
+ * With replications > 1, seeds seed .. seed+replications-1 run in parallel
+ * on `threads` threads (0 = all cores) and every metric is reported as
+ * mean and 95% confidence interval.  The run stops early once each
+ * interval is within ci_target (relative, e.g. 0.01) of its mean.
+ * Read, write and GC-affected write latency percentiles are reported from
+ * Latency_histograms, merged over all runs when replicating.
+ *
+ * write_ratio may be a comma separated list: the drive is then prefilled
+ * and warmed up once with the first ratio, and the measured phase runs once
+ * per ratio in forked children (at most `threads` at a time) that share the
+ * warmed-up drive copy-on-write.
+ *
+ * With a snapshot prefix, the drive after prefill and warm-up is saved to
+ * <snapshot>.<seed> and later runs with the same dataset, write ratio,
+ * warm-up and seed restore it instead of simulating it again ("-" for none).
+ *
+ * With prefill "fast", the sequential prefill is not simulated: the drive is
+ * preconditioned to the same mapping and page states (Ssd::precondition).
+ *
  * Example:
  *   ./postmark 150 0.8786
  *   ./postmark 200 0.9914
  *   ./postmark 450 0.9879
+ *   ./postmark 150 0.8786 20 2 1 30 0.01
+ *   ./postmark 150 0.8786 20 2 1 1 0 0 /tmp/pm150
+ *   ./postmark 150 0.8786,0.5,0.99
+ *   ./postmark 150 0.8786 20 2 1 1 0 0 - fast
  */
 
 #include "ssd.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 using namespace ssd;
 
 static inline double max2(double a, double b){ return (a > b) ? a : b; }
 
-static inline double urand01() {
-    return (double)rand() / (double)RAND_MAX;
+struct Postmark_result {
+    uint64_t reads, writes;
+    double sum_read_lat, sum_write_lat;
+    double end_time;
+    Stats stats;
+    Latency_histogram read_latency, write_latency, gc_write_latency;
+};
+
+static const char *metric_names[] = {
+    "avg_read_latency", "avg_write_latency", "avg_response_time", "throughput_MBps",
+    "valid_page_copies", "gc_reads", "gc_writes", "gc_erases", "ftl_erases",
+    "p99_read_latency", "p99_write_latency", NULL
+};
+
+/* Restores the drive, generator and clock after prefill and warm-up */
+static bool load_warm_state(const char *name, Ssd &ssd, int dataset_mb, double write_ratio,
+                            int warmup_mul, uint64_t seed, bool fast_prefill, Random &random,
+                            double &now, double &end_time)
+{
+    Snapshot snapshot;
+    if (snapshot.open(name) != SUCCESS)
+        return false;
+
+    int s_dataset_mb = 0, s_warmup_mul = 0;
+    double s_write_ratio = 0.0;
+    uint64_t s_seed = 0;
+    bool s_fast_prefill = false;
+    snapshot.get(s_dataset_mb);
+    snapshot.get(s_write_ratio);
+    snapshot.get(s_warmup_mul);
+    snapshot.get(s_seed);
+    snapshot.get(s_fast_prefill);
+    if (!snapshot.good() || s_dataset_mb != dataset_mb || s_write_ratio != write_ratio ||
+        s_warmup_mul != warmup_mul || s_seed != seed || s_fast_prefill != fast_prefill) {
+        fprintf(stderr, "%s was taken with other workload parameters, rebuilding it\n", name);
+        return false;
+    }
+    // a load that fails part way leaves the drive unusable
+    if (ssd.load(snapshot) != SUCCESS && snapshot.good()) {
+        fprintf(stderr, "%s was taken with another configuration, rebuilding it\n", name);
+        return false;
+    }
+    snapshot.get(random);
+    snapshot.get(now);
+    snapshot.get(end_time);
+    if (snapshot.close() != SUCCESS) {
+        fprintf(stderr, "%s is damaged, remove it and run again\n", name);
+        exit(1);
+    }
+    return true;
 }
 
-int main(int argc, char **argv)
+static void save_warm_state(const char *name, Ssd &ssd, int dataset_mb, double write_ratio,
+                            int warmup_mul, uint64_t seed, bool fast_prefill, Random &random,
+                            double now, double end_time)
 {
-    if (argc < 3) {
-        printf("Usage: %s <dataset_MB> <write_ratio> [ops_multiplier] [warmup_multiplier] [seed]\n", argv[0]);
-        return 1;
+    Snapshot snapshot;
+    if (snapshot.create(name) != SUCCESS)
+        return;
+    snapshot.put(dataset_mb);
+    snapshot.put(write_ratio);
+    snapshot.put(warmup_mul);
+    snapshot.put(seed);
+    snapshot.put(fast_prefill);
+    ssd.save(snapshot);
+    snapshot.put(random);
+    snapshot.put(now);
+    snapshot.put(end_time);
+    if (snapshot.close() != SUCCESS) {
+        fprintf(stderr, "could not write %s\n", name);
+        remove(name);
     }
+}
 
-    int dataset_mb = atoi(argv[1]);
-    double write_ratio = atof(argv[2]);
-    if (write_ratio < 0.0) write_ratio = 0.0;
-    if (write_ratio > 1.0) write_ratio = 1.0;
+static void print_latency(const Postmark_result &r)
+{
+    Latency_histogram::print_header(stdout);
+    if (r.read_latency.size()) r.read_latency.print(stdout, "read");
+    if (r.write_latency.size()) r.write_latency.print(stdout, "write");
+    if (r.gc_write_latency.size()) r.gc_write_latency.print(stdout, "gc_write");
+}
 
-    int ops_mul    = (argc >= 4) ? atoi(argv[3]) : 20;
-    int warmup_mul = (argc >= 5) ? atoi(argv[4]) : 2;
-    int seed       = (argc >= 6) ? atoi(argv[5]) : 1;
+/* Measured phase, continuing from the state after warm-up */
+static void measure(Ssd &ssd, Random random, double now, double end_time, uint64_t working_set_pages,
+                    uint64_t measured_ops, double write_ratio, bool verbose, Postmark_result &r)
+{
+    const double ARRIVAL_GAP_US = 1.0;
 
-    if (ops_mul < 1) ops_mul = 1;
-    if (warmup_mul < 0) warmup_mul = 0;
+    uint64_t writes = 0, reads = 0;
+    double sum_write_lat = 0.0, sum_read_lat = 0.0;
 
-    load_config();
-    print_config(NULL);
-    printf("\n");
+    if (verbose) printf("Measured phase...\n");
+    for (uint64_t i = 0; i < measured_ops; i++) {
+        uint64_t lpn = random.below(working_set_pages);
+        if (random.uniform() < write_ratio) {
+            double lat = ssd.event_arrive(WRITE, (ulong)lpn, 1, now);
+            sum_write_lat += lat;
+            writes++;
+            r.write_latency.add(lat);
+            if (ssd.get_last_reclaimed()) r.gc_write_latency.add(lat);
+            end_time = max2(end_time, now + lat);
+        } else {
+            double lat = ssd.event_arrive(READ, (ulong)lpn, 1, now);
+            sum_read_lat += lat;
+            reads++;
+            r.read_latency.add(lat);
+            end_time = max2(end_time, now + lat);
+        }
+        now += ARRIVAL_GAP_US;
+    }
+
+    r.reads = reads;
+    r.writes = writes;
+    r.sum_read_lat = sum_read_lat;
+    r.sum_write_lat = sum_write_lat;
+    r.end_time = end_time;
+    r.stats = ssd.get_controller().stats;
+
+    if (verbose) {
+        double avg_resp =  (sum_read_lat + sum_write_lat) /  (reads + writes);
+        const double sim_time_us = end_time;
+        const double total_bytes = (double)(writes + reads) * (double)PAGE_SIZE;
+        const double throughput_MBps = (sim_time_us > 0.0)
+            ? (total_bytes / (1024.0 * 1024.0)) / (sim_time_us / 1e6)
+            : 0.0;
+
+        printf("\n==== Postmark Results (Measured Phase) ====\n");
+        if (writes) printf("Avg write latency: %.2f us\n", sum_write_lat / (double)writes);
+        if (reads)  printf("Avg read latency : %.2f us\n", sum_read_lat  / (double)reads );
+        printf("Avg response time: %.2f us\n", avg_resp);
+        printf("Measured ops: R=%llu W=%llu\n", (unsigned long long)reads, (unsigned long long)writes);
+        printf("Sim end time: %.2f us (%.6f s)\n", sim_time_us, sim_time_us / 1e6);
+        printf("Throughput  : %.2f MB/s\n", throughput_MBps);
+        print_latency(r);
+
+        ssd.print_statistics();
+        ssd.print_memory();
+    }
+}
+
+static std::vector<double> metrics(const Postmark_result &r)
+{
+    std::vector<double> m;
+    m.push_back(r.reads ? r.sum_read_lat / (double)r.reads : 0.0);
+    m.push_back(r.writes ? r.sum_write_lat / (double)r.writes : 0.0);
+    m.push_back((r.reads + r.writes) ? (r.sum_read_lat + r.sum_write_lat) / (double)(r.reads + r.writes) : 0.0);
+    m.push_back(r.end_time > 0.0
+        ? ((double)(r.reads + r.writes) * (double)PAGE_SIZE / (1024.0 * 1024.0)) / (r.end_time / 1e6)
+        : 0.0);
+    m.push_back(r.stats.valid_page_copies);
+    m.push_back(r.stats.numGCRead);
+    m.push_back(r.stats.numGCWrite);
+    m.push_back(r.stats.numGCErase);
+    m.push_back(r.stats.numFTLErase);
+    m.push_back(r.read_latency.percentile(99.0));
+    m.push_back(r.write_latency.percentile(99.0));
+    return m;
+}
 
-    srand(seed);
+static void postmark(int dataset_mb, double write_ratio, const std::vector<double> &what_if,
+                     int ops_mul, int warmup_mul, uint64_t seed, const char *snapshot,
+                     bool fast_prefill, uint threads, bool verbose, Postmark_result &r)
+{
+    Random random(seed);
     Ssd ssd;
 
     const uint64_t working_set_pages = (uint64_t)dataset_mb * 1024ULL * 1024ULL / (uint64_t)PAGE_SIZE;
@@ -61,72 +221,161 @@ int main(int argc, char **argv)
     double now = 0.0;
     double end_time = 0.0;
 
-    printf("Postmark-equivalent Random R/W workload\n");
-    printf("Working set: %d MB (%llu pages)\n", dataset_mb, (unsigned long long)working_set_pages);
-    printf("write_ratio=%.4f, warmup_ops=%llu, measured_ops=%llu, seed=%d\n",
-           write_ratio,
-           (unsigned long long)warmup_ops,
-           (unsigned long long)measured_ops,
-           seed);
-
-    // 0) Prefill: ensure every page has been written at least once
-    printf("Prefill (sequential write once)...\n");
-    for (uint64_t lpn = 0; lpn < working_set_pages; lpn++) {
-        double lat = ssd.event_arrive(WRITE, (ulong)lpn, 1, now);
-        end_time = max2(end_time, now + lat);
-        now += ARRIVAL_GAP_US;
+    if (verbose) {
+        printf("Postmark-equivalent Random R/W workload\n");
+        printf("Working set: %d MB (%llu pages)\n", dataset_mb, (unsigned long long)working_set_pages);
+        printf("write_ratio=%.4f, warmup_ops=%llu, measured_ops=%llu, seed=%llu\n",
+               write_ratio,
+               (unsigned long long)warmup_ops,
+               (unsigned long long)measured_ops,
+               (unsigned long long)seed);
     }
 
-    // 1) Warm-up (not measured): drive mapping/GC into steady state
-    printf("Warm-up (not measured)...\n");
-    for (uint64_t i = 0; i < warmup_ops; i++) {
-        uint64_t lpn = (uint64_t)(rand() % (int)working_set_pages);
-        if (urand01() < write_ratio) {
-            double lat = ssd.event_arrive(WRITE, (ulong)lpn, 1, now);
-            end_time = max2(end_time, now + lat);
+    char snapshot_name[4096] = "";
+    if (snapshot != NULL)
+        snprintf(snapshot_name, sizeof(snapshot_name), "%s.%llu", snapshot, (unsigned long long)seed);
+
+    if (snapshot != NULL &&
+        load_warm_state(snapshot_name, ssd, dataset_mb, write_ratio, warmup_mul, seed, fast_prefill,
+                        random, now, end_time)) {
+        if (verbose) printf("Prefill and warm-up restored from %s\n", snapshot_name);
+    } else {
+        // 0) Prefill: ensure every page has been written at least once
+        if (fast_prefill) {
+            if (verbose) printf("Prefill (sequential precondition, not simulated)...\n");
+            double fill = (double)working_set_pages / ((double)NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE);
+            if (ssd.precondition(PRECONDITION_SEQUENTIAL, fill, seed) != SUCCESS)
+                exit(1);
         } else {
-            double lat = ssd.event_arrive(READ, (ulong)lpn, 1, now);
-            end_time = max2(end_time, now + lat);
+            if (verbose) printf("Prefill (sequential write once)...\n");
+            for (uint64_t lpn = 0; lpn < working_set_pages; lpn++) {
+                double lat = ssd.event_arrive(WRITE, (ulong)lpn, 1, now);
+                end_time = max2(end_time, now + lat);
+                now += ARRIVAL_GAP_US;
+            }
         }
-        now += ARRIVAL_GAP_US;
+
+        // 1) Warm-up (not measured): drive mapping/GC into steady state
+        if (verbose) printf("Warm-up (not measured)...\n");
+        for (uint64_t i = 0; i < warmup_ops; i++) {
+            uint64_t lpn = random.below(working_set_pages);
+            if (random.uniform() < write_ratio) {
+                double lat = ssd.event_arrive(WRITE, (ulong)lpn, 1, now);
+                end_time = max2(end_time, now + lat);
+            } else {
+                double lat = ssd.event_arrive(READ, (ulong)lpn, 1, now);
+                end_time = max2(end_time, now + lat);
+            }
+            now += ARRIVAL_GAP_US;
+        }
+
+        if (snapshot != NULL)
+            save_warm_state(snapshot_name, ssd, dataset_mb, write_ratio, warmup_mul, seed, fast_prefill,
+                            random, now, end_time);
     }
 
-    // 2) Measured phase
-    uint64_t writes = 0, reads = 0;
-    double sum_write_lat = 0.0, sum_read_lat = 0.0;
+    if (what_if.empty()) {
+        measure(ssd, random, now, end_time, working_set_pages, measured_ops, write_ratio, verbose, r);
+        return;
+    }
 
-    printf("Measured phase...\n");
-    for (uint64_t i = 0; i < measured_ops; i++) {
-        uint64_t lpn = (uint64_t)(rand() % (int)working_set_pages);
-        if (urand01() < write_ratio) {
-            double lat = ssd.event_arrive(WRITE, (ulong)lpn, 1, now);
-            sum_write_lat += lat;
-            writes++;
-            end_time = max2(end_time, now + lat);
-        } else {
-            double lat = ssd.event_arrive(READ, (ulong)lpn, 1, now);
-            sum_read_lat += lat;
-            reads++;
-            end_time = max2(end_time, now + lat);
-        }
-        now += ARRIVAL_GAP_US;
+    // 2) One measured phase per write ratio, each in a child forked from the warmed-up drive
+    std::vector<std::vector<double> > results;
+    Fork_runner runner(threads);
+    if (verbose) printf("Measured phases (%u forked)...\n", (uint)what_if.size());
+    if (runner.run(what_if.size(), [&](uint i) {
+            Postmark_result child;
+            measure(ssd, random, now, end_time, working_set_pages, measured_ops, what_if[i], false, child);
+            return metrics(child);
+        }, results) != SUCCESS)
+        exit(1);
+
+    printf("\n==== Postmark What-if Results (Measured Phase) ====\n");
+    printf("%-12s", "write_ratio");
+    for (int m = 0; metric_names[m] != NULL; m++)
+        printf(" %18s", metric_names[m]);
+    printf("\n");
+    for (uint i = 0; i < what_if.size(); i++) {
+        printf("%-12.4f", what_if[i]);
+        for (uint m = 0; m < results[i].size(); m++)
+            printf(" %18.2f", results[i][m]);
+        printf("\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        printf("Usage: %s <dataset_MB> <write_ratio> [ops_multiplier] [warmup_multiplier] [seed] [replications] [ci_target] [threads] [snapshot] [prefill]\n", argv[0]);
+        return 1;
     }
 
-    double avg_resp =  (sum_read_lat + sum_write_lat) /  (reads + writes);
-    const double sim_time_us = end_time;
-    const double total_bytes = (double)(writes + reads) * (double)PAGE_SIZE;
-    const double throughput_MBps = (sim_time_us > 0.0)
-        ? (total_bytes / (1024.0 * 1024.0)) / (sim_time_us / 1e6)
-        : 0.0;
+    int dataset_mb = atoi(argv[1]);
+    std::vector<double> what_if;
+    for (char *ratio = argv[2]; ratio != NULL; ratio = strchr(ratio, ',')) {
+        if (*ratio == ',') ratio++;
+        double value = atof(ratio);
+        if (value < 0.0) value = 0.0;
+        if (value > 1.0) value = 1.0;
+        what_if.push_back(value);
+    }
+    double write_ratio = what_if[0];
+    if (what_if.size() == 1)
+        what_if.clear();
+
+    int ops_mul      = (argc >= 4) ? atoi(argv[3]) : 20;
+    int warmup_mul   = (argc >= 5) ? atoi(argv[4]) : 2;
+    int seed         = (argc >= 6) ? atoi(argv[5]) : 1;
+    int replications = (argc >= 7) ? atoi(argv[6]) : 1;
+    double ci_target = (argc >= 8) ? atof(argv[7]) : 0.0;
+    int threads      = (argc >= 9) ? atoi(argv[8]) : 0;
+    const char *snapshot = (argc >= 10 && strcmp(argv[9], "-") != 0) ? argv[9] : NULL;
+    bool fast_prefill    = (argc >= 11) && strcmp(argv[10], "fast") == 0;
+
+    if (ops_mul < 1) ops_mul = 1;
+    if (warmup_mul < 0) warmup_mul = 0;
+    if (replications < 1) replications = 1;
+    if (threads < 0) threads = 0;
+
+    load_config();
+    print_config(NULL);
+    printf("\n");
+
+    if (replications == 1) {
+        Postmark_result r;
+        postmark(dataset_mb, write_ratio, what_if, ops_mul, warmup_mul, seed, snapshot, fast_prefill, threads, true, r);
+        return 0;
+    }
+    if (!what_if.empty()) {
+        fprintf(stderr, "A list of write ratios cannot be combined with replications\n");
+        return 1;
+    }
+
+    std::vector<std::string> names;
+    for (int i = 0; metric_names[i] != NULL; i++)
+        names.push_back(metric_names[i]);
+
+    printf("Postmark replications: dataset=%d MB write_ratio=%.4f seeds %d..%d ci_target=%.4f\n",
+           dataset_mb, write_ratio, seed, seed + replications - 1, ci_target);
+    Replication replication(names);
+    std::vector<Postmark_result> results(replications);
+    replication.run([&](uint run) {
+        Postmark_result &r = results[run];
+        postmark(dataset_mb, write_ratio, what_if, ops_mul, warmup_mul, seed + run, snapshot, fast_prefill, threads, false, r);
+        return metrics(r);
+    }, replications, 3, ci_target, threads);
+
+    // Only the runs the replication counted, not those finishing after the early stop
+    Postmark_result merged;
+    for (uint run = 0; run < replication.size(); run++) {
+        merged.read_latency.merge(results[run].read_latency);
+        merged.write_latency.merge(results[run].write_latency);
+        merged.gc_write_latency.merge(results[run].gc_write_latency);
+    }
 
     printf("\n==== Postmark Results (Measured Phase) ====\n");
-    if (writes) printf("Avg write latency: %.2f us\n", sum_write_lat / (double)writes);
-    if (reads)  printf("Avg read latency : %.2f us\n", sum_read_lat  / (double)reads );
-    printf("Avg response time: %.2f us\n", avg_resp);
-    printf("Measured ops: R=%llu W=%llu\n", (unsigned long long)reads, (unsigned long long)writes);
-    printf("Sim end time: %.2f us (%.6f s)\n", sim_time_us, sim_time_us / 1e6);
-    printf("Throughput  : %.2f MB/s\n", throughput_MBps);
-
-    ssd.print_statistics();
+    replication.print();
+    printf("\nLatency over all runs (us):\n");
+    print_latency(merged);
     return 0;
 }
@@ -42,7 +42,22 @@ int main()
 		cur_time += result;
 	}
 
+	// The same reads again, dispatched to the members as one batch.
+	std::vector<Raid_request> batch(SIZE);
+	for (int i = 0; i < SIZE; i++)
+	{
+		batch[i].type = READ;
+		batch[i].logical_address = i*2;
+		batch[i].size = 1;
+		batch[i].start_time = 0;
+		batch[i].buffer = NULL;
+	}
+	ssd -> event_arrive(batch);
+	for (int i = 0; i < SIZE; i++)
+		cur_time += batch[i].time_taken;
+
 	printf("Total execution time %f\n", cur_time);
+	ssd -> print_imbalance();
 
 	delete ssd;
 	return 0;
@@ -0,0 +1,355 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* run_regression.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Regression checks
+ *
+ * Runs short request sequences that once broke the simulator, each on a new
+ * drive configured from ssd.conf plus a few overrides, and checks the
+ * outcome.  Prints one line per check and exits with the number of failed
+ * checks.
+ *
+ * Usage: ./regression */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+#include "ssd.h"
+
+using namespace ssd;
+
+static void set_entry(const char *name, double value)
+{
+	std::vector<char> entry(name, name + strlen(name) + 1);
+	load_entry(&entry[0], value, 0);
+}
+
+/* Reloads ssd.conf and applies up to three overrides */
+static void configure(const char *name = NULL, double value = 0.0, const char *name2 = NULL, double value2 = 0.0, const char *name3 = NULL, double value3 = 0.0)
+{
+	load_config();
+	if (name != NULL)
+		set_entry(name, value);
+	if (name2 != NULL)
+		set_entry(name2, value2);
+	if (name3 != NULL)
+		set_entry(name3, value3);
+	derive_config();
+}
+
+static int report(const char *check, bool passed)
+{
+	printf("%-50s %s\n", check, passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
+
+/* Entries of the MNFTL block mapping list, from its modelled 4-byte
+ * entries */
+static ulong bml_entries(Ssd &ssd)
+{
+	std::vector<Ftl_memory> usage;
+	ssd.get_memory(usage);
+	for (uint i = 0; i < usage.size(); i++)
+		if (strcmp(usage[i].name, "BML") == 0)
+			return usage[i].sram / 4;
+	return 0;
+}
+
+/* MNFTL reclaims blocks through the block manager, moves valid pages with
+ * copy-back where it can, keeps them readable and drops the reclaimed
+ * blocks from its BML. */
+static int mnftl_gc(void)
+{
+	configure("FTL_IMPLEMENTATION", IMPL_MNFTL);
+
+	Ssd ssd;
+	ulong pages = (ulong) (0.8 * NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE);
+	bool passed = ssd.precondition(PRECONDITION_SEQUENTIAL, 0.8) == SUCCESS;
+
+	Random random(1);
+	double now = 0.0;
+	for (ulong i = 0; i < pages / 2; i++, now += 1.0)
+		ssd.event_arrive(WRITE, random.below(pages), 1, now);
+
+	const Stats &stats = ssd.get_controller().stats;
+	passed = passed && stats.numGCErase > 0 && stats.numFTLCopyBack > 0;
+
+	// Once GC runs, every block that is not free is listed once in the BML
+	ulong blocks = (ulong) SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE;
+	passed = passed && bml_entries(ssd) == blocks - ssd.get_num_free_blocks();
+
+	// An unmapped page is read as a no-op, without touching flash
+	for (ulong lpn = 0; lpn < pages && passed; lpn++, now += 1.0)
+		passed = ssd.event_arrive(READ, lpn, 1, now) >= PAGE_READ_DELAY;
+
+	return report("MNFTL GC with copy-back", passed);
+}
+
+/* A partial TRIM of an optimal BDFTL block leaves the unwritten pages empty
+ * for the in-order writes that follow, and retires the block once every
+ * written page is trimmed. */
+static int bdftl_partial_trim(void)
+{
+	configure("FTL_IMPLEMENTATION", IMPL_BIMODAL);
+
+	Ssd ssd;
+	double now = 0.0;
+	for (ulong lpn = 0; lpn < 10; lpn++, now += 1000.0)
+		ssd.event_arrive(WRITE, lpn, 1, now);
+
+	ssd.event_arrive(TRIM, 20, 10, now);
+	now += 1000.0;
+
+	for (ulong lpn = 10; lpn < 40; lpn++, now += 1000.0)
+		ssd.event_arrive(WRITE, lpn, 1, now);
+
+	bool passed = true;
+	for (ulong lpn = 0; lpn < 40 && passed; lpn++, now += 1000.0)
+		passed = ssd.event_arrive(READ, lpn, 1, now) >= PAGE_READ_DELAY;
+
+	const Stats &stats = ssd.get_controller().stats;
+	long erases = stats.numFTLErase;
+	ssd.event_arrive(TRIM, 0, 40, now);
+	now += 1000.0;
+	passed = passed && stats.numFTLErase == erases + 1;
+
+	for (ulong lpn = 0; lpn < BLOCK_SIZE; lpn++, now += 1000.0)
+		ssd.event_arrive(WRITE, lpn, 1, now);
+
+	return report("BDFTL partial TRIM of an optimal block", passed);
+}
+
+/* Trimming every page of a block erases it and drops it from the MNFTL
+ * BML. */
+static int mnftl_trim(void)
+{
+	configure("FTL_IMPLEMENTATION", IMPL_MNFTL);
+
+	Ssd ssd;
+	ulong blocks = 80;
+	double now = 0.0;
+	for (ulong lpn = 0; lpn < blocks * BLOCK_SIZE; lpn++, now += 1000.0)
+		ssd.event_arrive(WRITE, lpn, 1, now);
+
+	ssd.event_arrive(TRIM, 0, blocks * BLOCK_SIZE, now);
+
+	const Stats &stats = ssd.get_controller().stats;
+	bool passed = stats.numFTLErase == (long) blocks && bml_entries(ssd) == 0;
+	return report("MNFTL TRIM of whole blocks", passed);
+}
+
+/* A partial TRIM of a FAST or BAST data block leaves its unwritten pages
+ * empty: trimming the block in two halves after a single write must not
+ * erase it, and the remaining pages are still written. */
+static int log_ftl_partial_trim(void)
+{
+	static const enum ftl_implementation ftls[] = {IMPL_BAST, IMPL_FAST};
+
+	bool passed = true;
+	for (uint i = 0; i < sizeof(ftls) / sizeof(ftls[0]); i++)
+	{
+		configure("FTL_IMPLEMENTATION", ftls[i]);
+
+		Ssd ssd;
+		double now = 0.0;
+		ssd.event_arrive(WRITE, 0, 1, now);
+		now += 1000.0;
+
+		const Stats &stats = ssd.get_controller().stats;
+		long erases = stats.numFTLErase;
+		ssd.event_arrive(TRIM, 0, BLOCK_SIZE / 2, now);
+		now += 1000.0;
+		ssd.event_arrive(TRIM, BLOCK_SIZE / 2, BLOCK_SIZE / 2, now);
+		now += 1000.0;
+		passed = passed && stats.numFTLErase == erases;
+
+		for (ulong lpn = 1; lpn < BLOCK_SIZE; lpn++, now += 1000.0)
+			ssd.event_arrive(WRITE, lpn, 1, now);
+		for (ulong lpn = 1; lpn < BLOCK_SIZE && passed; lpn++, now += 1000.0)
+			passed = ssd.event_arrive(READ, lpn, 1, now) >= PAGE_READ_DELAY;
+	}
+	return report("BAST and FAST partial TRIM of a data block", passed);
+}
+
+/* Static wear leveling moves cold blocks out even when some of their pages
+ * were overwritten, and their data stays readable. */
+static int static_wear_leveling(void)
+{
+	configure("FTL_IMPLEMENTATION", IMPL_DFTL, "WEAR_LEVEL_THRESHOLD", 2, "WEAR_LEVEL_INTERVAL", 16);
+
+	Ssd ssd;
+	ulong pages = (ulong) (0.8 * NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE);
+	bool passed = ssd.precondition(PRECONDITION_SEQUENTIAL, 0.8) == SUCCESS;
+
+	// One overwritten page in every cold block
+	double now = 0.0;
+	for (ulong lpn = 0; lpn < pages; lpn += BLOCK_SIZE, now += 1000.0)
+		ssd.event_arrive(WRITE, lpn, 1, now);
+
+	// GC wears out the blocks of a small hot set
+	ulong hot = 16 * BLOCK_SIZE;
+	Random random(1);
+	for (ulong i = 0; i < 100000; i++, now += 1000.0)
+		ssd.event_arrive(WRITE, pages - hot + random.below(hot), 1, now);
+
+	const Stats &stats = ssd.get_controller().stats;
+	passed = passed && stats.numWLErase > 0 && stats.numWLWrite > 0;
+
+	for (ulong lpn = 0; lpn < pages && passed; lpn++, now += 1000.0)
+		passed = ssd.event_arrive(READ, lpn, 1, now) >= PAGE_READ_DELAY;
+
+	return report("Static wear leveling of partly overwritten blocks", passed);
+}
+
+/* A restored BAST drive picks the same log block victims as the drive it
+ * was saved from, and so continues with the same latencies. */
+static int bast_snapshot(void)
+{
+	const char *name = "regression_snapshot.bin";
+	configure("FTL_IMPLEMENTATION", IMPL_BAST, "BAST_LOG_BLOCK_LIMIT", 8);
+
+	ulong pages = 64 * BLOCK_SIZE;
+	Random random(1);
+	double now = 0.0;
+	Ssd ssd;
+	for (ulong i = 0; i < 2000; i++, now += 1000.0)
+		ssd.event_arrive(WRITE, random.below(pages), 1, now);
+
+	Snapshot saved;
+	bool passed = saved.create(name) == SUCCESS && ssd.save(saved) == SUCCESS && saved.close() == SUCCESS;
+
+	Random restored_random = random;
+	double restored_now = now;
+	std::vector<double> latencies;
+	for (ulong i = 0; i < 2000; i++, now += 1000.0)
+		latencies.push_back(ssd.event_arrive(WRITE, random.below(pages), 1, now));
+
+	Ssd restored;
+	Snapshot loaded;
+	passed = passed && loaded.open(name) == SUCCESS && restored.load(loaded) == SUCCESS && loaded.close() == SUCCESS;
+	for (ulong i = 0; i < 2000 && passed; i++, restored_now += 1000.0)
+		passed = restored.event_arrive(WRITE, restored_random.below(pages), 1, restored_now) == latencies[i];
+	passed = passed && restored.get_controller().stats.numLogMergeFull == ssd.get_controller().stats.numLogMergeFull;
+	remove(name);
+
+	return report("BAST continues alike after a snapshot", passed);
+}
+
+/* The 95% interval uses the t quantile past the 30 tabulated degrees of
+ * freedom, not the normal quantile. */
+static int t_quantile(void)
+{
+	static const ulong df[] = {40, 60, 120};
+	static const double t95[] = {2.0211, 2.0003, 1.9799};
+
+	bool passed = true;
+	for (uint i = 0; i < sizeof(df) / sizeof(df[0]); i++)
+	{
+		Sample_stats sample;
+		for (ulong j = 0; j <= df[i]; j++)
+			sample.add(j % 2);
+		double t = sample.ci_half_width() * sqrt((double) sample.size()) / sample.stddev();
+		passed = passed && fabs(t - t95[i]) < 1e-3;
+	}
+	return report("t quantile beyond 30 degrees of freedom", passed);
+}
+
+/* Precondition writes take no time, so they must not leave a backlog on
+ * the dies: the first request after a precondition takes as long with die
+ * queueing as without. */
+static double first_request(enum ftl_implementation ftl, bool die_queueing)
+{
+	configure("FTL_IMPLEMENTATION", ftl, "DIE_QUEUEING", die_queueing);
+
+	Ssd ssd;
+	if (ssd.precondition(PRECONDITION_SEQUENTIAL, 0.05) == FAILURE)
+		return -1.0;
+	return ssd.event_arrive(WRITE, 0, 1, 0.0);
+}
+
+static int precondition_die_queueing(void)
+{
+	static const enum ftl_implementation ftls[] = {IMPL_PAGE, IMPL_BAST, IMPL_FAST, IMPL_DFTL, IMPL_BIMODAL, IMPL_MNFTL};
+
+	bool passed = true;
+	for (uint i = 0; i < sizeof(ftls) / sizeof(ftls[0]); i++)
+	{
+		double plain = first_request(ftls[i], false);
+		double queued = first_request(ftls[i], true);
+		if (plain < 0.0 || fabs(queued - plain) > 1e-9 * plain)
+		{
+			fprintf(stderr, "FTL %d: first request after precondition %f us, %f us with die queueing\n", ftls[i], plain, queued);
+			passed = false;
+		}
+	}
+	return report("Die queueing after a precondition", passed);
+}
+
+/* Timeline::stop() may be called while drives on other threads still
+ * record spans. */
+static int timeline_stop_while_running(void)
+{
+	const char *name = "regression_timeline.json";
+	configure();
+
+	if (Timeline::start(name) != SUCCESS)
+		return report("Timeline stop with running drives", false);
+
+	std::atomic<bool> done(false);
+	std::atomic<uint> running(0);
+	std::vector<std::thread> drives;
+	for (uint i = 0; i < 4; i++)
+		drives.push_back(std::thread([&done, &running] {
+			Ssd ssd;
+			double now = 0.0;
+			running++;
+			for (ulong lpn = 0; !done; lpn = (lpn + 1) % (BLOCK_SIZE * 64), now += 1.0)
+				ssd.event_arrive(WRITE, lpn, 1, now);
+		}));
+
+	while (running != drives.size())
+		std::this_thread::yield();
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	bool passed = Timeline::stop() == SUCCESS && Timeline::get_num_spans() > 0;
+	done = true;
+	for (uint i = 0; i < drives.size(); i++)
+		drives[i].join();
+	remove(name);
+
+	return report("Timeline stop with running drives", passed);
+}
+
+int main()
+{
+	int failed = 0;
+	failed += mnftl_gc();
+	failed += bdftl_partial_trim();
+	failed += mnftl_trim();
+	failed += log_ftl_partial_trim();
+	failed += static_wear_leveling();
+	failed += bast_snapshot();
+	failed += t_quantile();
+	failed += precondition_die_queueing();
+	failed += timeline_stop_while_running();
+
+	if (failed > 0)
+		fprintf(stderr, "%d regression checks failed\n", failed);
+	return failed;
+}
@@ -0,0 +1,240 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* run_replay.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Block trace replay
+ *
+ * Replays an MSR Cambridge, SNIA, blkparse or uFLIP text trace on the
+ * configured drive.  Trace_importer parses the trace on its own thread while
+ * the drive simulates.  Three arrival models are available:
+ *
+ * 	sync             - synchronous arrivals as in run_ufliptrace.cpp: every
+ * 	                   page of a request is issued at the request's timestamp
+ * 	                   plus the time the previous pages took (no queueing)
+ * 	open [speedup] [qd]
+ * 	                 - open loop: requests arrive at their timestamps divided
+ * 	                   by speedup and all their pages are issued at once; with
+ * 	                   qd > 0 at most qd requests are outstanding and the rest
+ * 	                   wait in the host queue
+ * 	closed <qd>      - closed loop: timestamps are ignored and a new request
+ * 	                   is issued whenever one of qd outstanding ones completes
+ *
+ * Response time is reported as queue wait plus service.  The queue wait is
+ * the time spent in the host queue plus the time the pages waited for busy
+ * bus channels and, with DIE_QUEUEING 1 (set for open and closed loop
+ * replays), for busy dies.
+ *
+ * Usage: ./replay <format> <trace> [wrap | scale <traced device bytes>]
+ *                 [time_scale] [sync | open [speedup] [qd] | closed <qd>]
+ * time_scale is in simulator time units per trace second (1e6). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <queue>
+#include <algorithm>
+#include "ssd.h"
+
+using namespace ssd;
+
+enum replay_mode {REPLAY_SYNC, REPLAY_OPEN, REPLAY_CLOSED};
+
+struct Replay_stats
+{
+	ulong requests;
+	ulong pages;
+	double response;
+	double queue_wait;
+	double max_response;
+};
+
+static bool is_number(const char *arg)
+{
+	char *end;
+	strtod(arg, &end);
+	return end != arg && *end == '\0';
+}
+
+static void print_row(const char *name, const Replay_stats &stats)
+{
+	double n = stats.requests > 0 ? stats.requests : 1;
+	printf("%-8s %12lu %12lu %14.3f %14.3f %14.3f %14.3f\n", name, stats.requests, stats.pages,
+			stats.response / n, stats.queue_wait / n, (stats.response - stats.queue_wait) / n, stats.max_response);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "Usage: %s <uflip|msr|snia|blkparse> <trace> [wrap | scale <traced device bytes>] [time_scale] [sync | open [speedup] [qd] | closed <qd>]\n", argv[0]);
+		return 1;
+	}
+
+	load_config();
+
+	enum trace_format format;
+	if (Trace_importer::parse_format(argv[1], format) != SUCCESS)
+		return 1;
+
+	enum trace_address_mode address_mode = TRACE_WRAP;
+	ulong trace_pages = 0;
+	double time_scale = 1e6;
+	enum replay_mode mode = REPLAY_SYNC;
+	double speedup = 1.0;
+	ulong qd = 0;
+	for (int arg = 3; arg < argc; arg++)
+	{
+		if (strcmp(argv[arg], "wrap") == 0)
+			address_mode = TRACE_WRAP;
+		else if (strcmp(argv[arg], "scale") == 0 && arg + 1 < argc)
+		{
+			address_mode = TRACE_SCALE;
+			trace_pages = (strtoull(argv[++arg], NULL, 10) + PAGE_SIZE - 1) / PAGE_SIZE;
+		}
+		else if (strcmp(argv[arg], "sync") == 0)
+			mode = REPLAY_SYNC;
+		else if (strcmp(argv[arg], "open") == 0)
+		{
+			mode = REPLAY_OPEN;
+			if (arg + 1 < argc && is_number(argv[arg + 1]))
+				speedup = atof(argv[++arg]);
+			if (arg + 1 < argc && is_number(argv[arg + 1]))
+				qd = strtoul(argv[++arg], NULL, 10);
+		}
+		else if (strcmp(argv[arg], "closed") == 0 && arg + 1 < argc && is_number(argv[arg + 1]))
+		{
+			mode = REPLAY_CLOSED;
+			qd = strtoul(argv[++arg], NULL, 10);
+		}
+		else if (is_number(argv[arg]))
+			time_scale = atof(argv[arg]);
+		else
+		{
+			fprintf(stderr, "Unknown argument %s\n", argv[arg]);
+			return 1;
+		}
+	}
+	if (speedup <= 0.0 || (mode == REPLAY_CLOSED && qd == 0))
+	{
+		fprintf(stderr, "The speed-up and the closed-loop queue depth must be positive\n");
+		return 1;
+	}
+
+	/* requests only queue behind each other inside the drive when dies are
+	 * busy for the length of an operation */
+	if (mode != REPLAY_SYNC)
+	{
+		char name[] = "DIE_QUEUEING";
+		load_entry(name, 1, 0);
+	}
+	print_config(NULL);
+	printf("\n");
+
+	Ssd ssd;
+	Trace_importer trace;
+	if (trace.open(argv[2], format, address_mode, trace_pages, time_scale) != SUCCESS)
+		return 1;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	/* completion times of the outstanding requests when the queue depth is
+	 * limited */
+	std::priority_queue<double, std::vector<double>, std::greater<double> > outstanding;
+
+	Replay_stats stats[2];
+	memset(stats, 0, sizeof(stats));
+	double first_arrival = -1.0;
+	double last_completion = 0.0;
+	Trace_request request;
+	while (trace.next(request))
+	{
+		double arrival = mode == REPLAY_CLOSED ? 0.0 : request.time / speedup;
+		double issue = arrival;
+		if (qd > 0 && outstanding.size() >= qd)
+		{
+			issue = std::max(arrival, outstanding.top());
+			outstanding.pop();
+		}
+
+		/* a closed-loop request arrives when a slot frees up */
+		if (mode == REPLAY_CLOSED)
+			arrival = issue;
+
+		/* time from issue until the last page is done, and the longest
+		 * wait of a page for channels and dies */
+		double device_time = 0.0;
+		double device_wait = 0.0;
+		for (uint i = 0; i < request.size; i++)
+		{
+			if (mode == REPLAY_SYNC)
+			{
+				device_time += ssd.event_arrive(request.type, request.logical_address + i, 1, issue + device_time);
+				device_wait += ssd.get_last_queue_wait();
+			}
+			else
+			{
+				device_time = std::max(device_time, ssd.event_arrive(request.type, request.logical_address + i, 1, issue));
+				device_wait = std::max(device_wait, ssd.get_last_queue_wait());
+			}
+		}
+
+		double completion = issue + device_time;
+		if (qd > 0)
+			outstanding.push(completion);
+		if (first_arrival < 0.0)
+			first_arrival = arrival;
+		last_completion = std::max(last_completion, completion);
+
+		Replay_stats &kind = stats[request.type == READ ? 0 : 1];
+		double response = completion - arrival;
+		kind.requests++;
+		kind.pages += request.size;
+		kind.response += response;
+		kind.queue_wait += (issue - arrival) + device_wait;
+		kind.max_response = std::max(kind.max_response, response);
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	Replay_stats all = stats[0];
+	all.requests += stats[1].requests;
+	all.pages += stats[1].pages;
+	all.response += stats[1].response;
+	all.queue_wait += stats[1].queue_wait;
+	all.max_response = std::max(all.max_response, stats[1].max_response);
+
+	static const char *modes[] = {"synchronous", "open loop", "closed loop"};
+	printf("%s replay", modes[mode]);
+	if (mode == REPLAY_OPEN)
+		printf(", speed-up %g", speedup);
+	if (qd > 0)
+		printf(", queue depth %lu", qd);
+	printf("\n%-8s %12s %12s %14s %14s %14s %14s\n", "", "requests", "pages", "response", "queue wait", "service", "max response");
+	print_row("Read", stats[0]);
+	print_row("Write", stats[1]);
+	print_row("All", all);
+
+	double makespan = last_completion - std::max(first_arrival, 0.0);
+	if (makespan > 0.0)
+		printf("Throughput: %.1f requests/s, %.2f MB/s over %.3f s simulated\n", all.requests * time_scale / makespan,
+				all.pages * (double) PAGE_SIZE * time_scale / makespan / 1e6, makespan / time_scale);
+	printf("Skipped %lu trace lines; replayed %lu requests in %.3f s\n\n", trace.get_skipped(), all.requests, elapsed);
+
+	ssd.print_statistics();
+	return 0;
+}
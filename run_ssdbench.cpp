@@ -0,0 +1,710 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* run_ssdbench.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Scenario driven benchmark
+ *
+ * Usage: ./ssdbench <scenario> [NAME=value ...]
+ *
+ * A scenario file holds one "NAME value ..." entry per line ('#' starts a
+ * comment line).  Entries before the first PHASE line describe the run:
+ *   CONFIG <file>              base configuration (default ssd.conf)
+ *   NAME <name>                scenario name in the results record
+ *   DATASET_MB <mb>            working set; DATASET_PAGES sets it in pages
+ *   SEED <n>                   PRNG seed (default 1)
+ *   ARRIVAL_GAP <us>           default request spacing (default 1)
+ *   PRECONDITION <sequential | random> [fraction]
+ *                              fill that fraction of the working set
+ *                              directly (Ssd::precondition), not simulated
+ *   OUTPUT <file>              append the results record to this file
+ *                              instead of printing it
+ *   TIMESERIES <file> <us> [requests]
+ *                              write windowed metrics of all phases to file
+ *                              every us of simulated time, or every
+ *                              requests requests when us is 0 (Time_series)
+ *   TRACE <file> [begin_us] [end_us]
+ *                              write the flash operations issued between
+ *                              those simulated times as a Chrome trace
+ *                              (Timeline), for chrome://tracing or Perfetto
+ *   any ssd.conf variable      e.g. FTL_IMPLEMENTATION 5
+ *
+ * "PHASE <name>" starts a phase; the phases run in order on one drive and
+ * one clock.  Phase entries:
+ *   OPS <n> | OPS_MULTIPLIER <m>  requests, or m times the working set
+ *   GENERATOR <uniform | sequential | stride <n> | zipf <exponent> |
+ *              hotcold <hot_fraction> <hot_access>>
+ *                              a phase without GENERATOR continues the
+ *                              previous phase's request stream
+ *   WRITE_RATIO <r>            fraction of writes (default 0.5)
+ *   TRIM_RATIO <r>             fraction of trims, taken from the reads
+ *                              (default 0)
+ *   QD <n>                     0: requests arrive ARRIVAL_GAP apart and each
+ *                              one is timed on its own, as in ./postmark;
+ *                              n > 0: closed loop with n outstanding requests
+ *                              (set DIE_QUEUEING 1 to queue behind busy dies)
+ *   ARRIVAL_GAP <us>           request spacing of this phase
+ *   SEED <n>                   generator seed (default SEED + phase number)
+ *   MEASURE <0 | 1>            report this phase (default 1)
+ *
+ * Command line entries override the file: NAME=value sets a run entry or a
+ * configuration variable, phase.NAME=value an entry of that phase, e.g.
+ *   ./ssdbench scenarios/postmark.scenario FTL_IMPLEMENTATION=5 measure.WRITE_RATIO=0.5
+ * and several values are separated by commas, e.g. TIMESERIES=ts.csv,10000.
+ *
+ * Every measured phase is summarised on stdout.  The results record is one
+ * line of JSON with the scenario, the configuration overrides and, for every
+ * measured phase, its latencies, throughput, the FTL and GC counters the
+ * phase added and the latency percentiles of reads, writes, trims and writes
+ * that waited for garbage collection (Latency_histogram), also split into
+ * flash, bus wait, die wait, mapping and GC time (enum latency_component).
+ * The record ends with the modelled SRAM and the simulator memory of the FTL
+ * mapping structures (Ftl_memory). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <queue>
+#include <chrono>
+#include <algorithm>
+#include "ssd.h"
+
+using namespace ssd;
+
+struct Config_entry
+{
+	std::string name;
+	double value;
+};
+
+struct Phase
+{
+	std::string name;
+	ulong ops;
+	double ops_mul;
+	std::vector<std::string> generator;
+	double write_ratio;
+	bool has_write_ratio;
+	double trim_ratio;
+	bool has_trim_ratio;
+	uint qd;
+	double gap;
+	uint64_t seed;
+	bool has_seed;
+	bool measure;
+};
+
+struct Scenario
+{
+	std::string name;
+	std::string config_name;
+	std::string output_name;
+	double dataset_mb;
+	ulong dataset_pages;
+	uint64_t seed;
+	double gap;
+	std::string precondition;
+	double precondition_fraction;
+	std::string timeseries_name;
+	double timeseries_interval;
+	ulong timeseries_requests;
+	std::string trace_name;
+	double trace_begin;
+	double trace_end;
+	std::vector<Config_entry> config;
+	std::vector<Phase> phases;
+};
+
+struct Phase_result
+{
+	ulong reads;
+	ulong writes;
+	ulong trims;
+	double read_latency;
+	double write_latency;
+	double max_response;
+	double queue_wait;
+	double start;
+	double end;
+	double wall_time;
+	Stats stats;
+	Latency_histogram latency[4];
+	Latency_histogram breakdown[4][LATENCY_COMPONENTS];
+};
+
+/* Latency classes; writes that waited for garbage collection, a merge or an
+ * erase are also counted as GC writes */
+enum latency_class {LATENCY_READ, LATENCY_WRITE, LATENCY_TRIM, LATENCY_GC_WRITE, LATENCY_CLASSES};
+static const char *latency_names[] = {"read", "write", "trim", "gc_write"};
+static const char *component_names[] = {"flash", "bus_wait", "die_wait", "mapping", "gc"};
+
+struct Counter
+{
+	const char *name;
+	long Stats::*member;
+};
+
+static const Counter counters[] = {
+	{"numFTLRead", &Stats::numFTLRead},
+	{"numFTLWrite", &Stats::numFTLWrite},
+	{"numFTLErase", &Stats::numFTLErase},
+	{"numGCRead", &Stats::numGCRead},
+	{"numGCWrite", &Stats::numGCWrite},
+	{"numGCErase", &Stats::numGCErase},
+	{"valid_page_copies", &Stats::valid_page_copies},
+	{"numWLRead", &Stats::numWLRead},
+	{"numWLWrite", &Stats::numWLWrite},
+	{"numWLErase", &Stats::numWLErase},
+	{"numLogMergeSwitch", &Stats::numLogMergeSwitch},
+	{"numLogMergePartial", &Stats::numLogMergePartial},
+	{"numLogMergeFull", &Stats::numLogMergeFull},
+	{"numCacheHits", &Stats::numCacheHits},
+	{"numCacheFaults", &Stats::numCacheFaults},
+	{NULL, NULL}
+};
+
+static Phase new_phase(const std::string &name)
+{
+	Phase phase;
+	phase.name = name;
+	phase.ops = 0;
+	phase.ops_mul = 0.0;
+	phase.write_ratio = 0.5;
+	phase.has_write_ratio = false;
+	phase.trim_ratio = 0.0;
+	phase.has_trim_ratio = false;
+	phase.qd = 0;
+	phase.gap = -1.0;
+	phase.seed = 0;
+	phase.has_seed = false;
+	phase.measure = true;
+	return phase;
+}
+
+static bool set_phase_entry(Phase &phase, const std::string &name, const std::vector<std::string> &values)
+{
+	if (name == "OPS")
+	{
+		phase.ops = strtoul(values[0].c_str(), NULL, 10);
+		phase.ops_mul = 0.0;
+	}
+	else if (name == "OPS_MULTIPLIER")
+	{
+		phase.ops_mul = atof(values[0].c_str());
+		phase.ops = 0;
+	}
+	else if (name == "GENERATOR")
+		phase.generator = values;
+	else if (name == "WRITE_RATIO")
+	{
+		phase.write_ratio = atof(values[0].c_str());
+		phase.has_write_ratio = true;
+	}
+	else if (name == "TRIM_RATIO")
+	{
+		phase.trim_ratio = atof(values[0].c_str());
+		phase.has_trim_ratio = true;
+	}
+	else if (name == "QD")
+		phase.qd = atoi(values[0].c_str());
+	else if (name == "ARRIVAL_GAP")
+		phase.gap = atof(values[0].c_str());
+	else if (name == "SEED")
+	{
+		phase.seed = strtoull(values[0].c_str(), NULL, 10);
+		phase.has_seed = true;
+	}
+	else if (name == "MEASURE")
+		phase.measure = atoi(values[0].c_str()) != 0;
+	else
+		return false;
+	return true;
+}
+
+static void set_entry(Scenario &scenario, const std::string &name, const std::vector<std::string> &values)
+{
+	if (name == "CONFIG")
+		scenario.config_name = values[0];
+	else if (name == "NAME")
+		scenario.name = values[0];
+	else if (name == "OUTPUT")
+		scenario.output_name = values[0];
+	else if (name == "DATASET_MB")
+	{
+		scenario.dataset_mb = atof(values[0].c_str());
+		scenario.dataset_pages = 0;
+	}
+	else if (name == "DATASET_PAGES")
+		scenario.dataset_pages = strtoul(values[0].c_str(), NULL, 10);
+	else if (name == "SEED")
+		scenario.seed = strtoull(values[0].c_str(), NULL, 10);
+	else if (name == "ARRIVAL_GAP")
+		scenario.gap = atof(values[0].c_str());
+	else if (name == "PRECONDITION")
+	{
+		scenario.precondition = values[0];
+		scenario.precondition_fraction = values.size() > 1 ? atof(values[1].c_str()) : 1.0;
+	}
+	else if (name == "TIMESERIES")
+	{
+		scenario.timeseries_name = values[0];
+		scenario.timeseries_interval = values.size() > 1 ? atof(values[1].c_str()) : 0.0;
+		scenario.timeseries_requests = values.size() > 2 ? strtoul(values[2].c_str(), NULL, 10) : 0;
+	}
+	else if (name == "TRACE")
+	{
+		scenario.trace_name = values[0];
+		scenario.trace_begin = values.size() > 1 ? atof(values[1].c_str()) : 0.0;
+		scenario.trace_end = values.size() > 2 ? atof(values[2].c_str()) : -1.0;
+	}
+	else
+	{
+		Config_entry entry = {name, atof(values[0].c_str())};
+		scenario.config.push_back(entry);
+	}
+}
+
+static void parse_scenario(const char *scenario_name, Scenario &scenario)
+{
+	FILE *file = fopen(scenario_name, "r");
+	if (file == NULL)
+	{
+		fprintf(stderr, "Scenario %s not found.  Exiting.\n", scenario_name);
+		exit(FILE_ERR);
+	}
+
+	char line[1024];
+	for (uint line_number = 1; fgets(line, sizeof(line), file) != NULL; line_number++)
+	{
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		char *name = strtok(line, " \t\r\n");
+		if (name == NULL)
+			continue;
+		std::vector<std::string> values;
+		for (char *value = strtok(NULL, " \t\r\n"); value != NULL; value = strtok(NULL, " \t\r\n"))
+			values.push_back(value);
+		if (values.empty())
+		{
+			fprintf(stderr, "Scenario parsing error on line %u\n", line_number);
+			continue;
+		}
+
+		if (!strcmp(name, "PHASE"))
+			scenario.phases.push_back(new_phase(values[0]));
+		else if (scenario.phases.empty())
+			set_entry(scenario, name, values);
+		else if (!set_phase_entry(scenario.phases.back(), name, values))
+			fprintf(stderr, "Scenario parsing error on line %u: %s is not a phase entry\n", line_number, name);
+	}
+	fclose(file);
+}
+
+/* Applies a NAME=value or phase.NAME=value override */
+static bool apply_override(Scenario &scenario, const char *argument)
+{
+	const char *equals = strchr(argument, '=');
+	if (equals == NULL || equals == argument || equals[1] == '\0')
+		return false;
+	std::string name(argument, equals - argument);
+	/* entries with several values separate them with commas */
+	std::vector<std::string> values;
+	for (const char *value = equals + 1; ; )
+	{
+		const char *comma = strchr(value, ',');
+		if (comma == NULL)
+		{
+			values.push_back(value);
+			break;
+		}
+		values.push_back(std::string(value, comma - value));
+		value = comma + 1;
+	}
+
+	size_t dot = name.find('.');
+	if (dot == std::string::npos)
+	{
+		set_entry(scenario, name, values);
+		return true;
+	}
+	for (uint i = 0; i < scenario.phases.size(); i++)
+		if (scenario.phases[i].name == name.substr(0, dot))
+			return set_phase_entry(scenario.phases[i], name.substr(dot + 1), values);
+	return false;
+}
+
+static Generator *make_generator(const Scenario &scenario, const Phase &phase, uint index)
+{
+	const std::vector<std::string> &words = phase.generator;
+	ulong pages = scenario.dataset_pages;
+	uint64_t seed = phase.has_seed ? phase.seed : scenario.seed + index;
+	double gap = phase.gap >= 0.0 ? phase.gap : scenario.gap;
+
+	if (words[0] == "uniform")
+		return new Uniform_generator(pages, phase.write_ratio, seed, gap);
+	if (words[0] == "sequential")
+		return new Stride_generator(pages, 1, phase.write_ratio, seed, gap);
+	if (words[0] == "stride" && words.size() >= 2)
+		return new Stride_generator(pages, strtoul(words[1].c_str(), NULL, 10), phase.write_ratio, seed, gap);
+	if (words[0] == "zipf" && words.size() >= 2)
+		return new Zipf_generator(pages, atof(words[1].c_str()), phase.write_ratio, seed, gap);
+	if (words[0] == "hotcold" && words.size() >= 3)
+		return new Hot_cold_generator(pages, atof(words[1].c_str()), atof(words[2].c_str()), phase.write_ratio, seed, gap);
+	fprintf(stderr, "Phase %s: unknown generator %s\n", phase.name.c_str(), words[0].c_str());
+	return NULL;
+}
+
+/* Adds the latency of the last request and its components */
+static void record(const Ssd &ssd, Phase_result &r, enum latency_class k, double latency)
+{
+	r.latency[k].add(latency);
+	for (uint c = 0; c < LATENCY_COMPONENTS; c++)
+		r.breakdown[k][c].add(ssd.get_last_component_time((enum latency_component) c));
+}
+
+/* Runs one phase from time now and returns the time the next phase starts */
+static double run_phase(Ssd &ssd, Generator &generator, const Phase &phase, ulong ops, double now, Phase_result &r, Time_series *series)
+{
+	std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+	r.reads = r.writes = r.trims = 0;
+	r.read_latency = r.write_latency = 0.0;
+	r.max_response = r.queue_wait = 0.0;
+	r.start = r.end = now;
+	for (uint k = 0; k < LATENCY_CLASSES; k++)
+	{
+		r.latency[k].reset();
+		for (uint c = 0; c < LATENCY_COMPONENTS; c++)
+			r.breakdown[k][c].reset();
+	}
+
+	/* completion times of the outstanding requests in closed loop */
+	std::priority_queue<double, std::vector<double>, std::greater<double> > outstanding;
+
+	generator.set_time(now);
+	std::vector<Trace_request> batch;
+	for (ulong done = 0; done < ops; )
+	{
+		generator.next_batch(batch, (uint) std::min<ulong>(ops - done, 4096));
+		for (uint i = 0; i < batch.size(); i++)
+		{
+			const Trace_request &request = batch[i];
+			double issue = request.time;
+			if (phase.qd > 0)
+			{
+				issue = now;
+				if (outstanding.size() >= phase.qd)
+				{
+					issue = outstanding.top();
+					outstanding.pop();
+				}
+			}
+
+			double latency = ssd.event_arrive(request.type, request.logical_address, 1, issue);
+			if (series != NULL)
+				series->add(request.type, 1, issue, latency);
+			if (phase.qd > 0)
+				outstanding.push(issue + latency);
+			if (request.type == WRITE)
+			{
+				r.writes++;
+				r.write_latency += latency;
+				record(ssd, r, LATENCY_WRITE, latency);
+				if (ssd.get_last_reclaimed())
+					record(ssd, r, LATENCY_GC_WRITE, latency);
+			}
+			else if (request.type == TRIM)
+			{
+				r.trims++;
+				record(ssd, r, LATENCY_TRIM, latency);
+			}
+			else
+			{
+				r.reads++;
+				r.read_latency += latency;
+				record(ssd, r, LATENCY_READ, latency);
+			}
+			r.max_response = std::max(r.max_response, latency);
+			r.queue_wait += ssd.get_last_queue_wait();
+			r.end = std::max(r.end, issue + latency);
+		}
+		done += batch.size();
+	}
+
+	r.wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	return phase.qd > 0 ? r.end : generator.get_time();
+}
+
+static double throughput(const Phase_result &r)
+{
+	double span = r.end - r.start;
+	return span > 0.0 ? (r.reads + r.writes) * (double) PAGE_SIZE / (1024.0 * 1024.0) / (span / 1e6) : 0.0;
+}
+
+static void print_phase(const Phase &phase, const Phase_result &r)
+{
+	ulong requests = r.reads + r.writes;
+	printf("\n==== Phase %s ====\n", phase.name.c_str());
+	if (r.writes)
+		printf("Avg write latency: %.2f us\n", r.write_latency / r.writes);
+	if (r.reads)
+		printf("Avg read latency : %.2f us\n", r.read_latency / r.reads);
+	if (requests)
+		printf("Avg response time: %.2f us (queue wait %.2f us, max %.2f us)\n",
+				(r.read_latency + r.write_latency) / requests, r.queue_wait / requests, r.max_response);
+	printf("Requests: R=%lu W=%lu T=%lu\n", r.reads, r.writes, r.trims);
+	printf("Throughput  : %.2f MB/s over %.6f s simulated (%.3f s run time)\n", throughput(r), (r.end - r.start) / 1e6, r.wall_time);
+	Latency_histogram::print_header(stdout);
+	for (uint k = 0; k < LATENCY_CLASSES; k++)
+		if (r.latency[k].size() > 0)
+			r.latency[k].print(stdout, latency_names[k]);
+	printf("Latency breakdown (us):\n");
+	for (uint k = 0; k < LATENCY_CLASSES; k++)
+		for (uint c = 0; c < LATENCY_COMPONENTS; c++)
+			if (r.breakdown[k][c].max() > 0.0)
+			{
+				std::string name = std::string(latency_names[k]) + "." + component_names[c];
+				r.breakdown[k][c].print(stdout, name.c_str());
+			}
+	for (uint i = 0; counters[i].name != NULL; i++)
+		if (r.stats.*counters[i].member != 0)
+			printf("%-20s %ld\n", counters[i].name, r.stats.*counters[i].member);
+}
+
+static std::string json_string(const std::string &value)
+{
+	std::string quoted = "\"";
+	for (uint i = 0; i < value.size(); i++)
+	{
+		if (value[i] == '"' || value[i] == '\\')
+			quoted += '\\';
+		quoted += value[i];
+	}
+	return quoted + "\"";
+}
+
+static void write_histogram(FILE *stream, const char *name, const Latency_histogram &h, bool first)
+{
+	fprintf(stream, "%s\"%s\":{\"count\":%lu,\"mean\":%.6g,\"p50\":%.6g,\"p90\":%.6g,\"p99\":%.6g,\"p99.9\":%.6g,\"max\":%.6g}",
+			first ? "" : ",", name, h.size(), h.mean(), h.percentile(50.0), h.percentile(90.0),
+			h.percentile(99.0), h.percentile(99.9), h.max());
+}
+
+static void write_record(FILE *stream, const Scenario &scenario, const std::vector<Phase> &phases, const std::vector<Phase_result> &results, const std::vector<Ftl_memory> &memory)
+{
+	fprintf(stream, "{\"scenario\":%s,\"ftl\":%d,\"dataset_pages\":%lu,\"seed\":%llu,\"config\":{",
+			json_string(scenario.name).c_str(), FTL_IMPLEMENTATION, scenario.dataset_pages, (unsigned long long) scenario.seed);
+	for (uint i = 0; i < scenario.config.size(); i++)
+		fprintf(stream, "%s%s:%.17g", i ? "," : "", json_string(scenario.config[i].name).c_str(), scenario.config[i].value);
+	fprintf(stream, "},\"phases\":[");
+	for (uint i = 0; i < results.size(); i++)
+	{
+		const Phase_result &r = results[i];
+		ulong requests = r.reads + r.writes;
+		fprintf(stream, "%s{\"name\":%s,\"reads\":%lu,\"writes\":%lu,\"trims\":%lu,\"qd\":%u", i ? "," : "",
+				json_string(phases[i].name).c_str(), r.reads, r.writes, r.trims, phases[i].qd);
+		fprintf(stream, ",\"read_latency_us\":%.6g,\"write_latency_us\":%.6g,\"response_us\":%.6g,\"queue_wait_us\":%.6g,\"max_response_us\":%.6g",
+				r.reads ? r.read_latency / r.reads : 0.0, r.writes ? r.write_latency / r.writes : 0.0,
+				requests ? (r.read_latency + r.write_latency) / requests : 0.0, requests ? r.queue_wait / requests : 0.0, r.max_response);
+		fprintf(stream, ",\"throughput_mb_s\":%.6g,\"simulated_s\":%.6g,\"run_time_s\":%.6g,\"counters\":{",
+				throughput(r), (r.end - r.start) / 1e6, r.wall_time);
+		for (uint j = 0; counters[j].name != NULL; j++)
+			fprintf(stream, "%s\"%s\":%ld", j ? "," : "", counters[j].name, r.stats.*counters[j].member);
+		fprintf(stream, "},\"latency\":{");
+		for (uint k = 0; k < LATENCY_CLASSES; k++)
+			write_histogram(stream, latency_names[k], r.latency[k], k == 0);
+		fprintf(stream, "},\"breakdown\":{");
+		for (uint k = 0; k < LATENCY_CLASSES; k++)
+		{
+			fprintf(stream, "%s\"%s\":{", k ? "," : "", latency_names[k]);
+			for (uint c = 0; c < LATENCY_COMPONENTS; c++)
+				write_histogram(stream, component_names[c], r.breakdown[k][c], c == 0);
+			fprintf(stream, "}");
+		}
+		fprintf(stream, "}}");
+	}
+	fprintf(stream, "],\"memory\":{");
+	for (uint i = 0; i < memory.size(); i++)
+		fprintf(stream, "%s%s:{\"sram\":%lu,\"peak_sram\":%lu,\"host\":%lu}", i ? "," : "",
+				json_string(memory[i].name).c_str(), memory[i].sram, memory[i].peak_sram, memory[i].host);
+	fprintf(stream, "}}\n");
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <scenario> [NAME=value ...]\n", argv[0]);
+		return 1;
+	}
+
+	Scenario scenario;
+	scenario.name = argv[1];
+	scenario.config_name = "ssd.conf";
+	scenario.dataset_mb = 150;
+	scenario.dataset_pages = 0;
+	scenario.seed = 1;
+	scenario.gap = 1.0;
+	scenario.precondition_fraction = 1.0;
+	scenario.timeseries_interval = 0.0;
+	scenario.timeseries_requests = 0;
+	scenario.trace_begin = 0.0;
+	scenario.trace_end = -1.0;
+	parse_scenario(argv[1], scenario);
+	for (int i = 2; i < argc; i++)
+		if (!apply_override(scenario, argv[i]))
+		{
+			fprintf(stderr, "Cannot apply override %s\n", argv[i]);
+			return 1;
+		}
+	if (scenario.phases.empty())
+	{
+		fprintf(stderr, "Scenario %s has no phases\n", argv[1]);
+		return 1;
+	}
+
+	load_config(scenario.config_name.c_str());
+	for (uint i = 0; i < scenario.config.size(); i++)
+	{
+		std::vector<char> name(scenario.config[i].name.begin(), scenario.config[i].name.end());
+		name.push_back('\0');
+		load_entry(&name[0], scenario.config[i].value, 0);
+	}
+	derive_config();
+	print_config(NULL);
+	printf("\n");
+
+	ulong drive_pages = (ulong) NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE;
+	if (scenario.dataset_pages == 0)
+		scenario.dataset_pages = (ulong) (scenario.dataset_mb * 1024.0 * 1024.0 / PAGE_SIZE);
+	if (scenario.dataset_pages == 0 || scenario.dataset_pages > drive_pages)
+	{
+		fprintf(stderr, "The working set must hold 1 to %lu pages\n", drive_pages);
+		return 1;
+	}
+	printf("Scenario %s: working set %lu pages, seed %llu\n", scenario.name.c_str(), scenario.dataset_pages, (unsigned long long) scenario.seed);
+
+	Ssd ssd;
+	if (!scenario.precondition.empty())
+	{
+		enum precondition_pattern pattern;
+		if (scenario.precondition == "sequential")
+			pattern = PRECONDITION_SEQUENTIAL;
+		else if (scenario.precondition == "random")
+			pattern = PRECONDITION_RANDOM;
+		else
+		{
+			fprintf(stderr, "Unknown precondition %s\n", scenario.precondition.c_str());
+			return 1;
+		}
+		double fill = scenario.precondition_fraction * scenario.dataset_pages / drive_pages;
+		printf("Precondition (%s, %.0f%% of the working set)\n", scenario.precondition.c_str(), scenario.precondition_fraction * 100.0);
+		if (ssd.precondition(pattern, fill, scenario.seed) != SUCCESS)
+			return 1;
+	}
+
+	Time_series *series = NULL;
+	if (!scenario.timeseries_name.empty())
+	{
+		series = new Time_series(ssd, scenario.timeseries_interval, scenario.timeseries_requests);
+		if (series->open(scenario.timeseries_name.c_str()) != SUCCESS)
+			return FILE_ERR;
+	}
+
+	if (!scenario.trace_name.empty() && Timeline::start(scenario.trace_name.c_str(), scenario.trace_begin, scenario.trace_end) != SUCCESS)
+		return FILE_ERR;
+
+	Generator *generator = NULL;
+	std::vector<Generator *> generators;
+	std::vector<Phase> measured;
+	std::vector<Phase_result> results;
+	double now = 0.0;
+	for (uint i = 0; i < scenario.phases.size(); i++)
+	{
+		Phase &phase = scenario.phases[i];
+		if (!phase.generator.empty())
+		{
+			if ((generator = make_generator(scenario, phase, i)) == NULL)
+				return 1;
+			generators.push_back(generator);
+		}
+		else if (generator == NULL)
+		{
+			fprintf(stderr, "Phase %s needs a GENERATOR\n", phase.name.c_str());
+			return 1;
+		}
+		else if (phase.has_write_ratio)
+			generator->set_write_ratio(phase.write_ratio);
+		if (!phase.generator.empty() || phase.has_trim_ratio)
+			generator->set_trim_ratio(phase.trim_ratio);
+
+		ulong ops = phase.ops > 0 ? phase.ops : (ulong) (phase.ops_mul * scenario.dataset_pages);
+		printf("Phase %s: %lu requests%s\n", phase.name.c_str(), ops, phase.measure ? "" : " (not measured)");
+		Stats before = ssd.get_controller().stats;
+		Phase_result r;
+		now = run_phase(ssd, *generator, phase, ops, now, r, series);
+		if (!phase.measure)
+			continue;
+
+		r.stats = ssd.get_controller().stats;
+		for (uint j = 0; counters[j].name != NULL; j++)
+			r.stats.*counters[j].member -= before.*counters[j].member;
+		print_phase(phase, r);
+		measured.push_back(phase);
+		results.push_back(r);
+	}
+	if (series != NULL)
+	{
+		series->finish();
+		printf("\nTime series: %lu windows written to %s\n", series->size(), scenario.timeseries_name.c_str());
+		delete series;
+	}
+	if (!scenario.trace_name.empty())
+	{
+		Timeline::stop();
+		printf("\nTimeline: %lu spans written to %s", Timeline::get_num_spans(), scenario.trace_name.c_str());
+		if (Timeline::get_num_dropped() > 0)
+			printf(" (%lu dropped)", Timeline::get_num_dropped());
+		printf("\n");
+	}
+	printf("\n");
+	ssd.print_statistics();
+	ssd.print_memory();
+	std::vector<Ftl_memory> memory;
+	ssd.get_memory(memory);
+
+	if (scenario.output_name.empty())
+		write_record(stdout, scenario, measured, results, memory);
+	else
+	{
+		FILE *output = fopen(scenario.output_name.c_str(), "a");
+		if (output == NULL)
+		{
+			fprintf(stderr, "Cannot open %s.  Exiting.\n", scenario.output_name.c_str());
+			return FILE_ERR;
+		}
+		write_record(output, scenario, measured, results, memory);
+		fclose(output);
+		printf("Results appended to %s\n", scenario.output_name.c_str());
+	}
+
+	for (uint i = 0; i < generators.size(); i++)
+		delete generators[i];
+	return 0;
+}
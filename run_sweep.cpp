@@ -0,0 +1,429 @@
+/* sweep.cpp - Parameter sweep runner
+ * Usage:
+ *   ./sweep <sweep_spec> [threads]
+ *
+ * The sweep spec uses the ssd.conf syntax, except that a line may list
+ * several values.  Every combination of the listed values is one sweep
+ * point, simulated on its own Ssd, and the points are run on a
+ * work-stealing thread pool.  Recognized keys:
+ *
+ *   CONFIG <file>              base configuration (default ssd.conf)
+ *   OUTPUT <file>              result table (default sweep.csv)
+ *   THREADS <n>                worker threads, 0 = all cores (default 0)
+ *   WORKLOAD postmark|tiobench workload run at each point (default postmark)
+ *   DATASET_MB                 working set size (default 150)
+ *   WRITE_RATIO                fraction of writes (default 0.5)
+ *   OPS_MULTIPLIER             measured ops = working set pages * this (default 20)
+ *   WARMUP_MULTIPLIER          warm-up ops = working set pages * this (default 2)
+ *   TIO_THREADS                interleaved streams for tiobench (default 4)
+ *   SEED                       PRNG seed (default 1)
+ *   any ssd.conf variable      e.g. FTL_IMPLEMENTATION 3 5
+ *
+ * Example:
+ *   WORKLOAD postmark
+ *   FTL_IMPLEMENTATION 3 5
+ *   CACHE_DFTL_LIMIT 128 512
+ *   DATASET_MB 150 200 450
+ *   WRITE_RATIO 0.8786 0.9914
+ *
+ * The result table has one ';' separated row per point.  Points already
+ * present in OUTPUT are skipped, so an interrupted sweep resumes where it
+ * stopped.  Each point draws the same requests as ./postmark or ./tiotech
+ * with the same seed, so its latencies match theirs and do not depend on
+ * the number of threads.  The statistics columns cover the measured phase.
+ */
+
+#include "ssd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <set>
+#include <chrono>
+
+using namespace ssd;
+
+static inline double max2(double a, double b){ return (a > b) ? a : b; }
+
+struct Parameter
+{
+	std::string name;
+	std::vector<std::string> values;
+	bool config;
+};
+
+struct Sweep
+{
+	std::string config_name;
+	std::string output_name;
+	std::string workload;
+	uint threads;
+	std::vector<Parameter> parameters;
+};
+
+struct Point
+{
+	uint id;
+	std::vector<uint> choice;
+	std::string key;
+};
+
+/* Workload parameters of one point */
+struct Workload
+{
+	double dataset_mb;
+	double write_ratio;
+	double ops_mul;
+	double warmup_mul;
+	double tio_threads;
+	double seed;
+};
+
+static const char *workload_keys[] = {"DATASET_MB", "WRITE_RATIO", "OPS_MULTIPLIER", "WARMUP_MULTIPLIER", "TIO_THREADS", "SEED", NULL};
+
+static bool is_workload_key(const char *name)
+{
+	for (uint i = 0; workload_keys[i] != NULL; i++)
+		if (!strcmp(name, workload_keys[i]))
+			return true;
+	return false;
+}
+
+static void parse_spec(const char *spec_name, Sweep &sweep)
+{
+	FILE *spec = fopen(spec_name, "r");
+	if (spec == NULL)
+	{
+		fprintf(stderr, "Sweep spec %s not found.  Exiting.\n", spec_name);
+		exit(FILE_ERR);
+	}
+
+	char line[1024];
+	for (uint line_number = 1; fgets(line, sizeof(line), spec) != NULL; line_number++)
+	{
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		char *name = strtok(line, " \t\r\n");
+		if (name == NULL)
+			continue;
+		std::vector<std::string> values;
+		for (char *value = strtok(NULL, " \t\r\n"); value != NULL; value = strtok(NULL, " \t\r\n"))
+			values.push_back(value);
+		if (values.empty())
+		{
+			fprintf(stderr, "Sweep spec parsing error on line %u\n", line_number);
+			continue;
+		}
+
+		if (!strcmp(name, "CONFIG"))
+			sweep.config_name = values[0];
+		else if (!strcmp(name, "OUTPUT"))
+			sweep.output_name = values[0];
+		else if (!strcmp(name, "WORKLOAD"))
+			sweep.workload = values[0];
+		else if (!strcmp(name, "THREADS"))
+			sweep.threads = atoi(values[0].c_str());
+		else
+		{
+			Parameter parameter;
+			parameter.name = name;
+			parameter.values = values;
+			parameter.config = !is_workload_key(name);
+			sweep.parameters.push_back(parameter);
+		}
+	}
+	fclose(spec);
+
+	if (sweep.workload != "postmark" && sweep.workload != "tiobench")
+	{
+		fprintf(stderr, "Unknown workload %s.  Exiting.\n", sweep.workload.c_str());
+		exit(FILE_ERR);
+	}
+}
+
+/* Enumerates the cross product, last parameter varying fastest */
+static std::vector<Point> make_points(const Sweep &sweep)
+{
+	std::vector<Point> points;
+	std::vector<uint> choice(sweep.parameters.size(), 0);
+	for (uint id = 0; ; id++)
+	{
+		Point point;
+		point.id = id;
+		point.choice = choice;
+		point.key = std::to_string(id);
+		for (uint i = 0; i < choice.size(); i++)
+			point.key += ";" + sweep.parameters[i].values[choice[i]];
+		points.push_back(point);
+
+		int i = (int) choice.size() - 1;
+		for (; i >= 0; i--)
+		{
+			if (++choice[i] < sweep.parameters[i].values.size())
+				break;
+			choice[i] = 0;
+		}
+		if (i < 0)
+			return points;
+	}
+}
+
+/* Runs the workload of one point and returns its result row */
+static std::string run_point(const Sweep &sweep, const Config &base, const Point &point)
+{
+	std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+	SimContext context(base);
+	SimContext::Scope scope(context);
+
+	Workload w = {150, 0.5, 20, 2, 4, 1};
+	for (uint i = 0; i < sweep.parameters.size(); i++)
+	{
+		const Parameter &parameter = sweep.parameters[i];
+		const char *value = parameter.values[point.choice[i]].c_str();
+		if (parameter.config)
+		{
+			std::vector<char> name(parameter.name.begin(), parameter.name.end());
+			name.push_back('\0');
+			load_entry(&name[0], atof(value), 0);
+		}
+		else if (parameter.name == "DATASET_MB")
+			w.dataset_mb = atof(value);
+		else if (parameter.name == "WRITE_RATIO")
+			w.write_ratio = atof(value);
+		else if (parameter.name == "OPS_MULTIPLIER")
+			w.ops_mul = atof(value);
+		else if (parameter.name == "WARMUP_MULTIPLIER")
+			w.warmup_mul = atof(value);
+		else if (parameter.name == "TIO_THREADS")
+			w.tio_threads = atof(value);
+		else if (parameter.name == "SEED")
+			w.seed = atof(value);
+	}
+	derive_config();
+
+	Ssd ssd;
+
+	/* The request streams of ./postmark and ./tiotech for the same seed:
+	 * postmark draws from a Uniform_generator over the working set, tiobench
+	 * interleaves its streams over half-overlapping regions */
+	const ulong working_set_pages = (ulong)(w.dataset_mb * 1024.0 * 1024.0) / PAGE_SIZE;
+	const bool tiobench = sweep.workload == "tiobench";
+	const ulong streams = tiobench && w.tio_threads >= 1 ? (ulong) w.tio_threads : 1;
+	const uint64_t seed = (uint64_t) w.seed;
+
+	ulong region_pages = working_set_pages / streams;
+	if (region_pages < 1)
+		region_pages = 1;
+	double stride = (double)region_pages * 0.5;
+	if (stride < 1.0)
+		stride = 1.0;
+
+	Uniform_generator generator(working_set_pages, w.write_ratio, seed);
+	Random random(seed);
+	std::vector<Trace_request> batch;
+	ulong stream = 0;
+	auto next_request = [&](enum event_type &type, ulong &lpn) {
+		if (!tiobench)
+		{
+			generator.next_batch(batch, 1);
+			type = batch[0].type;
+			lpn = batch[0].logical_address;
+			return;
+		}
+		ulong start = (ulong)((double)stream * stride);
+		if (start >= working_set_pages)
+			start %= working_set_pages;
+		stream = (stream + 1) % streams;
+		lpn = (start + random.below(region_pages)) % working_set_pages;
+		type = random.uniform() < w.write_ratio ? WRITE : READ;
+	};
+
+	// ./tiotech runs its operation counts per stream
+	const ulong scale = tiobench ? region_pages * streams : working_set_pages;
+	const ulong warmup_ops = scale * (ulong) w.warmup_mul;
+	const ulong measured_ops = scale * (ulong) w.ops_mul;
+	const double ARRIVAL_GAP_US = 1.0;
+	double now = 0.0;
+	double end_time = 0.0;
+
+	for (ulong lpn = 0; lpn < working_set_pages; lpn++)
+	{
+		end_time = max2(end_time, now + ssd.event_arrive(WRITE, lpn, 1, now));
+		now += ARRIVAL_GAP_US;
+	}
+
+	for (ulong i = 0; i < warmup_ops; i++)
+	{
+		enum event_type type;
+		ulong lpn;
+		next_request(type, lpn);
+		end_time = max2(end_time, now + ssd.event_arrive(type, lpn, 1, now));
+		now += ARRIVAL_GAP_US;
+	}
+
+	ssd.reset_statistics();
+	uint64_t writes = 0, reads = 0;
+	double sum_write_lat = 0.0, sum_read_lat = 0.0;
+	for (ulong i = 0; i < measured_ops; i++)
+	{
+		enum event_type type;
+		ulong lpn;
+		next_request(type, lpn);
+		double lat = ssd.event_arrive(type, lpn, 1, now);
+		if (type == WRITE)
+		{
+			sum_write_lat += lat;
+			writes++;
+		}
+		else
+		{
+			sum_read_lat += lat;
+			reads++;
+		}
+		end_time = max2(end_time, now + lat);
+		now += ARRIVAL_GAP_US;
+	}
+
+	const double total_bytes = (double)(writes + reads) * (double)PAGE_SIZE;
+	const double throughput_MBps = (end_time > 0.0) ? (total_bytes / (1024.0 * 1024.0)) / (end_time / 1e6) : 0.0;
+	const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	char *row = NULL;
+	size_t row_size = 0;
+	FILE *stream_row = open_memstream(&row, &row_size);
+	fprintf(stream_row, "%s;%s;%llu;%llu;%.4f;%.4f;%.4f;%.2f;%.4f;%li;%.3f;",
+			point.key.c_str(), sweep.workload.c_str(),
+			(unsigned long long)reads, (unsigned long long)writes,
+			reads ? sum_read_lat / reads : 0.0,
+			writes ? sum_write_lat / writes : 0.0,
+			(reads + writes) ? (sum_read_lat + sum_write_lat) / (reads + writes) : 0.0,
+			end_time, throughput_MBps,
+			ssd.get_controller().stats.valid_page_copies, wall);
+	ssd.write_statistics(stream_row);
+	fclose(stream_row);
+
+	std::string result(row);
+	free(row);
+	return result;
+}
+
+/* Reads the keys (point number and parameter values) of the points already
+ * in the result table.  Returns false if the table does not exist yet. */
+static bool load_done(const std::string &output_name, const std::string &header, std::set<std::string> &done, uint key_fields)
+{
+	FILE *output = fopen(output_name.c_str(), "r");
+	if (output == NULL)
+		return false;
+
+	char *line = NULL;
+	size_t line_size = 0;
+	bool first = true;
+	while (getline(&line, &line_size, output) != -1)
+	{
+		std::string row(line);
+		if (first)
+		{
+			if (row.compare(0, header.size(), header) != 0)
+			{
+				fprintf(stderr, "%s was written by a different sweep.  Exiting.\n", output_name.c_str());
+				exit(FILE_ERR);
+			}
+			first = false;
+			continue;
+		}
+
+		/* only complete rows count, a killed run may leave a partial one */
+		if (row.empty() || row[row.size() - 1] != '\n')
+			continue;
+		size_t end = 0;
+		for (uint i = 0; i < key_fields && end != std::string::npos; i++)
+			end = row.find(';', i == 0 ? 0 : end + 1);
+		if (end != std::string::npos)
+			done.insert(row.substr(0, end));
+	}
+	free(line);
+	fclose(output);
+	return !first;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s <sweep_spec> [threads]\n", argv[0]);
+		return 1;
+	}
+
+	Sweep sweep;
+	sweep.config_name = "ssd.conf";
+	sweep.output_name = "sweep.csv";
+	sweep.workload = "postmark";
+	sweep.threads = 0;
+	parse_spec(argv[1], sweep);
+	if (argc >= 3)
+		sweep.threads = atoi(argv[2]);
+
+	load_config(sweep.config_name.c_str());
+	const Config base = SimContext::current()->config;
+
+	std::vector<Point> points = make_points(sweep);
+
+	std::string header = "point";
+	for (uint i = 0; i < sweep.parameters.size(); i++)
+		header += ";" + sweep.parameters[i].name;
+	header += ";workload;reads;writes;avg_read;avg_write;avg_response;sim_time;throughput_MBps;valid_page_copies;wall_s;";
+
+	std::set<std::string> done;
+	bool has_header = load_done(sweep.output_name, header, done, sweep.parameters.size() + 1);
+
+	FILE *output = fopen(sweep.output_name.c_str(), "a");
+	if (output == NULL)
+	{
+		fprintf(stderr, "Unable to open %s.  Exiting.\n", sweep.output_name.c_str());
+		exit(FILE_ERR);
+	}
+	if (!has_header)
+	{
+		fprintf(output, "%s", header.c_str());
+		Stats().write_header(output);
+		fflush(output);
+	}
+
+	std::vector<const Point *> todo;
+	for (uint i = 0; i < points.size(); i++)
+		if (done.count(points[i].key) == 0)
+			todo.push_back(&points[i]);
+
+	Thread_pool pool(sweep.threads);
+	fprintf(stderr, "Sweep: %lu points, %lu already done, %u threads\n",
+			(ulong) points.size(), (ulong) (points.size() - todo.size()), pool.size());
+
+	std::mutex output_lock;
+	uint finished = 0;
+	std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+	for (uint i = 0; i < todo.size(); i++)
+	{
+		const Point *point = todo[i];
+		pool.submit([&, point]{
+			std::string row = run_point(sweep, base, *point);
+
+			std::lock_guard<std::mutex> guard(output_lock);
+			fputs(row.c_str(), output);
+			fflush(output);
+			finished++;
+			double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+			fprintf(stderr, "[%u/%lu] point %u done, elapsed %.1f s, remaining ~%.1f s\n",
+					finished, (ulong) todo.size(), point->id, elapsed,
+					elapsed / finished * (todo.size() - finished));
+		});
+	}
+	pool.wait();
+	fclose(output);
+
+	fprintf(stderr, "Sweep finished, %lu steals\n", pool.get_num_steals());
+	return 0;
+}
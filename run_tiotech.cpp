@@ -1,17 +1,28 @@
 /* tiotech.cpp - Tiobench-equivalent interleaved workload (steady-state)
  * Usage:
- *   ./tiotech <num_threads> [dataset_MB] [write_ratio] [ops_multiplier] [warmup_multiplier] [seed]
+ *   ./tiotech <num_threads> [dataset_MB] [write_ratio] [ops_multiplier] [warmup_multiplier] [seed] [replications] [ci_target] [workers] [snapshot]
  *
  * Defaults:
  *   dataset_MB        = 200
  *   write_ratio       = 0.5
  *   ops_multiplier    = 20
  *   warmup_multiplier = 2
+ *   replications      = 1
+ *
+ * With replications > 1, seeds seed .. seed+replications-1 run in parallel
+ * on `workers` threads (0 = all cores) and every metric is reported as mean
+ * and 95% confidence interval, stopping early once each interval is within
+ * ci_target (relative) of its mean.
+ *
+ * With a snapshot prefix, the drive after prefill and warm-up is saved to
+ * <snapshot>.<seed> and restored by later runs with the same parameters.
  *
  * Example:
  *   ./tiotech 4
  *   ./tiotech 6
  *   ./tiotech 6 200 0.5 20 2 1
+ *   ./tiotech 6 200 0.5 20 2 1 30 0.01
+ *   ./tiotech 6 200 0.5 20 2 1 1 0 0 /tmp/tio200
  */
 
 #include "ssd.h"
@@ -22,33 +33,80 @@
 using namespace ssd;
 
 static inline double max2(double a, double b){ return (a > b) ? a : b; }
-static inline double urand01() { return (double)rand() / (double)RAND_MAX; }
 
-int main(int argc, char **argv)
-{
-    if (argc < 2) {
-        printf("Usage: %s <num_threads> [dataset_MB] [write_ratio] [ops_multiplier] [warmup_multiplier] [seed]\n", argv[0]);
-        return 1;
-    }
+struct Tiotech_result {
+    uint64_t reads, writes;
+    double sum_read_lat, sum_write_lat;
+    double end_time;
+    Stats stats;
+};
 
-    int threads = atoi(argv[1]);
-    int dataset_mb = (argc >= 3) ? atoi(argv[2]) : 200;
-    double write_ratio = (argc >= 4) ? atof(argv[3]) : 0.5;
-    int ops_mul = (argc >= 5) ? atoi(argv[4]) : 20;
-    int warmup_mul = (argc >= 6) ? atoi(argv[5]) : 2;
-    int seed = (argc >= 7) ? atoi(argv[6]) : 1;
+static const char *metric_names[] = {
+    "avg_read_latency", "avg_write_latency", "avg_response_time", "throughput_MBps",
+    "valid_page_copies", "gc_reads", "gc_writes", "gc_erases", "ftl_erases", NULL
+};
 
-    if (threads < 1) threads = 1;
-    if (write_ratio < 0.0) write_ratio = 0.0;
-    if (write_ratio > 1.0) write_ratio = 1.0;
-    if (ops_mul < 1) ops_mul = 1;
-    if (warmup_mul < 0) warmup_mul = 0;
+/* Restores the drive, generator and clock after prefill and warm-up */
+static bool load_warm_state(const char *name, Ssd &ssd, int threads, int dataset_mb, double write_ratio,
+                            int warmup_mul, uint64_t seed, Random &random, double &now, double &end_time)
+{
+    Snapshot snapshot;
+    if (snapshot.open(name) != SUCCESS)
+        return false;
 
-    load_config();
-    print_config(NULL);
-    printf("\n");
+    int s_threads = 0, s_dataset_mb = 0, s_warmup_mul = 0;
+    double s_write_ratio = 0.0;
+    uint64_t s_seed = 0;
+    snapshot.get(s_threads);
+    snapshot.get(s_dataset_mb);
+    snapshot.get(s_write_ratio);
+    snapshot.get(s_warmup_mul);
+    snapshot.get(s_seed);
+    if (!snapshot.good() || s_threads != threads || s_dataset_mb != dataset_mb ||
+        s_write_ratio != write_ratio || s_warmup_mul != warmup_mul || s_seed != seed) {
+        fprintf(stderr, "%s was taken with other workload parameters, rebuilding it\n", name);
+        return false;
+    }
+    // a load that fails part way leaves the drive unusable
+    if (ssd.load(snapshot) != SUCCESS && snapshot.good()) {
+        fprintf(stderr, "%s was taken with another configuration, rebuilding it\n", name);
+        return false;
+    }
+    snapshot.get(random);
+    snapshot.get(now);
+    snapshot.get(end_time);
+    if (snapshot.close() != SUCCESS) {
+        fprintf(stderr, "%s is damaged, remove it and run again\n", name);
+        exit(1);
+    }
+    return true;
+}
+
+static void save_warm_state(const char *name, Ssd &ssd, int threads, int dataset_mb, double write_ratio,
+                            int warmup_mul, uint64_t seed, Random &random, double now, double end_time)
+{
+    Snapshot snapshot;
+    if (snapshot.create(name) != SUCCESS)
+        return;
+    snapshot.put(threads);
+    snapshot.put(dataset_mb);
+    snapshot.put(write_ratio);
+    snapshot.put(warmup_mul);
+    snapshot.put(seed);
+    ssd.save(snapshot);
+    snapshot.put(random);
+    snapshot.put(now);
+    snapshot.put(end_time);
+    if (snapshot.close() != SUCCESS) {
+        fprintf(stderr, "could not write %s\n", name);
+        remove(name);
+    }
+}
 
-    srand(seed);
+static void tiotech(int threads, int dataset_mb, double write_ratio, int ops_mul, int warmup_mul,
+                    uint64_t seed, const char *snapshot, bool verbose, Tiotech_result &result)
+{
+    Random random(seed);
     Ssd ssd;
 
     const uint64_t dataset_pages = (uint64_t)dataset_mb * 1024ULL * 1024ULL / (uint64_t)PAGE_SIZE;
@@ -66,22 +124,16 @@ int main(int argc, char **argv)
     double now = 0.0;
     double end_time = 0.0;
 
-    printf("Tiobench-equivalent Interleaved workload\n");
-    printf("threads=%d, dataset=%dMB (%llu pages), write_ratio=%.2f\n",
-           threads, dataset_mb, (unsigned long long)dataset_pages, write_ratio);
-    printf("region_pages/thread=%llu, overlap_ratio=%.2f\n",
-           (unsigned long long)region_pages, OVERLAP_RATIO);
-    printf("warmup_rounds=%llu, measured_rounds=%llu, seed=%d\n",
-           (unsigned long long)warmup_rounds,
-           (unsigned long long)measured_rounds,
-           seed);
-
-    // 0) Prefill entire dataset once to make random reads valid
-    printf("Prefill (sequential write once)...\n");
-    for (uint64_t lpn = 0; lpn < dataset_pages; lpn++) {
-        double lat = ssd.event_arrive(WRITE, (ulong)lpn, 1, now);
-        end_time = max2(end_time, now + lat);
-        now += ARRIVAL_GAP_US;
+    if (verbose) {
+        printf("Tiobench-equivalent Interleaved workload\n");
+        printf("threads=%d, dataset=%dMB (%llu pages), write_ratio=%.2f\n",
+               threads, dataset_mb, (unsigned long long)dataset_pages, write_ratio);
+        printf("region_pages/thread=%llu, overlap_ratio=%.2f\n",
+               (unsigned long long)region_pages, OVERLAP_RATIO);
+        printf("warmup_rounds=%llu, measured_rounds=%llu, seed=%llu\n",
+               (unsigned long long)warmup_rounds,
+               (unsigned long long)measured_rounds,
+               (unsigned long long)seed);
     }
 
     auto pick_lpn_for_thread = [&](int th) -> uint64_t {
@@ -92,37 +144,57 @@ int main(int argc, char **argv)
         uint64_t start = (uint64_t)((double)th * stride);
         if (start >= dataset_pages) start = start % dataset_pages;
 
-        uint64_t local = (uint64_t)(rand() % (int)region_pages);
+        uint64_t local = random.below(region_pages);
         uint64_t lpn = start + local;
         if (lpn >= dataset_pages) lpn = lpn % dataset_pages;
         return lpn;
     };
 
-    // 1) Warm-up (not measured)
-    printf("Warm-up (not measured)...\n");
-    for (uint64_t r = 0; r < warmup_rounds; r++) {
-        for (int th = 0; th < threads; th++) {
-            uint64_t lpn = pick_lpn_for_thread(th);
-            if (urand01() < write_ratio) {
-                double lat = ssd.event_arrive(WRITE, (ulong)lpn, 1, now);
-                end_time = max2(end_time, now + lat);
-            } else {
-                double lat = ssd.event_arrive(READ, (ulong)lpn, 1, now);
-                end_time = max2(end_time, now + lat);
-            }
+    char snapshot_name[4096] = "";
+    if (snapshot != NULL)
+        snprintf(snapshot_name, sizeof(snapshot_name), "%s.%llu", snapshot, (unsigned long long)seed);
+
+    if (snapshot != NULL &&
+        load_warm_state(snapshot_name, ssd, threads, dataset_mb, write_ratio, warmup_mul, seed, random, now, end_time)) {
+        if (verbose) printf("Prefill and warm-up restored from %s\n", snapshot_name);
+    } else {
+        // 0) Prefill entire dataset once to make random reads valid
+        if (verbose) printf("Prefill (sequential write once)...\n");
+        for (uint64_t lpn = 0; lpn < dataset_pages; lpn++) {
+            double lat = ssd.event_arrive(WRITE, (ulong)lpn, 1, now);
+            end_time = max2(end_time, now + lat);
             now += ARRIVAL_GAP_US;
         }
+
+        // 1) Warm-up (not measured)
+        if (verbose) printf("Warm-up (not measured)...\n");
+        for (uint64_t r = 0; r < warmup_rounds; r++) {
+            for (int th = 0; th < threads; th++) {
+                uint64_t lpn = pick_lpn_for_thread(th);
+                if (random.uniform() < write_ratio) {
+                    double lat = ssd.event_arrive(WRITE, (ulong)lpn, 1, now);
+                    end_time = max2(end_time, now + lat);
+                } else {
+                    double lat = ssd.event_arrive(READ, (ulong)lpn, 1, now);
+                    end_time = max2(end_time, now + lat);
+                }
+                now += ARRIVAL_GAP_US;
+            }
+        }
+
+        if (snapshot != NULL)
+            save_warm_state(snapshot_name, ssd, threads, dataset_mb, write_ratio, warmup_mul, seed, random, now, end_time);
     }
 
     // 2) Measured
     uint64_t writes = 0, reads = 0;
     double sum_write_lat = 0.0, sum_read_lat = 0.0;
 
-    printf("Measured phase...\n");
+    if (verbose) printf("Measured phase...\n");
     for (uint64_t r = 0; r < measured_rounds; r++) {
         for (int th = 0; th < threads; th++) {
             uint64_t lpn = pick_lpn_for_thread(th);
-            if (urand01() < write_ratio) {
+            if (random.uniform() < write_ratio) {
                 double lat = ssd.event_arrive(WRITE, (ulong)lpn, 1, now);
                 sum_write_lat += lat;
                 writes++;
@@ -137,21 +209,100 @@ int main(int argc, char **argv)
         }
     }
 
-    double avg_resp =  (sum_read_lat + sum_write_lat) /  (reads + writes);
-    const double sim_time_us = end_time;
-    const double total_bytes = (double)(writes + reads) * (double)PAGE_SIZE;
-    const double throughput_MBps = (sim_time_us > 0.0)
-        ? (total_bytes / (1024.0 * 1024.0)) / (sim_time_us / 1e6)
-        : 0.0;
+    result.reads = reads;
+    result.writes = writes;
+    result.sum_read_lat = sum_read_lat;
+    result.sum_write_lat = sum_write_lat;
+    result.end_time = end_time;
+    result.stats = ssd.get_controller().stats;
+
+    if (verbose) {
+        double avg_resp =  (sum_read_lat + sum_write_lat) /  (reads + writes);
+        const double sim_time_us = end_time;
+        const double total_bytes = (double)(writes + reads) * (double)PAGE_SIZE;
+        const double throughput_MBps = (sim_time_us > 0.0)
+            ? (total_bytes / (1024.0 * 1024.0)) / (sim_time_us / 1e6)
+            : 0.0;
+
+        printf("\n==== Tiobench Results (Measured Phase) ====\n");
+        if (writes) printf("Avg write latency: %.2f us\n", sum_write_lat / (double)writes);
+        if (reads)  printf("Avg read latency : %.2f us\n", sum_read_lat  / (double)reads );
+        printf("Avg response time: %.2f us\n", avg_resp);
+        printf("Measured ops: R=%llu W=%llu\n", (unsigned long long)reads, (unsigned long long)writes);
+        printf("Sim end time: %.2f us (%.6f s)\n", sim_time_us, sim_time_us / 1e6);
+        printf("Throughput  : %.2f MB/s\n", throughput_MBps);
+
+        ssd.print_statistics();
+    }
+}
+
+static std::vector<double> metrics(const Tiotech_result &r)
+{
+    std::vector<double> m;
+    m.push_back(r.reads ? r.sum_read_lat / (double)r.reads : 0.0);
+    m.push_back(r.writes ? r.sum_write_lat / (double)r.writes : 0.0);
+    m.push_back((r.reads + r.writes) ? (r.sum_read_lat + r.sum_write_lat) / (double)(r.reads + r.writes) : 0.0);
+    m.push_back(r.end_time > 0.0
+        ? ((double)(r.reads + r.writes) * (double)PAGE_SIZE / (1024.0 * 1024.0)) / (r.end_time / 1e6)
+        : 0.0);
+    m.push_back(r.stats.valid_page_copies);
+    m.push_back(r.stats.numGCRead);
+    m.push_back(r.stats.numGCWrite);
+    m.push_back(r.stats.numGCErase);
+    m.push_back(r.stats.numFTLErase);
+    return m;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("Usage: %s <num_threads> [dataset_MB] [write_ratio] [ops_multiplier] [warmup_multiplier] [seed] [replications] [ci_target] [workers] [snapshot]\n", argv[0]);
+        return 1;
+    }
+
+    int threads = atoi(argv[1]);
+    int dataset_mb = (argc >= 3) ? atoi(argv[2]) : 200;
+    double write_ratio = (argc >= 4) ? atof(argv[3]) : 0.5;
+    int ops_mul = (argc >= 5) ? atoi(argv[4]) : 20;
+    int warmup_mul = (argc >= 6) ? atoi(argv[5]) : 2;
+    int seed = (argc >= 7) ? atoi(argv[6]) : 1;
+    int replications = (argc >= 8) ? atoi(argv[7]) : 1;
+    double ci_target = (argc >= 9) ? atof(argv[8]) : 0.0;
+    int workers = (argc >= 10) ? atoi(argv[9]) : 0;
+    const char *snapshot = (argc >= 11) ? argv[10] : NULL;
+
+    if (threads < 1) threads = 1;
+    if (write_ratio < 0.0) write_ratio = 0.0;
+    if (write_ratio > 1.0) write_ratio = 1.0;
+    if (ops_mul < 1) ops_mul = 1;
+    if (warmup_mul < 0) warmup_mul = 0;
+    if (replications < 1) replications = 1;
+    if (workers < 0) workers = 0;
+
+    load_config();
+    print_config(NULL);
+    printf("\n");
+
+    if (replications == 1) {
+        Tiotech_result result;
+        tiotech(threads, dataset_mb, write_ratio, ops_mul, warmup_mul, seed, snapshot, true, result);
+        return 0;
+    }
+
+    std::vector<std::string> names;
+    for (int i = 0; metric_names[i] != NULL; i++)
+        names.push_back(metric_names[i]);
+
+    printf("Tiobench replications: threads=%d dataset=%d MB write_ratio=%.2f seeds %d..%d ci_target=%.4f\n",
+           threads, dataset_mb, write_ratio, seed, seed + replications - 1, ci_target);
+    Replication replication(names);
+    replication.run([&](uint run) {
+        Tiotech_result result;
+        tiotech(threads, dataset_mb, write_ratio, ops_mul, warmup_mul, seed + run, snapshot, false, result);
+        return metrics(result);
+    }, replications, 3, ci_target, workers);
 
     printf("\n==== Tiobench Results (Measured Phase) ====\n");
-    if (writes) printf("Avg write latency: %.2f us\n", sum_write_lat / (double)writes);
-    if (reads)  printf("Avg read latency : %.2f us\n", sum_read_lat  / (double)reads );
-    printf("Avg response time: %.2f us\n", avg_resp);
-    printf("Measured ops: R=%llu W=%llu\n", (unsigned long long)reads, (unsigned long long)writes);
-    printf("Sim end time: %.2f us (%.6f s)\n", sim_time_us, sim_time_us / 1e6);
-    printf("Throughput  : %.2f MB/s\n", throughput_MBps);
-
-    ssd.print_statistics();
+    replication.print();
     return 0;
 }
@@ -0,0 +1,56 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* run_tracecvt.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Trace converter
+ *
+ * Converts uFLIP text traces, as replayed by run_ufliptrace.cpp, into the
+ * binary trace format read by Trace_reader.  A directory of converted
+ * traces replays like the text traces it came from.
+ *
+ * Usage: ./tracecvt <text trace> <binary trace> */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+static long file_size(const char *filename)
+{
+	struct stat info;
+	return stat(filename, &info) == 0 ? (long) info.st_size : -1;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 3)
+	{
+		fprintf(stderr, "Usage: %s <text trace> <binary trace>\n", argv[0]);
+		return 1;
+	}
+
+	Trace_writer writer;
+	if (writer.create(argv[2]) != SUCCESS || writer.append_uflip(argv[1]) != SUCCESS || writer.close() != SUCCESS)
+		return 1;
+
+	printf("Wrote %lu requests to %s: %ld bytes from %ld bytes of text\n",
+			writer.size(), argv[2], file_size(argv[2]), file_size(argv[1]));
+	return 0;
+}
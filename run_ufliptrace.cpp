@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <dirent.h>
 #include <sys/types.h>
+#include <unistd.h>
 #include <string.h>
 #include <iostream>
 #include <vector>
@@ -27,16 +28,97 @@
 
 using namespace ssd;
 
-int main(int argc, char **argv){
+//static const int deviceSize = 2827059;
+static const int deviceSize = 2097024;
+
+
+/* I/O counts and times of one replay pass over a trace */
+struct Replay_totals
+{
+	unsigned long num_reads;
+	double read_time;
+	unsigned long num_writes;
+	double write_time;
+};
+
+/* Opens a binary trace as is; a text trace is converted once into an
+ * unlinked temporary file, so both passes replay it from the mapping */
+static enum status open_trace(const std::string &filename, Trace_reader &trace)
+{
+	if (Trace_reader::is_trace(filename.c_str()))
+		return trace.open(filename.c_str());
+
+	char temporary[] = "/tmp/ufliptraceXXXXXX";
+	int fd = mkstemp(temporary);
+	if (fd < 0)
+		return FAILURE;
+	close(fd);
+
+	Trace_writer writer;
+	enum status result = writer.create(temporary);
+	if (result == SUCCESS)
+		result = writer.append_uflip(filename.c_str());
+	if (writer.close() != SUCCESS)
+		result = FAILURE;
+	if (result == SUCCESS)
+		result = trace.open(temporary);
+	unlink(temporary);
+	return result;
+}
+
+/* Replays a trace starting at start_time and returns the arrival time of
+ * the last request plus its I/O time, as the next trace starts after it */
+static double replay(Sampler &sampler, Trace_reader &trace, double start_time, float multiplier, Replay_totals &totals)
+{
+	const int addressDivisor = 1;
+	const double timeMultiplier = 10000;
+	double arrive_time = 0;
+
+	trace.rewind();
+	const Trace_record *record;
+	while ((record = trace.next()) != NULL)
+	{
+		arrive_time = trace.get_time();
+		enum event_type type = (enum event_type) record->type;
+		long vaddr = record->logical_address;
+
+		double local_loop_time = 0;
+		for (int i=0;i<(int)record->size;i++)
+			local_loop_time += sampler.event_arrive(type, ((vaddr+(i*(int)multiplier))/addressDivisor)%deviceSize, 1, ((start_time+arrive_time)*timeMultiplier)+local_loop_time);
+
+		if (type == READ)
+		{
+			totals.num_reads += record->size;
+			totals.read_time += local_loop_time;
+		}
+		else
+		{
+			totals.num_writes += record->size;
+			totals.write_time += local_loop_time;
+		}
+		arrive_time += local_loop_time;
+	}
+	return arrive_time;
+}
+
+/* Address multiplier encoded in uFLIP pattern 5 file names */
+static float address_multiplier(const std::string &fileName)
+{
+	float multiplier = 1;
+	std::string multiplerStr = fileName.substr(fileName.find('P',0)+1, fileName.find_last_of('_', std::string::npos)-fileName.find('P',0)-1);
+
+	char pattern = fileName.substr(4,1).c_str()[0];
+	switch (pattern)
+	{
+	case '5':
+		multiplier = atof(multiplerStr.c_str());
+		break;
 
-	long vaddr;
-	ssd::uint queryTime;
-	char ioPatternType; // (S)equential or (R)andom
-	char ioType; // (R)ead or (W)rite
-	double arrive_time;
-	int ioSize;
+	}
+	return multiplier;
+}
 
-	char line[80];
+int main(int argc, char **argv){
 
 	double afterFormatStartTime = 0;
 
@@ -45,6 +127,13 @@ int main(int argc, char **argv){
 
 	Ssd ssd;
 
+	/* ./ufliptrace <trace directory> [period warmup window]: sample the
+	 * replay (see Sampler); without them every request is timed */
+	bool sampling = argc >= 5;
+	Sampler sampler(ssd, sampling ? atol(argv[2]) : 1, sampling ? atol(argv[3]) : 0, sampling ? atol(argv[4]) : 1);
+	if (sampling)
+		printf("Sampling: period %s, warm-up %s, window %s requests\n", argv[2], argv[3], argv[4]);
+
 	printf("INITIALIZING SSD\n");
 
 	int preIO = SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * BLOCK_SIZE;
@@ -61,28 +150,13 @@ int main(int argc, char **argv){
 	if (FTL_IMPLEMENTATION > 2) // DFTL BIFTL
 		preIO -= 1000;
 
-	//int deviceSize = 2827059;
-	int deviceSize = 2097024;
-
 	if (preIO > deviceSize)
 		preIO = deviceSize;
 
 	printf("Writes %i pages for startup out of %i total pages.\n", preIO, SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * BLOCK_SIZE);
 
-//	srand(1);
-//	for (int i=0; i<preIO*3;i++)
-//	{
-//		long int r = random()%deviceSize;
-//		double d = ssd.event_arrive(WRITE, r, 1, (double)i*1000.0);
-//		//double d = ssd.event_arrive(WRITE, i, 1, i*1000);
-//		afterFormatStartTime += 1000;
-//
-//		if (i % 1000 == 0)
-//			printf("Wrote %i %f\n", i,d );
-//	}
-
 	DIR *working_directory = NULL;
-	if ((working_directory = opendir(argv[1])) == NULL)
+	if (argc < 2 || (working_directory = opendir(argv[1])) == NULL)
 	{
 		printf("Please provide trace file directory.\n");
 		exit(-1);
@@ -98,81 +172,40 @@ int main(int argc, char **argv){
 
 	std::sort(files.begin(), files.end());
 
-	double start_time = afterFormatStartTime;
-	double timeMultiplier = 10000;
-
-
-	long writeEvent = 0;
-	long readEvent = 0;
+	/* text traces are parsed here, once for both passes */
+	std::vector<Trace_reader *> traces;
 	for (unsigned int i=0; i<files.size();i++)
 	{
-		char *filename = NULL;
-		asprintf(&filename, "%s%s", argv[1], files[i].c_str());
-
-		FILE *trace = NULL;
-		if((trace = fopen(filename, "r")) == NULL){
+		traces.push_back(new Trace_reader());
+		if (open_trace(std::string(argv[1]) + files[i], *traces[i]) != SUCCESS)
+		{
 			printf("File was moved or access was denied.\n");
 			exit(-1);
 		}
+	}
 
-		printf("-__- %s -__-\n", files[i].c_str());
-
-		start_time = start_time + arrive_time;
-
+	double start_time = afterFormatStartTime;
+	double arrive_time = 0;
 
-		int addressDivisor = 1;
-		float multiplier = 1;
+	Replay_totals prepared = {0, 0, 0, 0};
 
-		std::string fileName = files[i].c_str();
-		std::string multiplerStr = fileName.substr(fileName.find('P',0)+1, fileName.find_last_of('_', std::string::npos)-fileName.find('P',0)-1);
+	/* the preparation pass only needs the FTL state */
+	sampler.fast_forward(sampling);
 
-		char pattern = fileName.substr(4,1).c_str()[0];
-		switch (pattern)
-		{
-		case '5':
-			multiplier = atof(multiplerStr.c_str());
-			break;
+	for (unsigned int i=0; i<files.size();i++)
+	{
+		printf("-__- %s -__-\n", files[i].c_str());
 
-		}
+		start_time = start_time + arrive_time;
 
 		/* first go through and write to all read addresses to prepare the SSD */
-		while(fgets(line, 80, trace) != NULL){
-			sscanf(line, "%c; %c; %li; %u; %i; %lf", &ioPatternType, &ioType, &vaddr, &queryTime, &ioSize, &arrive_time);
-
-			//printf("%li %c %c %li %u %lf %lf %li\n", ++cnt, ioPatternType, ioType, vaddr, queryTime, arrive_time, start_time+arrive_time);
-
-			double local_loop_time = 0;
-
-			if (ioType == 'R')
-			{
-				for (int i=0;i<ioSize;i++)
-				{
-					local_loop_time += ssd.event_arrive(READ, ((vaddr+(i*(int)multiplier))/addressDivisor)%deviceSize, 1, ((start_time+arrive_time)*timeMultiplier)+local_loop_time);
-					readEvent++;
-				}
-
-
-			}
-			else if(ioType == 'W')
-			{
-				for (int i=0;i<ioSize;i++)
-				{
-					local_loop_time += ssd.event_arrive(WRITE, ((vaddr+(i*(int)multiplier))/addressDivisor)%deviceSize, 1, ((start_time+arrive_time)*timeMultiplier)+local_loop_time);
-					writeEvent++;
-				}
-
-
-			}
-
-			arrive_time += local_loop_time;
-		}
-
-		fclose(trace);
+		arrive_time = replay(sampler, *traces[i], start_time, address_multiplier(files[i]), prepared);
 	}
 
+	sampler.finish();
 	printf("Pre write done------------------------------\n");
 	ssd.print_ftl_statistics();
-	printf("Num read %li write %li\n", readEvent, writeEvent);
+	printf("Num read %li write %li\n", prepared.num_reads, prepared.num_writes);
 	getchar();
 
 
@@ -184,25 +217,12 @@ int main(int argc, char **argv){
 	}
 
 	fprintf(logFile, "File;NumIOReads;ReadIOTime;NumIOWrites;WriteIOTime;NumIOTotal;IOTime;");
+	if (sampling)
+		fprintf(logFile, "ReadIOTimeCI;WriteIOTimeCI;IOTimeCI;");
 	ssd.write_header(logFile);
 
-	double read_time = 0;
-	double write_time = 0;
-
-	unsigned long num_reads = 0;
-	unsigned long num_writes = 0;
-
 	for (unsigned int i=0; i<files.size();i++)
 	{
-		char *filename = NULL;
-		asprintf(&filename, "%s%s", argv[1], files[i].c_str());
-
-		FILE *trace = NULL;
-		if((trace = fopen(filename, "r")) == NULL){
-			printf("File was moved or access was denied.\n");
-			exit(-1);
-		}
-
 		fprintf(logFile, "%s;", files[i].c_str());
 
 		printf("-__- %s -__-\n", files[i].c_str());
@@ -211,76 +231,30 @@ int main(int argc, char **argv){
 
 		// Reset statistics
 		ssd.reset_statistics();
+		sampler.reset();
 
-		num_reads = 0;
-		read_time = 0;
-
-		num_writes = 0;
-		write_time = 0;
-
-		int addressDivisor = 1;
-		float multiplier = 1;
-
-		std::string fileName = files[i].c_str();
-		std::string multiplerStr = fileName.substr(fileName.find('P',0)+1, fileName.find_last_of('_', std::string::npos)-fileName.find('P',0)-1);
+		Replay_totals totals = {0, 0, 0, 0};
+		arrive_time = replay(sampler, *traces[i], start_time, address_multiplier(files[i]), totals);
 
-		char pattern = fileName.substr(4,1).c_str()[0];
-		switch (pattern)
+		// Write all statistics
+		sampler.finish();
+		if (sampling)
 		{
-		case '5':
-			multiplier = atof(multiplerStr.c_str());
-			break;
-
+			sampler.print();
+			fprintf(logFile, "%lu;%f;%lu;%f;%lu;%f;", totals.num_reads, sampler.estimate_total(READ), totals.num_writes, sampler.estimate_total(WRITE), totals.num_reads+totals.num_writes, sampler.estimate_total());
+			fprintf(logFile, "%f;%f;%f;", sampler.estimate_total_ci(READ), sampler.estimate_total_ci(WRITE), sampler.estimate_total_ci());
 		}
-
-		/* first go through and write to all read addresses to prepare the SSD */
-		while(fgets(line, 80, trace) != NULL){
-			sscanf(line, "%c; %c; %li; %u; %i; %lf", &ioPatternType, &ioType, &vaddr, &queryTime, &ioSize, &arrive_time);
-
-			//printf("%li %c %c %li %u %lf %lf %li\n", ++cnt, ioPatternType, ioType, vaddr, queryTime, arrive_time, start_time+arrive_time);
-
-			double local_loop_time = 0;
-
-			if (ioType == 'R')
-			{
-				for (int i=0;i<ioSize;i++)
-				{
-					local_loop_time += ssd.event_arrive(READ, ((vaddr+(i*(int)multiplier))/addressDivisor)%deviceSize, 1, ((start_time+arrive_time)*timeMultiplier)+local_loop_time);
-					num_reads++;
-				}
-
-				read_time += local_loop_time;
-			}
-			else if(ioType == 'W')
-			{
-				for (int i=0;i<ioSize;i++)
-				{
-					local_loop_time += ssd.event_arrive(WRITE, ((vaddr+(i*(int)multiplier))/addressDivisor)%deviceSize, 1, ((start_time+arrive_time)*timeMultiplier)+local_loop_time);
-
-					num_writes++;
-				}
-				write_time += local_loop_time;
-
-			}
-
-			arrive_time += local_loop_time;
-		}
-
-		// Write all statistics
-		fprintf(logFile, "%lu;%f;%lu;%f;%lu;%f;", num_reads, read_time, num_writes, write_time, num_reads+num_writes, read_time+write_time);
+		else
+			fprintf(logFile, "%lu;%f;%lu;%f;%lu;%f;", totals.num_reads, totals.read_time, totals.num_writes, totals.write_time, totals.num_reads+totals.num_writes, totals.read_time+totals.write_time);
 		ssd.write_statistics(logFile);
-
-		fclose(trace);
-
-
 	}
 
 	fclose(logFile);
 
+	for (unsigned int i=0; i<traces.size();i++)
+		delete traces[i];
 	closedir(working_directory);
 
 	printf("Finished.\n");
 	return 0;
 }
-
-
@@ -30,11 +30,22 @@
 #include <vector>
 #include <queue>
 #include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <stdint.h>
+#include <type_traits>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/global_fun.hpp>
+#include <boost/multi_index/mem_fun.hpp>
+#include <boost/multi_index/composite_key.hpp>
 #include <boost/multi_index/random_access_index.hpp>
  
 #ifndef _SSD_H
@@ -57,118 +68,233 @@ typedef unsigned long ulong;
 
 /* Simulator configuration from ssd_config.cpp */
 
-/* Configuration file parsing for extern config variables defined below */
+/* Configuration file parsing into the configuration of the active context */
 void load_entry(char *name, double value, uint line_number);
 void load_config(void);
+void load_config(const char *config_name);
+void derive_config(void);
 void print_config(FILE *stream);
 
-/* Ram class:
- * 	delay to read from and write to the RAM for 1 page of data */
-extern const double RAM_READ_DELAY;
-extern const double RAM_WRITE_DELAY;
-
-/* Bus class:
- * 	delay to communicate over bus
- * 	max number of connected devices allowed
- * 	flag value to detect free table entry (keep this negative)
- * 	number of time entries bus has to keep track of future schedule usage
- * 	number of simultaneous communication channels - defined by SSD_SIZE */
-extern const double BUS_CTRL_DELAY;
-extern const double BUS_DATA_DELAY;
-extern const uint BUS_MAX_CONNECT;
-extern const double BUS_CHANNEL_FREE_FLAG;
-extern const uint BUS_TABLE_SIZE;
-/* extern const uint BUS_CHANNELS = 4; same as # of Packages, defined by SSD_SIZE */
-
-/* Ssd class:
- * 	number of Packages per Ssd (size) */
-extern const uint SSD_SIZE;
-
-/* Package class:
- * 	number of Dies per Package (size) */
-extern const uint PACKAGE_SIZE;
-
-/* Die class:
- * 	number of Planes per Die (size) */
-extern const uint DIE_SIZE;
-
-/* Plane class:
- * 	number of Blocks per Plane (size)
- * 	delay for reading from plane register
- * 	delay for writing to plane register
- * 	delay for merging is based on read, write, reg_read, reg_write 
- * 		and does not need to be explicitly defined */
-extern const uint PLANE_SIZE;
-extern const double PLANE_REG_READ_DELAY;
-extern const double PLANE_REG_WRITE_DELAY;
-
-/* Block class:
- * 	number of Pages per Block (size)
- * 	number of erases in lifetime of block
- * 	delay for erasing block */
-extern const uint BLOCK_SIZE;
-extern const uint BLOCK_ERASES;
-extern const double BLOCK_ERASE_DELAY;
-
-/* Page class:
- * 	delay for Page reads
- * 	delay for Page writes */
-extern const double PAGE_READ_DELAY;
-extern const double PAGE_WRITE_DELAY;
-extern const uint PAGE_SIZE;
-extern const bool PAGE_ENABLE_DATA;
-
-/*
- * Mapping directory
- */
-extern const uint MAP_DIRECTORY_SIZE;
-
-/*
- * FTL Implementation
- */
-extern const uint FTL_IMPLEMENTATION;
-
-/*
- * LOG page limit for BAST.
- */
-extern const uint BAST_LOG_BLOCK_LIMIT;
-
-/*
- * LOG page limit for FAST.
- */
-extern const uint FAST_LOG_BLOCK_LIMIT;
-
-/*
- * Number of blocks allowed to be in DFTL Cached Mapping Table.
- */
-extern const uint CACHE_DFTL_LIMIT;
+/* Configuration values of one simulator instance.  Defaults are assigned in
+ * the constructor in ssd_config.cpp and overwritten by load_config(). */
+struct Config
+{
+	Config(void);
+
+	/* Ram class:
+	 * 	delay to read from and write to the RAM for 1 page of data */
+	double ram_read_delay;
+	double ram_write_delay;
+
+	/* Bus class:
+	 * 	delay to communicate over bus
+	 * 	max number of connected devices allowed
+	 * 	flag value to detect free table entry (keep this negative)
+	 * 	number of time entries bus has to keep track of future schedule usage
+	 * 	number of simultaneous communication channels - defined by SSD_SIZE */
+	double bus_ctrl_delay;
+	double bus_data_delay;
+	uint bus_max_connect;
+	double bus_channel_free_flag;
+	uint bus_table_size;
+	/* uint bus_channels = 4; same as # of Packages, defined by SSD_SIZE */
+
+	/* Ssd class:
+	 * 	number of Packages per Ssd (size) */
+	uint ssd_size;
+
+	/* Package class:
+	 * 	number of Dies per Package (size) */
+	uint package_size;
+
+	/* Die class:
+	 * 	number of Planes per Die (size)
+	 * 	whether a die runs one operation at a time, so that later operations
+	 * 	queue behind it (queueing) */
+	uint die_size;
+	bool die_queueing;
+
+	/* Plane class:
+	 * 	number of Blocks per Plane (size)
+	 * 	delay for reading from plane register
+	 * 	delay for writing to plane register
+	 * 	delay for merging is based on read, write, reg_read, reg_write 
+	 * 		and does not need to be explicitly defined */
+	uint plane_size;
+	double plane_reg_read_delay;
+	double plane_reg_write_delay;
+
+	/* Block class:
+	 * 	number of Pages per Block (size)
+	 * 	number of erases in lifetime of block
+	 * 	delay for erasing block */
+	uint block_size;
+	uint block_erases;
+	double block_erase_delay;
+
+	/* Page class:
+	 * 	delay for Page reads
+	 * 	delay for Page writes */
+	double page_read_delay;
+	double page_write_delay;
+	uint page_size;
+	bool page_enable_data;
+
+	/*
+	 * Mapping directory
+	 */
+	uint map_directory_size;
+
+	/*
+	 * FTL Implementation
+	 */
+	uint ftl_implementation;
+
+	/*
+	 * LOG page limit for BAST.
+	 */
+	uint bast_log_block_limit;
+
+	/*
+	 * LOG page limit for FAST.
+	 */
+	uint fast_log_block_limit;
+
+	/*
+	 * Number of blocks allowed to be in DFTL Cached Mapping Table.
+	 */
+	uint cache_dftl_limit;
+
+	/*
+	 * Static wear leveling: erase count difference between the most and least
+	 * worn block that triggers a migration (0 disables), and the minimum number
+	 * of erases between two migrations.
+	 */
+	uint wear_level_threshold;
+	uint wear_level_interval;
+
+	uint mnftl_oob_size;
+	uint mnftl_entry_size;
+	double oob_read_delay;
+	double oob_write_delay;
+
+	/*
+	 * Parallelism mode
+	 */
+	uint parallelism_mode;
+
+	/* Virtual block size (as a multiple of the physical block size) */
+	uint virtual_block_size;
+
+	/* Virtual page size (as a multiple of the physical page size) */
+	uint virtual_page_size;
+
+	uint number_of_addressable_blocks;
+
+	/* RAISSDs: Number of physical SSDs */
+	uint raid_number_of_physical_ssds;
+
+	/* RAISSDs: Worker threads driving the member SSDs
+	 * (0 -> one per member up to the number of cores, 1 -> calling thread) */
+	uint raid_threads;
+
+	/* Counting mode: the controller only updates page and block states and
+	 * statistics, without bus, RAM or channel timing.  Latencies returned
+	 * in this mode are meaningless. */
+	bool counting_mode;
+};
 
-extern const uint MNFTL_OOB_SIZE;
-extern const uint MNFTL_ENTRY_SIZE;
-extern const double OOB_READ_DELAY;
-extern const double OOB_WRITE_DELAY;
+class Block_manager;
 
-/*
- * Parallelism mode
- */
-extern const uint PARALLELISM_MODE;
+/* Simulator context
+ * Owns everything that used to be process-wide state: the configuration,
+ * the Block_manager and the memory area that backs page data.  Each Ssd owns
+ * a context and activates it for the calling thread (SimContext::Scope) on
+ * every entry point, so that several Ssds with different configurations can
+ * live in one process and run on different threads.  Code outside an Ssd
+ * sees the process context, which load_config() fills. */
+class SimContext
+{
+public:
+	SimContext(void);
+	SimContext(const Config &config);
+	~SimContext(void);
+	static inline SimContext *current(void) { return active; }
+
+	/* Activates a context for the calling thread until destroyed */
+	class Scope
+	{
+	public:
+		Scope(SimContext &context);
+		~Scope(void);
+		void release(void);
+	private:
+		SimContext *previous;
+		bool released;
+	};
 
-/* Virtual block size (as a multiple of the physical block size) */
-extern const uint VIRTUAL_BLOCK_SIZE;
+	Config config;
+	Block_manager *block_manager;
 
-/* Virtual page size (as a multiple of the physical page size) */
-extern const uint VIRTUAL_PAGE_SIZE;
+	/* Memory area to support pages with data, and the last page read. */
+	void *page_data;
+	void *global_buffer;
 
-extern const uint NUMBER_OF_ADDRESSABLE_BLOCKS;
+	/* Timeline process of this drive and the host request being served */
+	uint timeline_drive;
+	ulong timeline_request;
+	double timeline_request_start;
 
-/* RAISSDs: Number of physical SSDs */
-extern const uint RAID_NUMBER_OF_PHYSICAL_SSDS;
+	/* Set while Controller::program writes a page without timing */
+	bool preconditioning;
+private:
+	SimContext(const SimContext &);
+	SimContext &operator=(const SimContext &);
+	static SimContext process_context;
+	static thread_local SimContext *active;
+};
 
-/*
- * Memory area to support pages with data.
- */
-extern void *page_data;
-extern void *global_buffer;
+/* Configuration variables are read through the active context, so that they
+ * can still be used in the same way as macros. */
+#define RAM_READ_DELAY (::ssd::SimContext::current()->config.ram_read_delay)
+#define RAM_WRITE_DELAY (::ssd::SimContext::current()->config.ram_write_delay)
+#define BUS_CTRL_DELAY (::ssd::SimContext::current()->config.bus_ctrl_delay)
+#define BUS_DATA_DELAY (::ssd::SimContext::current()->config.bus_data_delay)
+#define BUS_MAX_CONNECT (::ssd::SimContext::current()->config.bus_max_connect)
+#define BUS_CHANNEL_FREE_FLAG (::ssd::SimContext::current()->config.bus_channel_free_flag)
+#define BUS_TABLE_SIZE (::ssd::SimContext::current()->config.bus_table_size)
+#define SSD_SIZE (::ssd::SimContext::current()->config.ssd_size)
+#define PACKAGE_SIZE (::ssd::SimContext::current()->config.package_size)
+#define DIE_SIZE (::ssd::SimContext::current()->config.die_size)
+#define DIE_QUEUEING (::ssd::SimContext::current()->config.die_queueing)
+#define PLANE_SIZE (::ssd::SimContext::current()->config.plane_size)
+#define PLANE_REG_READ_DELAY (::ssd::SimContext::current()->config.plane_reg_read_delay)
+#define PLANE_REG_WRITE_DELAY (::ssd::SimContext::current()->config.plane_reg_write_delay)
+#define BLOCK_SIZE (::ssd::SimContext::current()->config.block_size)
+#define BLOCK_ERASES (::ssd::SimContext::current()->config.block_erases)
+#define BLOCK_ERASE_DELAY (::ssd::SimContext::current()->config.block_erase_delay)
+#define PAGE_READ_DELAY (::ssd::SimContext::current()->config.page_read_delay)
+#define PAGE_WRITE_DELAY (::ssd::SimContext::current()->config.page_write_delay)
+#define PAGE_SIZE (::ssd::SimContext::current()->config.page_size)
+#define PAGE_ENABLE_DATA (::ssd::SimContext::current()->config.page_enable_data)
+#define MAP_DIRECTORY_SIZE (::ssd::SimContext::current()->config.map_directory_size)
+#define FTL_IMPLEMENTATION (::ssd::SimContext::current()->config.ftl_implementation)
+#define BAST_LOG_BLOCK_LIMIT (::ssd::SimContext::current()->config.bast_log_block_limit)
+#define FAST_LOG_BLOCK_LIMIT (::ssd::SimContext::current()->config.fast_log_block_limit)
+#define CACHE_DFTL_LIMIT (::ssd::SimContext::current()->config.cache_dftl_limit)
+#define WEAR_LEVEL_THRESHOLD (::ssd::SimContext::current()->config.wear_level_threshold)
+#define WEAR_LEVEL_INTERVAL (::ssd::SimContext::current()->config.wear_level_interval)
+#define MNFTL_OOB_SIZE (::ssd::SimContext::current()->config.mnftl_oob_size)
+#define MNFTL_ENTRY_SIZE (::ssd::SimContext::current()->config.mnftl_entry_size)
+#define OOB_READ_DELAY (::ssd::SimContext::current()->config.oob_read_delay)
+#define OOB_WRITE_DELAY (::ssd::SimContext::current()->config.oob_write_delay)
+#define PARALLELISM_MODE (::ssd::SimContext::current()->config.parallelism_mode)
+#define VIRTUAL_BLOCK_SIZE (::ssd::SimContext::current()->config.virtual_block_size)
+#define VIRTUAL_PAGE_SIZE (::ssd::SimContext::current()->config.virtual_page_size)
+#define NUMBER_OF_ADDRESSABLE_BLOCKS (::ssd::SimContext::current()->config.number_of_addressable_blocks)
+#define RAID_NUMBER_OF_PHYSICAL_SSDS (::ssd::SimContext::current()->config.raid_number_of_physical_ssds)
+#define RAID_THREADS (::ssd::SimContext::current()->config.raid_threads)
+#define COUNTING_MODE (::ssd::SimContext::current()->config.counting_mode)
 
 /* Enumerations to clarify status integers in simulation
  * Do not use typedefs on enums for reader clarity */
@@ -191,9 +317,27 @@ enum block_state{FREE, ACTIVE, INACTIVE};
  * 	erase - erase block at address (all pages in block are erased - 
  * 	                                page states set to empty)
  * 	merge - move valid pages from block at address (page state set to invalid)
- * 	           to free pages in block at merge_address */
+ * 	           to free pages in block at merge_address
+ * 	        if both addresses are pages, copy back the single page within the
+ * 	           plane (source page state is left to replace_address) */
 enum event_type{READ, WRITE, ERASE, MERGE, TRIM};
 
+/* Parts of the time an event takes
+ * 	flash - flash array, register, bus transfer and RAM time of the event
+ * 	           itself (whatever the other components leave)
+ * 	bus_wait - waiting for a free bus channel
+ * 	die_wait - waiting for a busy die (DIE_QUEUEING)
+ * 	mapping - mapping table lookups, misses and updates (e.g. DFTL
+ * 	           translation pages, MNFTL OOB reads)
+ * 	gc - garbage collection, merges, erases and wear leveling */
+enum latency_component{COMPONENT_FLASH, COMPONENT_BUS_WAIT, COMPONENT_DIE_WAIT, COMPONENT_MAPPING, COMPONENT_GC, LATENCY_COMPONENTS};
+
+/* Timeline tracks and span names (see Timeline)
+ * 	host requests and GC relocations have one track per drive, bus
+ * 	transfers one per channel and flash array operations one per die */
+enum timeline_track{TRACK_HOST, TRACK_GC, TRACK_CHANNEL, TRACK_DIE};
+enum timeline_op{TIMELINE_READ, TIMELINE_PROGRAM, TIMELINE_ERASE, TIMELINE_COPY_BACK, TIMELINE_BUS, TIMELINE_RELOCATE, TIMELINE_HOST_READ, TIMELINE_HOST_WRITE, TIMELINE_HOST_TRIM};
+
 /* General return status
  * return status for simulator operations that only need to provide general
  * failure notifications */
@@ -214,6 +358,37 @@ enum address_valid{NONE, PACKAGE, DIE, PLANE, BLOCK, PAGE};
  */
 enum block_type {LOG, DATA, LOG_SEQ};
 
+/*
+ * Log block merge types of the hybrid FTLs (BAST/FAST)
+ * 	switch  - log block replaces the data block without any page copies
+ * 	partial - remaining data block pages are copied into the log block
+ * 	full    - log and data block pages are copied to a new data block
+ */
+enum merge_type {MERGE_SWITCH, MERGE_PARTIAL, MERGE_FULL};
+
+/*
+ * Order in which a precondition writes the filled logical pages
+ * 	sequential - in logical address order
+ * 	random     - in a random order drawn from the given seed
+ */
+enum precondition_pattern {PRECONDITION_SEQUENTIAL, PRECONDITION_RANDOM};
+
+/* Block trace formats read by Trace_importer
+ * 	uflip    - "S; W; page; query; pages; seconds" as run_ufliptrace.cpp replays
+ * 	msr      - MSR Cambridge CSV: Windows filetime, host, disk, Read/Write,
+ * 	           byte offset, bytes, response time
+ * 	snia     - SNIA IOTTA SPC format: ASU, 512-byte LBA, bytes, r/w, seconds
+ * 	blkparse - blkparse default text output; requests issued to the driver
+ * 	           (action D) are replayed
+ */
+enum trace_format {TRACE_UFLIP, TRACE_MSR, TRACE_SNIA, TRACE_BLKPARSE};
+
+/* Fitting trace addresses to the configured drive
+ * 	wrap  - logical pages modulo the drive size
+ * 	scale - logical pages scaled by drive size / trace size
+ */
+enum trace_address_mode {TRACE_WRAP, TRACE_SCALE};
+
 /*
  * Enumeration of the different FTL implementations.
  */
@@ -255,6 +430,9 @@ class FtlImpl_MNftl;
 class Ram;
 class Controller;
 class Ssd;
+class Thread_pool;
+class Snapshot;
+class Fork_runner;
 
 
 
@@ -300,6 +478,7 @@ public:
 	long numFTLWrite;
 	long numFTLErase;
 	long numFTLTrim;
+	long numFTLCopyBack;
 
 	// Garbage Collection
 	long numGCRead;
@@ -307,6 +486,11 @@ public:
 	long numGCErase;
 	long valid_page_copies;
 
+	// Flash array: pages programmed (including copy-backs) and pages moved
+	// by FtlParent::copy_page
+	long numFlashWrite;
+	long numGCCopy;
+
 	// Wear-leveling
 	long numWLRead;
 	long numWLWrite;
@@ -324,13 +508,23 @@ public:
 	long numCacheHits;
 	long numCacheFaults;
 
-	// Memory consumptions (Bytes)
+	// Memory consumptions (Bytes), modelled controller SRAM of the FTL
+	// mapping structures, now and at most since the last reset.  The
+	// current values are state and survive reset_statistics().
 	long numMemoryTranslation;
 	long numMemoryCache;
+	long peakMemoryTranslation;
+	long peakMemoryCache;
 
 	long numMemoryRead;
 	long numMemoryWrite;
 
+	// Log merge latencies, power of two buckets in simulated time units
+	static const uint MERGE_LATENCY_BUCKETS = 32;
+	long mergeLatency[3][MERGE_LATENCY_BUCKETS];
+	double mergeLatencySum[3];
+	void add_merge(enum merge_type type, double latency);
+
 	// Advance statictics
 	double translation_overhead() const;
 	double variance_of_io() const;
@@ -345,6 +539,69 @@ public:
 	void write_header(FILE *stream);
 private:
 	void reset();
+	void print_merge_latency(const char *name, enum merge_type type);
+};
+
+/* Per-instance pseudo random number generator (xoshiro256**), so that
+ * simulations running side by side do not share the state of rand() */
+class Random
+{
+public:
+	Random(uint64_t seed = 1);
+	void seed(uint64_t seed);
+	uint64_t next(void);
+	double uniform(void);
+	uint64_t below(uint64_t n);
+private:
+	uint64_t state[4];
+};
+
+/* Mean, standard deviation and 95% confidence interval of a set of
+ * independent observations (e.g. one per replication) */
+class Sample_stats
+{
+public:
+	Sample_stats(void);
+	void add(double value);
+	ulong size(void) const;
+	double mean(void) const;
+	double stddev(void) const;
+	double ci_half_width(void) const;
+	double ci_relative(void) const;
+private:
+	ulong count;
+	double running_mean;
+	double squared_deviations;
+};
+
+/* Fixed-memory log-linear latency histogram with percentile queries.
+ * Histograms with the same precision and unit can be merged, so every
+ * thread of a run can fill its own. */
+class Latency_histogram
+{
+public:
+	Latency_histogram(uint precision_bits = 8, double unit = 0.01);
+	void add(double value);
+	enum status merge(const Latency_histogram &other);
+	void reset(void);
+	ulong size(void) const;
+	double min(void) const;
+	double max(void) const;
+	double mean(void) const;
+	double percentile(double percent) const;
+	void print(FILE *stream, const char *name) const;
+	static void print_header(FILE *stream);
+private:
+	uint index(uint64_t value) const;
+	uint64_t highest_equivalent(uint index) const;
+
+	uint precision_bits;
+	double unit;
+	std::vector<ulong> counts;
+	ulong count;
+	double sum;
+	double minimum;
+	double maximum;
 };
 
 /* Class to emulate a log block with page-level mapping. */
@@ -361,6 +618,9 @@ public:
 
 	LogPageBlock *next;
 
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
+
 	bool operator() (const ssd::LogPageBlock& lhs, const ssd::LogPageBlock& rhs) const;
 	bool operator() (const ssd::LogPageBlock*& lhs, const ssd::LogPageBlock*& rhs) const;
 };
@@ -384,7 +644,10 @@ public:
 	enum event_type get_event_type(void) const;
 	double get_start_time(void) const;
 	double get_time_taken(void) const;
+	double get_sub_event_time(void) const;
 	double get_bus_wait_time(void) const;
+	double get_die_wait_time(void) const;
+	double get_component_time(enum latency_component component) const;
 	bool get_noop(void) const;
 	Event *get_next(void) const;
 	void set_address(const Address &address);
@@ -397,12 +660,14 @@ public:
 	void set_noop(bool value);
 	void *get_payload(void) const;
 	double incr_bus_wait_time(double time);
+	double incr_die_wait_time(double time);
 	double incr_time_taken(double time_incr);
+	double incr_time_taken(double time_incr, enum latency_component component);
 	void print(FILE *stream = stdout);
 private:
 	double start_time;
 	double time_taken;
-	double bus_wait_time;
+	double component_time[LATENCY_COMPONENTS];
 	enum event_type type;
 
 	ulong logical_address;
@@ -434,16 +699,18 @@ public:
 	enum status connect(void);
 	enum status disconnect(void);
 	double ready_time(void);
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
 private:
 	void unlock(double current_time);
+	void insert(double lock_time, double unlock_time);
 
-	struct lock_times {
-		double lock_time;
-		double unlock_time;
-	};
-
-	static bool timings_sorter(lock_times const& lhs, lock_times const& rhs);
-	std::vector<lock_times> timings;
+	/* Scheduled transfers (lock time -> unlock time), which never overlap,
+	 * and the idle gaps between them (unlock time of the earlier transfer
+	 * -> length of the gap).  Back-to-back transfers leave no gap entry, so
+	 * finding a free slot does not walk a long backlog. */
+	std::map<double, double> timings;
+	std::map<double, double> gaps;
 
 	uint table_entries;
 	uint selected_entry;
@@ -474,6 +741,8 @@ public:
 	enum status disconnect(uint channel);
 	Channel &get_channel(uint channel);
 	double ready_time(uint channel);
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
 private:
 	uint num_channels;
 	Channel * const channels;
@@ -529,6 +798,8 @@ public:
 	Block *get_pointer(void);
 	block_type get_block_type(void) const;
 	void set_block_type(block_type value);
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
 
 private:
 	uint size;
@@ -569,9 +840,12 @@ public:
 	ssd::uint get_num_valid(const Address &address) const;
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
 private:
 	void update_wear_stats(void);
 	enum status get_next_page(void);
+	enum status copy_back(Event &event);
 	uint size;
 	Block * const data;
 	const Die &parent;
@@ -608,8 +882,13 @@ public:
 	ssd::uint get_num_valid(const Address &address) const;
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
 private:
 	void update_wear_stats(const Address &address);
+	void wait(Event &event);
+	void occupy(const Event &event);
+	void trace(const Event &event, enum timeline_op op, double begin) const;
 	uint size;
 	Plane * const data;
 	const Package &parent;
@@ -617,6 +896,9 @@ private:
 	uint least_worn;
 	ulong erases_remaining;
 	double last_erase_time;
+
+	/* end of the last operation (DIE_QUEUEING) */
+	double ready_time;
 };
 
 /* The package is the highest level data storage hardware unit.  While the
@@ -644,6 +926,8 @@ public:
 	ssd::uint get_num_valid(const Address &address) const;
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
 private:
 	void update_wear_stats (const Address &address);
 	uint size;
@@ -665,12 +949,49 @@ private:
 	void clean(Address &address);
 };
 
+/* Dynamic wear leveler.  Keeps the pool of erased blocks ordered by
+ * erases_remaining, so the least worn free block is handed out first. */
 class Wear_leveler 
 {
 public:
 	Wear_leveler(FtlParent &FTL);
 	~Wear_leveler(void);
-	enum status insert(const Address &address);
+	void insert(Block *block);
+	Block *get_free_block(const Address *plane = NULL, bool most_worn = false);
+	ulong size(void) const;
+	ulong get_num_allocations(void) const;
+	ulong get_num_index_operations(void) const;
+	ulong get_num_index_levels(void) const;
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot, FtlParent &ftl);
+private:
+	static ulong get_plane(const Block &block);
+	void count_index_operations(uint operations);
+
+	typedef boost::multi_index_container<
+			Block*,
+			boost::multi_index::indexed_by<
+				boost::multi_index::ordered_non_unique<boost::multi_index::const_mem_fun<Block,ulong,&Block::get_erases_remaining> >,
+				boost::multi_index::ordered_non_unique<
+					boost::multi_index::composite_key<
+						Block*,
+						boost::multi_index::global_fun<const Block&,ulong,&Wear_leveler::get_plane>,
+						boost::multi_index::const_mem_fun<Block,ulong,&Block::get_erases_remaining>
+					>
+				>
+		  >
+		> free_set;
+
+	typedef free_set::nth_index<0>::type FreeByWear;
+	typedef free_set::nth_index<1>::type FreeByPlane;
+
+	free_set free_blocks;
+
+	// Number of blocks handed out, and the index operations and tree
+	// levels spent on inserting and handing out free blocks.
+	ulong num_allocations;
+	ulong num_index_operations;
+	ulong num_index_levels;
 };
 
 class Block_manager
@@ -682,6 +1003,7 @@ public:
 	// Usual suspects
 	Address get_free_block(Event &event);
 	Address get_free_block(block_type btype, Event &event);
+	Address get_free_block(block_type btype, Event &event, const Address &plane);
 	void invalidate(Address address, block_type btype);
 	void print_statistics();
 	void insert_events(Event &event);
@@ -696,16 +1018,21 @@ public:
 	// Singleton
 	static Block_manager *instance();
 	static void instance_initialize(FtlParent *ftl);
-	static Block_manager *inst;
 
 	void cost_insert(Block *b);
 
 	void print_cost_status();
 
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
 
+	// True until the first block is handed out.
+	bool is_unused(void) const;
 
 private:
-	void get_page_block(Address &address, Event &event);
+	void get_page_block(Address &address, Event &event, const Address *plane = NULL);
+	void activate_block(const Address &address, block_type type);
+	void wear_level(Event &event);
 	static bool block_comparitor_simple (Block const *x,Block const *y);
 
 	FtlParent *ftl;
@@ -725,18 +1052,20 @@ private:
 			Block*,
 			boost::multi_index::indexed_by<
 				boost::multi_index::random_access<>,
-				boost::multi_index::ordered_non_unique<BOOST_MULTI_INDEX_MEMBER(Block,uint,pages_invalid) >
+				boost::multi_index::ordered_non_unique<BOOST_MULTI_INDEX_MEMBER(Block,uint,pages_invalid) >,
+				boost::multi_index::ordered_non_unique<boost::multi_index::const_mem_fun<Block,ulong,&Block::get_erases_remaining> >
 		  >
 		> active_set;
 
 	typedef active_set::nth_index<0>::type ActiveBySeq;
 	typedef active_set::nth_index<1>::type ActiveByCost;
+	typedef active_set::nth_index<2>::type ActiveByWear;
 
 	active_set active_cost;
 
 	// Usual block lists
 	std::vector<Block*> active_list;
-	std::vector<Block*> free_list;
+	Wear_leveler wear_leveler;
 	std::vector<Block*> invalid_list;
 
 	// Counter for returning the next free page.
@@ -754,6 +1083,25 @@ private:
 	bool inited;
 
 	bool out_of_blocks;
+
+	// Erases since static wear leveling last scanned the blocks.
+	ulong erases_since_wear_level;
+
+	// Set while static wear leveling moves cold data, which then goes to
+	// the most worn free blocks.
+	bool migrating;
+};
+
+/* Memory of one FTL mapping structure: the controller SRAM it is modelled
+ * to take (now and at most) and the simulator's heap use for it.  Cache
+ * structures count as numMemoryCache, the others as numMemoryTranslation. */
+struct Ftl_memory
+{
+	const char *name;
+	bool cache;
+	ulong sram;
+	ulong peak_sram;
+	ulong host;
 };
 
 class FtlParent
@@ -769,6 +1117,14 @@ public:
 
 	virtual void print_ftl_statistics();
 
+	/* Mapping state for snapshots, the FTL of a fresh drive has none */
+	virtual void save(Snapshot &snapshot) const;
+	virtual void load(Snapshot &snapshot);
+
+	/* Builds the mapping and page states a fresh drive has after the first
+	 * fill_fraction of the logical pages is written once, without events */
+	virtual enum status precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed) = 0;
+
 	friend class Block_manager;
 
 	ulong get_erases_remaining(const Address &address) const;
@@ -778,8 +1134,28 @@ public:
 	Block *get_block_pointer(const Address & address);
 
 	Address resolve_logical_address(unsigned int logicalAddress);
+
+	void get_memory(std::vector<Ftl_memory> &usage) const;
+	void print_memory(FILE *stream) const;
 protected:
+	/* Bytes of a modelled mapping table entry (a block or page number) and
+	 * the heap overhead of a node of a std::map */
+	static const ulong MAP_ENTRY_BYTES = 4;
+	static const ulong MAP_NODE_BYTES = 32;
+
+	uint add_memory(const char *name, bool cache = false);
+	void set_memory(uint structure, ulong sram);
+	void grow_memory(uint structure, long sram);
+	virtual void get_host_memory(std::vector<Ftl_memory> &usage) const;
+
+	enum status copy_page(Event &event, const Address &source, const Address &target, bool invalidate_source);
+	bool trim_page(Event &event, const Address &address, block_type btype);
+	enum status precondition_order(enum precondition_pattern pattern, double fill_fraction, ulong seed, std::vector<ulong> &order) const;
+	void precondition_page(const Address &address);
+
 	Controller &controller;
+private:
+	std::vector<Ftl_memory> memory;
 };
 
 class FtlImpl_Page : public FtlParent
@@ -790,11 +1166,18 @@ public:
 	enum status read(Event &event);
 	enum status write(Event &event);
 	enum status trim(Event &event);
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
+	enum status precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed);
 private:
+	void get_host_memory(std::vector<Ftl_memory> &usage) const;
+
 	ulong currentPage;
 	ulong numPagesActive;
-	bool *trim_map;
+	std::vector<bool> trim_map;
 	long *map;
+
+	uint trim_map_memory;
 };
 
 class FtlImpl_Bast : public FtlParent
@@ -805,6 +1188,9 @@ public:
 	enum status read(Event &event);
 	enum status write(Event &event);
 	enum status trim(Event &event);
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
+	enum status precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed);
 private:
 	std::map<long, LogPageBlock*> log_map;
 
@@ -814,14 +1200,22 @@ private:
 	void allocate_new_logblock(LogPageBlock *logBlock, long lba, Event &event);
 
 	bool is_sequential(LogPageBlock* logBlock, long lba, Event &event);
+	bool partial_merge(LogPageBlock *logBlock, long lba, Event &event);
 	bool random_merge(LogPageBlock *logBlock, long lba, Event &event);
 
 	void update_map_block(Event &event);
 
 	void print_ftl_statistics();
+	void get_host_memory(std::vector<Ftl_memory> &usage) const;
 
 	int addressShift;
 	int addressSize;
+
+	// Picks log block victims, kept in snapshots
+	Random random;
+
+	uint data_list_memory;
+	uint log_map_memory;
 };
 
 class FtlImpl_Fast : public FtlParent
@@ -832,6 +1226,9 @@ public:
 	enum status read(Event &event);
 	enum status write(Event &event);
 	enum status trim(Event &event);
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
+	enum status precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed);
 private:
 	void initialize_log_pages();
 
@@ -843,12 +1240,15 @@ private:
 	bool write_to_log_block(Event &event, long logicalBlockAddress);
 
 	void switch_sequential(Event &event);
+	bool partial_sequential(Event &event);
 	void merge_sequential(Event &event);
 	bool random_merge(LogPageBlock *logBlock, Event &event);
 
 	void update_map_block(Event &event);
 
 	void print_ftl_statistics();
+	void get_host_memory(std::vector<Ftl_memory> &usage) const;
+	void update_log_memory(void);
 
 	long sequential_logicalblock_address;
 	Address sequential_address;
@@ -859,6 +1259,10 @@ private:
 
 	int addressShift;
 	int addressSize;
+
+	uint data_list_memory;
+	uint pin_list_memory;
+	uint log_map_memory;
 };
 
 
@@ -871,6 +1275,8 @@ public:
 	virtual enum status read(Event &event) = 0;
 	virtual enum status write(Event &event) = 0;
 	virtual enum status trim(Event &event) = 0;
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
 protected:
 	struct MPage {
 		long vpn;
@@ -914,10 +1320,14 @@ protected:
 
 	long get_free_data_page(Event &event);
 	long get_free_data_page(Event &event, bool insert_events);
+	long get_free_gc_page(Event &event, const Address &victim);
 
 	void evict_page_from_cache(Event &event);
 	void evict_specific_page_from_cache(Event &event, long lba);
 
+	void update_cmt_memory(void);
+	void get_host_memory(std::vector<Ftl_memory> &usage) const;
+
 	// Mapping information
 	int addressPerPage;
 	int addressSize;
@@ -926,6 +1336,13 @@ protected:
 	// Current storage
 	long currentDataPage;
 	long currentTranslationPage;
+
+	// Current GC destination page, one per plane
+	std::vector<long> currentGCPage;
+
+	uint gtd_memory;
+	uint cmt_memory;
+	uint translation_memory;
 };
 
 class FtlImpl_Dftl : public FtlImpl_DftlParent
@@ -937,6 +1354,7 @@ public:
 	enum status write(Event &event);
 	enum status trim(Event &event);
 	void cleanup_block(Event &event, Block *block);
+	enum status precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed);
 	void print_ftl_statistics();
 };
 
@@ -949,6 +1367,9 @@ public:
 	enum status write(Event &event);
 	enum status trim(Event &event);
 	void cleanup_block(Event &event, Block *block);
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
+	enum status precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed);
 private:
 	struct BPage {
 		uint pbn;
@@ -959,7 +1380,7 @@ private:
 	};
 
 	BPage *block_map;
-	bool *trim_map;
+	std::vector<bool> trim_map;
 
 	std::queue<Block*> blockQueue;
 
@@ -967,6 +1388,10 @@ private:
 	bool block_next_new();
 	long get_free_biftl_page(Event &event);
 	void print_ftl_statistics();
+	void get_host_memory(std::vector<Ftl_memory> &usage) const;
+
+	uint block_map_memory;
+	uint trim_map_memory;
 };
 
 class FtlImpl_MNftl : public FtlParent
@@ -979,14 +1404,17 @@ public:
     enum status write(Event &event);
     enum status trim(Event &event);
     void cleanup_block(Event &event, Block *block);
+    void save(Snapshot &snapshot) const;
+    void load(Snapshot &snapshot);
+    enum status precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed);
 
 private:
 	uint P;   // pages per block
     uint Q;   // entries per PMT
 	uint num_pmd;           // number of PMT sub-tables per LBN = ceil(P/Q)
 
-	/* Block Mapping List (BML) */
-    std::vector<uint> BML;
+	/* Block Mapping List (BML), linear address of each block */
+    std::vector<ulong> BML;
 
 
 	// PMD[LBN][PMD_INDEX] = PPN_<PMD_INDEX>
@@ -994,6 +1422,8 @@ private:
     std::map<uint, std::vector<long>> PMD;
     // PMT: LBN -> (PMD_INDEX -> vector[Q] PPNs)
     std::map<uint, std::vector< std::vector<long> >> PMT;
+    // LPN in the OOB of each physical page, -1 when never written
+    std::vector<long> page_lpn;
 
     // Current writing block
 	bool has_current_block;
@@ -1003,6 +1433,14 @@ private:
     // Helper functions
     void allocate_new_current_block(Event &event);
 	ulong alloc_page_in_current_block(Event &event, Address &outAddr);
+    void remove_from_bml(ulong block_address);
+    void update_map_memory(void);
+    void get_host_memory(std::vector<Ftl_memory> &usage) const;
+
+    // Memory accounting: BML and PMD are in SRAM, the PMTs in flash
+    uint bml_memory;
+    uint pmd_memory;
+    uint pmt_memory;
 
 	
 };
@@ -1050,8 +1488,12 @@ public:
 	Stats stats;
 	void print_ftl_statistics();
 	const FtlParent &get_ftl(void) const;
+	void save(Snapshot &snapshot) const;
+	void load(Snapshot &snapshot);
+	enum status precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed);
 private:
 	enum status issue(Event &event_list);
+	enum status program(Event &event);
 	void translate_address(Address &address);
 	ssd::ulong get_erases_remaining(const Address &address) const;
 	void get_least_worn(Address &address) const;
@@ -1086,7 +1528,17 @@ public:
 	const Controller &get_controller(void) const;
 
 	void print_ftl_statistics();
+	void print_memory(FILE *stream = stdout);
+	void get_memory(std::vector<Ftl_memory> &usage);
 	double ready_at(void);
+	enum status save(Snapshot &snapshot);
+	enum status load(Snapshot &snapshot);
+	enum status precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed = 1);
+	void set_counting_mode(bool counting);
+	double get_last_queue_wait(void) const;
+	bool get_last_reclaimed(void) const;
+	double get_last_component_time(enum latency_component component) const;
+	int get_num_free_blocks(void);
 private:
 	enum status read(Event &event);
 	enum status write(Event &event);
@@ -1107,6 +1559,10 @@ private:
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
 
+	/* declared first so that the rest of the Ssd is built inside it */
+	SimContext context;
+	SimContext::Scope construction;
+
 	uint size;
 	Controller controller;
 	Ram ram;
@@ -1115,6 +1571,22 @@ private:
 	ulong erases_remaining;
 	ulong least_worn;
 	double last_erase_time;
+
+	/* time the last request waited for bus channels and dies */
+	double last_queue_wait;
+	bool last_reclaimed;
+	double last_component_time[LATENCY_COMPONENTS];
+};
+
+/* One host request of a RaidSsd batch; time_taken is filled in on return */
+struct Raid_request
+{
+	enum event_type type;
+	ulong logical_address;
+	uint size;
+	double start_time;
+	void *buffer;
+	double time_taken;
 };
 
 class RaidSsd
@@ -1124,9 +1596,11 @@ public:
 	~RaidSsd(void);
 	double event_arrive(enum event_type type, ulong logical_address, uint size, double start_time);
 	double event_arrive(enum event_type type, ulong logical_address, uint size, double start_time, void *buffer);
+	void event_arrive(std::vector<Raid_request> &batch);
 	void *get_result_buffer();
 	friend class Controller;
 	void print_statistics();
+	void print_imbalance(FILE *stream = stdout);
 	void reset_statistics();
 	void write_statistics(FILE *stream);
 	void write_header(FILE *stream);
@@ -1134,10 +1608,526 @@ public:
 
 	void print_ftl_statistics();
 private:
+	void run_member(uint member, std::vector<Raid_request> &batch, uint buffer_stride);
+
 	uint size;
 
 	Ssd *Ssds;
+	uint last_ssd;
+
+	/* Members run on the pool, or on the calling thread when NULL */
+	Thread_pool *pool;
+
+	/* Per member: requests of the current batch and the time each took */
+	std::vector<std::vector<uint> > member_requests;
+	std::vector<std::vector<double> > member_timings;
+
+	/* Per member load, for the imbalance report */
+	std::vector<ulong> member_ops;
+	std::vector<double> member_busy;
+	std::vector<double> member_wall;
+	ulong dispatches;
+};
+
+/* Work-stealing thread pool for running independent simulator instances.
+ * Each worker owns a task deque; it takes its own tasks from the back and
+ * steals from the front of the other workers' deques when it runs dry.
+ * Tasks submitted from a worker go to that worker's own deque. */
+class Thread_pool
+{
+public:
+	Thread_pool(uint num_threads = 0);
+	~Thread_pool(void);
+	void submit(std::function<void()> task);
+	void wait(void);
+	uint size(void) const;
+	ulong get_num_steals(void) const;
+private:
+	struct Task_queue
+	{
+		std::mutex lock;
+		std::deque<std::function<void()> > tasks;
+	};
+
+	void work(uint id);
+	bool take(uint id, std::function<void()> &task);
+
+	std::vector<Task_queue *> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex lock;
+	std::condition_variable work_available;
+	std::condition_variable all_done;
+	ulong queued;
+	ulong pending;
+	std::atomic<ulong> steals;
+	uint next_queue;
+	bool stopping;
+};
+
+/* Runs replications of an experiment with consecutive seeds on a Thread_pool
+ * and keeps a Sample_stats per metric.  Replications are accounted in seed
+ * order; once at least min_runs are in and every metric's 95% confidence
+ * interval is within ci_target of its mean (0 disables), the rest is
+ * dropped, so the result does not depend on the number of threads. */
+class Replication
+{
+public:
+	Replication(const std::vector<std::string> &metrics);
+	void run(std::function<std::vector<double>(uint run)> experiment, uint max_runs, uint min_runs = 3, double ci_target = 0.0, uint num_threads = 0);
+	const Sample_stats &get_metric(uint metric) const;
+	uint size(void) const;
+	void print(FILE *stream = stdout) const;
+private:
+	bool converged(double ci_target) const;
+
+	std::vector<std::string> names;
+	std::vector<Sample_stats> samples;
+	uint runs;
+};
 
+/* Snapshot file holding the complete simulation state of an Ssd, so that a
+ * preconditioned drive can be restored instead of simulated again.  create()
+ * starts a file that the save() methods of the simulator classes write in
+ * order; open() maps an existing file and the load() methods read it back in
+ * the same order.  Callers may append their own state (e.g. the workload
+ * clock and Random) after the Ssd.  Read errors and short files are
+ * remembered and reported by good() and close(). */
+class Snapshot
+{
+public:
+	Snapshot(void);
+	~Snapshot(void);
+	enum status create(const char *filename);
+	enum status open(const char *filename);
+	enum status close(void);
+	bool good(void) const;
+	bool is_loading(void) const;
+
+	void write(const void *data, size_t size);
+	void read(void *data, size_t size);
+
+	template <class T> void put(const T &value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Snapshot::put needs a plain value");
+		write(&value, sizeof(T));
+	}
+	template <class T> void get(T &value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Snapshot::get needs a plain value");
+		read(&value, sizeof(T));
+	}
+	template <class T> void put(const std::vector<T> &values)
+	{
+		put((ulong) values.size());
+		for (typename std::vector<T>::const_iterator it = values.begin(); it != values.end(); ++it)
+			put(*it);
+	}
+	template <class T> void get(std::vector<T> &values)
+	{
+		ulong size = 0;
+		get(size);
+		values.clear();
+		for (ulong i = 0; i < size && good(); i++)
+		{
+			T value;
+			get(value);
+			values.push_back(value);
+		}
+	}
+	void put(const std::vector<bool> &values);
+	void get(std::vector<bool> &values);
+	void put(const std::map<double, double> &values);
+	void get(std::map<double, double> &values);
+	void put(const std::string &value);
+	void get(std::string &value);
+	void put(const Address &address);
+	void get(Address &address);
+
+	/* Blocks are stored by physical address */
+	void put_block(const Block *block);
+	Block *get_block(FtlParent &ftl);
+private:
+	FILE *file;
+	char *data;
+	size_t size;
+	size_t offset;
+	bool failed;
+};
+
+/* Runs experiments in forked child processes that start from a copy-on-write
+ * image of the caller, e.g. a drive warmed up once and then measured in
+ * several ways, and collects the values each child reports over a pipe.
+ * At most num_children run at once (0 -> one per core).  Only the calling
+ * thread exists in a child, so no Thread_pool may be running. */
+class Fork_runner
+{
+public:
+	Fork_runner(uint num_children = 0);
+	enum status run(uint count, std::function<std::vector<double>(uint index)> experiment, std::vector<std::vector<double> > &results);
+private:
+	uint num_children;
+};
+
+/* Time series of windowed metrics over a run: host read and write MB/s,
+ * mean latency, WAF (pages programmed per host page written), free blocks,
+ * GC page copies, erases and cache hit ratio.  A window spans interval
+ * simulated time units of request arrivals, or request_interval requests
+ * when interval is 0.  Requests either go through event_arrive() or are
+ * reported with add() after the caller issued them to the drive. */
+class Time_series
+{
+public:
+	Time_series(Ssd &ssd, double interval, ulong request_interval = 0);
+	~Time_series(void);
+	enum status open(const char *filename);
+	double event_arrive(enum event_type type, ulong logical_address, uint size, double start_time);
+	void add(enum event_type type, uint size, double start_time, double time_taken);
+	void finish(void);
+	ulong size(void) const;
+private:
+	void start_window(double start);
+	void write_row(double end);
+
+	Ssd &ssd;
+	double interval;
+	ulong request_interval;
+	FILE *file;
+	ulong rows;
+	bool started;
+	double window_start;
+	double window_end;
+	double last_completion;
+	ulong requests;
+	ulong read_pages;
+	ulong write_pages;
+	double latency;
+	Stats window_stats;
+};
+
+/* Timeline of flash operations in the Chrome trace event format, which
+ * chrome://tracing and Perfetto open.  Every drive is a process with tracks
+ * for its host requests, GC relocations, bus channels and dies; flash
+ * operations link back to the host request that caused them.  Spans that
+ * start in [begin, end) simulated time units are kept (end < 0: no end).
+ * Threads fill their own fixed-size buffers, which a writer thread formats
+ * and writes once full; when all buffers are in use, spans are dropped and
+ * counted.  stop() may run while other threads still simulate: it waits for
+ * the spans being appended, and later spans are not recorded. */
+class Timeline
+{
+public:
+	static enum status start(const char *filename, double begin = 0.0, double end = -1.0);
+	static enum status stop(void);
+	static inline bool enabled(void) { return recording.load(std::memory_order_relaxed); }
+	static ulong next_request(void);
+	static void span(enum timeline_track track, uint index, uint sub_index, enum timeline_op op, double start, double duration);
+	static ulong get_num_spans(void);
+	static ulong get_num_dropped(void);
+private:
+	static std::atomic<bool> recording;
+};
+
+/* Sampled simulation of long traces in the spirit of SMARTS.  Requests are
+ * counted in periods of period requests; the start of each period runs in
+ * counting mode, which keeps the FTL and block state exact, then warmup
+ * requests run with full timing to refill the bus queues and the last window
+ * requests are measured.  The mean latency of each window is one
+ * observation, and totals over all requests are extrapolated from the mean
+ * of the windows with a 95% confidence interval. */
+class Sampler
+{
+public:
+	Sampler(Ssd &ssd, ulong period, ulong warmup, ulong window);
+	double event_arrive(enum event_type type, ulong logical_address, uint size, double start_time);
+	void fast_forward(bool enabled);
+	void finish(void);
+	void reset(void);
+	ulong get_measured(void) const;
+
+	/* READ or WRITE requests, or all requests when called without a type */
+	ulong get_requests(void) const;
+	ulong get_requests(enum event_type type) const;
+	const Sample_stats &get_latency(void) const;
+	const Sample_stats &get_latency(enum event_type type) const;
+	double estimate_total(void) const;
+	double estimate_total(enum event_type type) const;
+	double estimate_total_ci(void) const;
+	double estimate_total_ci(enum event_type type) const;
+	void print(FILE *stream = stdout) const;
+private:
+	/* READ, WRITE and all requests */
+	static const uint KINDS = 3;
+	static const uint ALL = 2;
+	static uint kind(enum event_type type);
+	void set_counting(bool counting);
+	void close_window(void);
+
+	Ssd &ssd;
+	ulong period;
+	ulong warmup;
+	ulong window;
+	bool forced;
+	bool counting;
+
+	ulong position;
+	ulong measured;
+	ulong requests[KINDS];
+	ulong window_requests[KINDS];
+	double window_time[KINDS];
+	Sample_stats latency[KINDS];
+};
+
+/* One request of a binary trace file.  delta is the time since the previous
+ * record (since 0 for the first), in the time units of the trace. */
+struct Trace_record
+{
+	uint8_t type;
+	uint32_t size;
+	uint64_t logical_address;
+	double delta;
+} __attribute__((packed));
+
+/* Writes a binary trace: a header holding a magic and the number of
+ * records, followed by packed Trace_records in native byte order.
+ * append_uflip() converts a text trace of the uFLIP format that
+ * run_ufliptrace.cpp replays ("S; W; address; query; size; time"). */
+class Trace_writer
+{
+public:
+	Trace_writer(void);
+	~Trace_writer(void);
+	enum status create(const char *filename);
+	void write(enum event_type type, ulong logical_address, uint size, double time);
+	enum status append_uflip(const char *filename);
+	enum status close(void);
+	ulong size(void) const;
+private:
+	FILE *file;
+	ulong count;
+	double last_time;
+	bool failed;
+};
+
+/* Streams a binary trace from a read-only mapping.  next() returns records
+ * in place, without copying, and advises the kernel to read ahead of them;
+ * get_time() sums the deltas into the time of the last record returned. */
+class Trace_reader
+{
+public:
+	Trace_reader(void);
+	~Trace_reader(void);
+	static bool is_trace(const char *filename);
+	enum status open(const char *filename);
+	void close(void);
+	ulong size(void) const;
+	void rewind(void);
+	const Trace_record *next(void);
+	double get_time(void) const;
+private:
+	void read_ahead(void);
+
+	char *data;
+	size_t length;
+	const Trace_record *records;
+	ulong count;
+	ulong position;
+	ulong advised;
+	double time;
+};
+
+/* Lock-free ring buffer between one producer and one consumer thread.  The
+ * capacity is rounded up to a power of two; push() fails when the buffer is
+ * full and pop() when it is empty. */
+template <class T> class Ring_buffer
+{
+public:
+	Ring_buffer(size_t capacity):
+		mask(1),
+		head(0),
+		tail(0)
+	{
+		while (mask < capacity)
+			mask <<= 1;
+		slots.resize(mask);
+		mask--;
+	}
+	bool push(const T &value)
+	{
+		size_t position = tail.load(std::memory_order_relaxed);
+		if (position - head.load(std::memory_order_acquire) > mask)
+			return false;
+		slots[position & mask] = value;
+		tail.store(position + 1, std::memory_order_release);
+		return true;
+	}
+	bool pop(T &value)
+	{
+		size_t position = head.load(std::memory_order_relaxed);
+		if (position == tail.load(std::memory_order_acquire))
+			return false;
+		value = slots[position & mask];
+		head.store(position + 1, std::memory_order_release);
+		return true;
+	}
+private:
+	std::vector<T> slots;
+	size_t mask;
+
+	/* next slot to pop (consumer) and to push (producer), on separate lines */
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+};
+
+/* One request of an imported trace, in pages of the configured drive and in
+ * simulator time units since the first request */
+struct Trace_request
+{
+	enum event_type type;
+	ulong logical_address;
+	uint size;
+	double time;
+};
+
+/* Streams a text block trace into Trace_requests.  A parser thread reads and
+ * converts the file into a Ring_buffer that next() drains, so replay does
+ * not wait for I/O or parsing.  Byte offsets become logical pages of
+ * PAGE_SIZE, fitted to the drive configured when open() is called, and
+ * timestamps are multiplied by time_scale (simulator time units per second,
+ * microseconds by default).  Lines that are not read or write requests are
+ * skipped and counted. */
+class Trace_importer
+{
+public:
+	Trace_importer(size_t capacity = 1 << 16);
+	~Trace_importer(void);
+	static enum status parse_format(const char *name, enum trace_format &format);
+	enum status open(const char *filename, enum trace_format format, enum trace_address_mode mode = TRACE_WRAP, ulong trace_pages = 0, double time_scale = 1e6);
+	bool next(Trace_request &request);
+	void close(void);
+	ulong get_skipped(void) const;
+private:
+	void parse(void);
+	bool parse_line(char *line, Trace_request &request);
+	bool fit(ulong page, ulong pages, Trace_request &request) const;
+
+	FILE *file;
+	enum trace_format format;
+	enum trace_address_mode mode;
+	ulong trace_pages;
+	ulong device_pages;
+	uint page_size;
+	double time_scale;
+	bool have_first;
+	long double first_time;
+
+	Ring_buffer<Trace_request> ring;
+	std::thread parser;
+	std::atomic<bool> done;
+	std::atomic<bool> stopping;
+	std::atomic<ulong> skipped;
+};
+
+/* Synthetic workload generators.  Each generator draws single-page requests
+ * over logical pages [0, pages) from its own Random, writes with probability
+ * write_ratio, trims with probability trim_ratio (default 0), reads
+ * otherwise, and spaces arrival times gap apart.  next_batch() fills a
+ * whole buffer of requests at once, reusing its storage. */
+class Generator
+{
+public:
+	Generator(ulong pages, double write_ratio, uint64_t seed, double gap = 1.0);
+	virtual ~Generator(void);
+	virtual void next_batch(std::vector<Trace_request> &batch, uint n);
+	void set_time(double time);
+	double get_time(void) const;
+	void set_write_ratio(double write_ratio);
+	void set_trim_ratio(double trim_ratio);
+	ulong get_pages(void) const;
+protected:
+	virtual ulong next_address(void) = 0;
+
+	Random random;
+	ulong pages;
+	double write_ratio;
+	double trim_ratio;
+	double gap;
+	double time;
+};
+
+/* Every page equally likely */
+class Uniform_generator : public Generator
+{
+public:
+	Uniform_generator(ulong pages, double write_ratio, uint64_t seed, double gap = 1.0);
+protected:
+	ulong next_address(void);
+};
+
+/* Zipf distribution with the given exponent over page ranks; page 0 is the
+ * most popular.  Uses the rejection-inversion sampler of Hormann and
+ * Derflinger, which needs no table and O(1) time per draw. */
+class Zipf_generator : public Generator
+{
+public:
+	Zipf_generator(ulong pages, double exponent, double write_ratio, uint64_t seed, double gap = 1.0);
+protected:
+	ulong next_address(void);
+private:
+	double h(double x) const;
+	double h_integral(double x) const;
+	double h_integral_inverse(double x) const;
+
+	double exponent;
+	double h_integral_x1;
+	double h_integral_n;
+	double s;
+};
+
+/* hot_access of the requests go to the first hot_fraction of the pages, the
+ * rest to the other pages; uniform within each set */
+class Hot_cold_generator : public Generator
+{
+public:
+	Hot_cold_generator(ulong pages, double hot_fraction, double hot_access, double write_ratio, uint64_t seed, double gap = 1.0);
+protected:
+	ulong next_address(void);
+private:
+	ulong hot_pages;
+	double hot_access;
+};
+
+/* Pages start, start + stride, ... wrapping at the end of the pages; stride
+ * 1 is sequential */
+class Stride_generator : public Generator
+{
+public:
+	Stride_generator(ulong pages, ulong stride, double write_ratio, uint64_t seed, double gap = 1.0, ulong start = 0);
+protected:
+	ulong next_address(void);
+private:
+	ulong stride;
+	ulong position;
+};
+
+/* Runs phases one after the other, each for its number of requests, and
+ * starts over after the last one.  Takes ownership of the phase generators;
+ * arrival times continue across phases. */
+class Phase_generator : public Generator
+{
+public:
+	Phase_generator(void);
+	~Phase_generator(void);
+	void add_phase(Generator *generator, ulong requests);
+	void next_batch(std::vector<Trace_request> &batch, uint n);
+protected:
+	ulong next_address(void);
+private:
+	std::vector<Generator *> phases;
+	std::vector<ulong> lengths;
+	uint phase;
+	ulong done;
+	std::vector<Trace_request> chunk;
 };
 } /* end namespace ssd */
 
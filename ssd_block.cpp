@@ -277,3 +277,37 @@ void Block::set_block_type(block_type value)
 {
 	this->btype = value;
 }
+
+void Block::save(Snapshot &snapshot) const
+{
+	snapshot.put(pages_invalid);
+	snapshot.put(pages_valid);
+	snapshot.put(state);
+	snapshot.put(erases_remaining);
+	snapshot.put(last_erase_time);
+	snapshot.put(modification_time);
+	snapshot.put(btype);
+
+	std::vector<unsigned char> states(size);
+	for (uint i = 0; i < size; i++)
+		states[i] = data[i].get_state();
+	snapshot.write(&states[0], size);
+}
+
+/* The Block_manager indexes blocks by these counters; it rebuilds its
+ * indices after the blocks are loaded. */
+void Block::load(Snapshot &snapshot)
+{
+	snapshot.get(pages_invalid);
+	snapshot.get(pages_valid);
+	snapshot.get(state);
+	snapshot.get(erases_remaining);
+	snapshot.get(last_erase_time);
+	snapshot.get(modification_time);
+	snapshot.get(btype);
+
+	std::vector<unsigned char> states(size);
+	snapshot.read(&states[0], size);
+	for (uint i = 0; i < size; i++)
+		data[i].set_state((enum page_state) states[i]);
+}
@@ -18,7 +18,7 @@
 using namespace ssd;
 
 
-Block_manager::Block_manager(FtlParent *ftl) : ftl(ftl)
+Block_manager::Block_manager(FtlParent *ftl) : ftl(ftl), wear_leveler(*ftl)
 {
 	/*
 	 * Configuration of blocks.
@@ -47,6 +47,9 @@ Block_manager::Block_manager(FtlParent *ftl) : ftl(ftl)
 
 	simpleCurrentFree = 0;
 
+	erases_since_wear_level = 0;
+	migrating = false;
+
 	active_cost.reserve(NUMBER_OF_ADDRESSABLE_BLOCKS);
 }
 
@@ -60,25 +63,44 @@ void Block_manager::cost_insert(Block *b)
 	active_cost.push_back(b);
 }
 
+/* The Block_manager is owned by the active SimContext */
 void Block_manager::instance_initialize(FtlParent *ftl)
 {
-	Block_manager::inst = new Block_manager(ftl);
+	SimContext *context = SimContext::current();
+	delete context->block_manager;
+	context->block_manager = new Block_manager(ftl);
 }
 
 Block_manager *Block_manager::instance()
 {
-	return Block_manager::inst;
+	return SimContext::current()->block_manager;
 }
 
 /*
  * Retrieves a page using either simple approach (when not all
  * pages have been written or the complex that retrieves
  * it from a free page list.
+ *
+ * When a plane is given, an erased block on that plane is preferred, so
+ * the caller can move pages into it with copy-back.
+ *
+ * Erased blocks are handed out by the wear leveler, least worn first.
  */
-void Block_manager::get_page_block(Address &address, Event &event)
+void Block_manager::get_page_block(Address &address, Event &event, const Address *plane)
 {
 	// We need separate queues for each plane? communication channel? communication channel is at the per die level at the moment. i.e. each LUN is a die.
 
+	if (plane != NULL)
+	{
+		Block *block = wear_leveler.get_free_block(plane, migrating);
+		if (block != NULL)
+		{
+			address.set_linear_address(block->get_physical_address(), BLOCK);
+			current_writing_block = block->get_physical_address();
+			return;
+		}
+	}
+
 	if (simpleCurrentFree < max_blocks*BLOCK_SIZE)
 	{
 		address.set_linear_address(simpleCurrentFree, BLOCK);
@@ -87,16 +109,16 @@ void Block_manager::get_page_block(Address &address, Event &event)
 	}
 	else
 	{
-		if (free_list.size() <= 1 && !out_of_blocks)
+		if (wear_leveler.size() <= 1 && !out_of_blocks)
 		{
 			out_of_blocks = true;
 			insert_events(event);
 		}
 
-		assert(free_list.size() != 0);
-		address.set_linear_address(free_list.front()->get_physical_address(), BLOCK);
-		current_writing_block = free_list.front()->get_physical_address();
-		free_list.erase(free_list.begin());
+		assert(wear_leveler.size() != 0);
+		Block *block = wear_leveler.get_free_block(NULL, migrating);
+		address.set_linear_address(block->get_physical_address(), BLOCK);
+		current_writing_block = block->get_physical_address();
 		out_of_blocks = false;
 	}
 }
@@ -140,9 +162,31 @@ void Block_manager::print_statistics()
 	printf("-----------------\n");
 	printf("Log blocks:  %lu\n", log_active);
 	printf("Data blocks: %lu\n", data_active);
-	printf("Free blocks: %lu\n", (max_blocks - (simpleCurrentFree/BLOCK_SIZE)) + free_list.size());
+	printf("Free blocks: %lu\n", (max_blocks - (simpleCurrentFree/BLOCK_SIZE)) + wear_leveler.size());
 	printf("Invalid blocks: %lu\n", invalid_list.size());
-	printf("Free2 blocks: %lu\n", (unsigned long int)invalid_list.size() + (unsigned long int)log_active + (unsigned long int)data_active - (unsigned long int)free_list.size());
+	printf("Free2 blocks: %lu\n", (unsigned long int)invalid_list.size() + (unsigned long int)log_active + (unsigned long int)data_active - (unsigned long int)wear_leveler.size());
+	printf("-----------------\n");
+
+	// Wear leveling
+	ulong min_erases = BLOCK_ERASES;
+	ulong max_erases = 0;
+	double total_erases = 0;
+	for (ActiveBySeq::iterator it = active_cost.get<0>().begin(); it != active_cost.get<0>().end(); ++it)
+	{
+		ulong erases = BLOCK_ERASES - (*it)->get_erases_remaining();
+		min_erases = std::min(min_erases, erases);
+		max_erases = std::max(max_erases, erases);
+		total_erases += erases;
+	}
+
+	if (active_cost.size() == 0)
+		min_erases = 0;
+
+	printf("Erase count min: %lu max: %lu spread: %lu avg: %f\n", min_erases, max_erases, max_erases - min_erases, active_cost.size() == 0 ? 0.0 : total_erases / active_cost.size());
+	ulong allocations = wear_leveler.get_num_allocations();
+	printf("Wear leveler allocations: %lu index operations: %f tree levels: %f per allocation\n", allocations,
+			allocations == 0 ? 0.0 : (double) wear_leveler.get_num_index_operations() / allocations,
+			allocations == 0 ? 0.0 : (double) wear_leveler.get_num_index_levels() / allocations);
 	printf("-----------------\n");
 
 
@@ -171,8 +215,10 @@ void Block_manager::invalidate(Address address, block_type type)
  */
 void Block_manager::insert_events(Event &event)
 {
+	wear_level(event);
+
 	// Calculate if GC should be activated.
-	float used = (int)invalid_list.size() + (int)log_active + (int)data_active - (int)free_list.size();
+	float used = (int)invalid_list.size() + (int)log_active + (int)data_active - (int)wear_leveler.size();
 	float total = NUMBER_OF_ADDRESSABLE_BLOCKS;
 	float ratio = used/total;
 
@@ -186,21 +232,23 @@ void Block_manager::insert_events(Event &event)
 	// First step and least expensive is to go though invalid list. (Only used by FAST)
 	while (num_to_erase != 0 && invalid_list.size() != 0)
 	{
-		Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_start_time());
+		Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_sub_event_time());
 		erase_event.set_address(Address(invalid_list.back()->get_physical_address(), BLOCK));
 		if (ftl->controller.issue(erase_event) == FAILURE) {	assert(false);}
-		event.incr_time_taken(erase_event.get_time_taken());
+		event.incr_time_taken(erase_event.get_time_taken(), COMPONENT_GC);
 
-		free_list.push_back(invalid_list.back());
+		wear_leveler.insert(invalid_list.back());
 		invalid_list.pop_back();
 
 		num_to_erase--;
+		erases_since_wear_level++;
 		ftl->controller.stats.numFTLErase++;
+		ftl->controller.stats.numGCErase++;
 	}
 
 	num_insert_events++;
 
-	if (FTL_IMPLEMENTATION == IMPL_DFTL || FTL_IMPLEMENTATION == IMPL_BIMODAL)
+	if (FTL_IMPLEMENTATION == IMPL_DFTL || FTL_IMPLEMENTATION == IMPL_BIMODAL || FTL_IMPLEMENTATION == IMPL_MNFTL)
 	{
 
 		ActiveByCost::iterator it = active_cost.get<1>().end();
@@ -218,17 +266,19 @@ void Block_manager::insert_events(Event &event)
 				ftl->cleanup_block(event, blockErase);
 
 				// Create erase event and attach to current event queue.
-				Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_start_time());
+				Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_sub_event_time());
 				erase_event.set_address(Address(blockErase->get_physical_address(), BLOCK));
 
 				// Execute erase
 				if (ftl->controller.issue(erase_event) == FAILURE) { assert(false);	}
 
-				free_list.push_back(blockErase);
+				wear_leveler.insert(blockErase);
 
-				event.incr_time_taken(erase_event.get_time_taken());
+				event.incr_time_taken(erase_event.get_time_taken(), COMPONENT_GC);
 
+				erases_since_wear_level++;
 				ftl->controller.stats.numFTLErase++;
+				ftl->controller.stats.numGCErase++;
 			}
 
 			it = active_cost.get<1>().end();
@@ -246,6 +296,24 @@ Address Block_manager::get_free_block(block_type type, Event &event)
 {
 	Address address;
 	get_page_block(address, event);
+	activate_block(address, type);
+	return address;
+}
+
+/*
+ * Same as above, but prefers a block on the same plane as the given address.
+ * Falls back to any free block when the plane has none.
+ */
+Address Block_manager::get_free_block(block_type type, Event &event, const Address &plane)
+{
+	Address address;
+	get_page_block(address, event, &plane);
+	activate_block(address, type);
+	return address;
+}
+
+void Block_manager::activate_block(const Address &address, block_type type)
+{
 	switch (type)
 	{
 	case DATA:
@@ -262,8 +330,6 @@ Address Block_manager::get_free_block(block_type type, Event &event)
 	default:
 		break;
 	}
-
-	return address;
 }
 
 void Block_manager::print_cost_status()
@@ -296,7 +362,7 @@ void Block_manager::erase_and_invalidate(Event &event, Address &address, block_t
 
 	if (ftl->controller.issue(erase_event) == FAILURE) { assert(false);}
 
-	free_list.push_back(ftl->get_block_pointer(address));
+	wear_leveler.insert(ftl->get_block_pointer(address));
 
 	switch (btype)
 	{
@@ -310,16 +376,90 @@ void Block_manager::erase_and_invalidate(Event &event, Address &address, block_t
 		break;
 	}
 
-	event.incr_time_taken(erase_event.get_time_taken());
+	event.incr_time_taken(erase_event.get_time_taken(), COMPONENT_GC);
+	erases_since_wear_level++;
 	ftl->controller.stats.numFTLErase++;
+	ftl->controller.stats.numGCErase++;
+}
+
+/*
+ * Static wear leveling. Blocks holding cold data are never reclaimed by GC,
+ * so when the least worn block with data trails the most worn block by more
+ * than WEAR_LEVEL_THRESHOLD erases, its data is moved out and the block is
+ * returned to the free pool. The blocks are scanned at most once every
+ * WEAR_LEVEL_INTERVAL erases, whether or not a block is migrated, to bound
+ * the cost seen by the host. The cold data goes to the most worn free
+ * blocks, which leaves the fresh ones to hot data.
+ */
+void Block_manager::wear_level(Event &event)
+{
+	if (WEAR_LEVEL_THRESHOLD == 0 || erases_since_wear_level < WEAR_LEVEL_INTERVAL)
+		return;
+
+	// Migration relies on the FTL to relocate pages.
+	if (FTL_IMPLEMENTATION != IMPL_DFTL && FTL_IMPLEMENTATION != IMPL_BIMODAL && FTL_IMPLEMENTATION != IMPL_MNFTL)
+		return;
+
+	erases_since_wear_level = 0;
+
+	ActiveByWear &by_wear = active_cost.get<2>();
+	ulong most_worn = BLOCK_ERASES - (*by_wear.begin())->get_erases_remaining();
+
+	for (ActiveByWear::reverse_iterator it = by_wear.rbegin(); it != by_wear.rend(); ++it)
+	{
+		Block *block = *it;
+		ulong erases = BLOCK_ERASES - block->get_erases_remaining();
+
+		if (most_worn - erases <= WEAR_LEVEL_THRESHOLD)
+			return;
+
+		// get_pages_valid() counts every programmed page, invalidated ones
+		// included. Like GC, leave blocks that are still being written to,
+		// and skip blocks without live data.
+		uint programmed = block->get_pages_valid();
+		uint live = programmed - block->get_pages_invalid();
+		if (block->get_state() != ACTIVE || programmed < BLOCK_SIZE || live == 0 || current_writing_block == block->physical_address)
+			continue;
+
+		// cleanup_block counts the copies as GC, move them to wear leveling.
+		Stats &stats = ftl->controller.stats;
+		long gc_read = stats.numGCRead;
+		long gc_write = stats.numGCWrite;
+
+		migrating = true;
+		ftl->cleanup_block(event, block);
+		migrating = false;
+
+		stats.numWLRead += stats.numGCRead - gc_read;
+		stats.numWLWrite += stats.numGCWrite - gc_write;
+		stats.numGCRead = gc_read;
+		stats.numGCWrite = gc_write;
+
+		Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_sub_event_time());
+		erase_event.set_address(Address(block->get_physical_address(), BLOCK));
+		if (ftl->controller.issue(erase_event) == FAILURE) { assert(false); }
+
+		wear_leveler.insert(block);
+
+		event.incr_time_taken(erase_event.get_time_taken(), COMPONENT_GC);
+
+		stats.numFTLErase++;
+		stats.numWLErase++;
+		return;
+	}
 }
 
 int Block_manager::get_num_free_blocks()
 {
 	if (simpleCurrentFree < max_blocks*BLOCK_SIZE)
-		return (simpleCurrentFree / BLOCK_SIZE) + free_list.size();
+		return (simpleCurrentFree / BLOCK_SIZE) + wear_leveler.size();
 	else
-		return free_list.size();
+		return wear_leveler.size();
+}
+
+bool Block_manager::is_unused(void) const
+{
+	return simpleCurrentFree == 0 && wear_leveler.size() == 0 && data_active == 0 && log_active == 0;
 }
 
 void Block_manager::update_block(Block * b)
@@ -327,3 +467,102 @@ void Block_manager::update_block(Block * b)
 	std::size_t pos = (b->physical_address / BLOCK_SIZE);
 	active_cost.replace(active_cost.begin()+pos, b);
 }
+
+/*
+ * The cost and wear indices break ties by the history of the blocks, so
+ * both orders are stored.  The sequence index is always in physical block
+ * order (see update_block).
+ */
+void Block_manager::save(Snapshot &snapshot) const
+{
+	snapshot.put(data_active);
+	snapshot.put(log_active);
+	snapshot.put(directoryCurrentPage);
+	snapshot.put(simpleCurrentFree);
+	snapshot.put(num_insert_events);
+	snapshot.put(current_writing_block);
+	snapshot.put(out_of_blocks);
+	snapshot.put(erases_since_wear_level);
+
+	wear_leveler.save(snapshot);
+
+	snapshot.put((ulong) active_list.size());
+	for (uint i = 0; i < active_list.size(); i++)
+		snapshot.put_block(active_list[i]);
+	snapshot.put((ulong) invalid_list.size());
+	for (uint i = 0; i < invalid_list.size(); i++)
+		snapshot.put_block(invalid_list[i]);
+
+	snapshot.put((ulong) active_cost.size());
+	for (ActiveByCost::const_iterator it = active_cost.get<1>().begin(); it != active_cost.get<1>().end(); ++it)
+		snapshot.put_block(*it);
+	for (ActiveByWear::const_iterator it = active_cost.get<2>().begin(); it != active_cost.get<2>().end(); ++it)
+		snapshot.put_block(*it);
+}
+
+/*
+ * Must run after the blocks are loaded, as the indices are keyed on them.
+ * Blocks are inserted in wear order, each one placed among the blocks of
+ * equal cost according to its stored cost rank.
+ */
+void Block_manager::load(Snapshot &snapshot)
+{
+	snapshot.get(data_active);
+	snapshot.get(log_active);
+	snapshot.get(directoryCurrentPage);
+	snapshot.get(simpleCurrentFree);
+	snapshot.get(num_insert_events);
+	snapshot.get(current_writing_block);
+	snapshot.get(out_of_blocks);
+	snapshot.get(erases_since_wear_level);
+
+	wear_leveler.load(snapshot, *ftl);
+
+	ulong count = 0;
+	snapshot.get(count);
+	active_list.clear();
+	for (ulong i = 0; i < count && snapshot.good(); i++)
+		active_list.push_back(snapshot.get_block(*ftl));
+	snapshot.get(count);
+	invalid_list.clear();
+	for (ulong i = 0; i < count && snapshot.good(); i++)
+		invalid_list.push_back(snapshot.get_block(*ftl));
+
+	snapshot.get(count);
+	if (!snapshot.good() || count != active_cost.size())
+	{
+		fprintf(stderr, "Block_manager error: %s: snapshot does not match the drive\n", __func__);
+		return;
+	}
+
+	std::vector<ulong> cost_rank(count);
+	for (ulong i = 0; i < count; i++)
+	{
+		Block *block = snapshot.get_block(*ftl);
+		if (block != NULL)
+			cost_rank[block->physical_address / BLOCK_SIZE] = i;
+	}
+	std::vector<Block *> by_wear;
+	for (ulong i = 0; i < count; i++)
+		by_wear.push_back(snapshot.get_block(*ftl));
+	if (!snapshot.good())
+		return;
+
+	active_cost.clear();
+	ActiveByCost &by_cost = active_cost.get<1>();
+	std::map<uint, std::map<ulong, ActiveByCost::iterator> > placed;
+	for (ulong i = 0; i < count; i++)
+	{
+		Block *block = by_wear[i];
+		ulong rank = cost_rank[block->physical_address / BLOCK_SIZE];
+		std::map<ulong, ActiveByCost::iterator> &equal = placed[block->pages_invalid];
+		std::map<ulong, ActiveByCost::iterator>::iterator next = equal.upper_bound(rank);
+		ActiveByCost::iterator hint = next != equal.end() ? next->second : by_cost.upper_bound(block->pages_invalid);
+		equal[rank] = by_cost.insert(hint, block);
+	}
+
+	std::vector<boost::reference_wrapper<Block * const> > sequence(count, boost::cref(*active_cost.begin()));
+	for (ActiveBySeq::iterator it = active_cost.begin(); it != active_cost.end(); ++it)
+		sequence[(*it)->physical_address / BLOCK_SIZE] = boost::cref(*it);
+	active_cost.rearrange(sequence.begin());
+}
@@ -118,7 +118,14 @@ enum status Bus::disconnect(uint channel)
 enum status Bus::lock(uint channel, double start_time, double duration, Event &event)
 {
 	assert(channels != NULL && start_time >= 0.0 && duration > 0.0);
-	return channels[channel].lock(start_time, duration, event);
+	if (!Timeline::enabled())
+		return channels[channel].lock(start_time, duration, event);
+
+	/* the transfer starts once the channel wait added to the event is over */
+	double wait = event.get_bus_wait_time();
+	enum status status = channels[channel].lock(start_time, duration, event);
+	Timeline::span(TRACK_CHANNEL, channel, 0, TIMELINE_BUS, start_time + event.get_bus_wait_time() - wait, duration);
+	return status;
 }
 
 Channel &Bus::get_channel(uint channel)
@@ -132,3 +139,15 @@ double Bus::ready_time(uint channel)
 	assert(channels != NULL && channel < num_channels);
 	return channels[channel].ready_time();
 }
+
+void Bus::save(Snapshot &snapshot) const
+{
+	for (uint i = 0; i < num_channels; i++)
+		channels[i].save(snapshot);
+}
+
+void Bus::load(Snapshot &snapshot)
+{
+	for (uint i = 0; i < num_channels; i++)
+		channels[i].load(snapshot);
+}
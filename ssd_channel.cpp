@@ -68,8 +68,6 @@ Channel::Channel(double ctrl_delay, double data_delay, uint table_size, uint max
 		data_delay = 0.0;
 	}
 
-	timings.reserve(4096);
-
 	ready_at = -1;
 }
 
@@ -128,7 +126,7 @@ enum status Channel::lock(double start_time, double duration, Event &event)
 	assert(start_time >= 0.0);
 	assert(duration >= 0.0);
 
-	/* free up any table slots and sort existing ones */
+	/* free up any table slots */
 	unlock(start_time);
 
 	double sched_time = BUS_CHANNEL_FREE_FLAG;
@@ -137,50 +135,27 @@ enum status Channel::lock(double start_time, double duration, Event &event)
 	if(timings.size() == 0)
 		sched_time = start_time;
 
-	/* check if can schedule before or in between before just scheduling
-	 * after all other events */
+	/* schedule before first event in table */
+	else if(timings.begin()->first > start_time && timings.begin()->first - start_time >= duration)
+		sched_time = start_time;
+
+	/* schedule in the first gap between two events that is large enough,
+	 * or after all other events */
 	else
 	{
-		/* skip over empty table entries
-		 * empty table entries will be first from sorting (in unlock method)
-		 * because the flag is a negative value */
-		std::vector<lock_times>::iterator it = timings.begin();
-
-		/* schedule before first event in table */
-		if((*it).lock_time > start_time && (*it).lock_time - start_time >= duration)
-			sched_time = start_time;
-
-		/* schedule in between other events in table */
-		if(sched_time == BUS_CHANNEL_FREE_FLAG)
-		{
-			for(; it < timings.end(); it++)
-			{
-				if (it + 1 != timings.end())
-				{
-					/* enough time to schedule in between next two events */
-					if((*it).unlock_time >= start_time  && (*(it+1)).lock_time - (*it).unlock_time >= duration)
-					{
-						sched_time = (*it).unlock_time;
-						break;
-					}
-				}
-
-			}
-		}
-
-		/* schedule after all events in table */
-		if(sched_time == BUS_CHANNEL_FREE_FLAG)
-			sched_time = timings.back().unlock_time;
+		std::map<double, double>::iterator gap = gaps.begin();
+		for(; gap != gaps.end(); gap++)
+			if(gap->second >= duration)
+				break;
+		sched_time = gap != gaps.end() ? gap->first : timings.rbegin()->second;
 	}
 
-	/* write scheduling info in free table slot */
-	lock_times lt;
-	lt.lock_time = sched_time;
-	lt.unlock_time = sched_time + duration;
-	timings.push_back(lt);
+	/* a lock without duration does not occupy the channel */
+	if(duration > 0.0)
+		insert(sched_time, sched_time + duration);
 
-	if (lt.unlock_time > ready_at)
-		ready_at = lt.unlock_time;
+	if (sched_time + duration > ready_at)
+		ready_at = sched_time + duration;
 
 	/* update event times for bus wait and time taken */
 	event.incr_bus_wait_time(sched_time - start_time);
@@ -189,27 +164,34 @@ enum status Channel::lock(double start_time, double duration, Event &event)
 	return SUCCESS;
 }
 
-/* remove all expired entries (finish time is less than provided time)
- * update current number of table entries used
- * sort table by finish times (2nd row) */
-void Channel::unlock(double start_time)
+/* add an entry to the table and update the gaps on both sides of it */
+void Channel::insert(double lock_time, double unlock_time)
 {
-	/* remove expired channel lock entries */
-	std::vector<lock_times>::iterator it;
-	for ( it = timings.begin(); it < timings.end();)
+	std::map<double, double>::iterator next = timings.upper_bound(lock_time);
+
+	if(next != timings.begin())
 	{
-		if((*it).unlock_time <= start_time)
-			timings.erase(it);
-		else
-		{
-			it++;
-		}
+		std::map<double, double>::iterator prev = next;
+		prev--;
+		gaps.erase(prev->second);
+		if(lock_time > prev->second)
+			gaps[prev->second] = lock_time - prev->second;
 	}
-	std::sort(timings.begin(), timings.end(), &timings_sorter);
+	if(next != timings.end() && next->first > unlock_time)
+		gaps[unlock_time] = next->first - unlock_time;
+
+	timings[lock_time] = unlock_time;
 }
 
-bool Channel::timings_sorter(lock_times const& lhs, lock_times const& rhs) {
-    return lhs.lock_time < rhs.lock_time;
+/* remove all expired entries (finish time is less than provided time)
+ * entries do not overlap, so the expired ones are the first ones */
+void Channel::unlock(double start_time)
+{
+	while(timings.size() > 0 && timings.begin()->second <= start_time)
+	{
+		gaps.erase(timings.begin()->second);
+		timings.erase(timings.begin());
+	}
 }
 
 double Channel::ready_time(void)
@@ -217,3 +199,22 @@ double Channel::ready_time(void)
 	return ready_at;
 }
 
+
+/* connections are made when the drive is built and are not part of the state */
+void Channel::save(Snapshot &snapshot) const
+{
+	snapshot.put(timings);
+	snapshot.put(gaps);
+	snapshot.put(table_entries);
+	snapshot.put(selected_entry);
+	snapshot.put(ready_at);
+}
+
+void Channel::load(Snapshot &snapshot)
+{
+	snapshot.get(timings);
+	snapshot.get(gaps);
+	snapshot.get(table_entries);
+	snapshot.get(selected_entry);
+	snapshot.get(ready_at);
+}
@@ -25,160 +25,160 @@
  * support includes skipping blank lines, comment lines (begin with a #).
  * Parsed lines consist of the variable name, a space, then the value
  * (e.g. SSD_SIZE 4 ).  Default config values (if config file is missing
- * an entry to set the value) are defined in the variable declarations below.
+ * an entry to set the value) are assigned in the Config constructor below.
  *
  * A function is also provided for printing the current configuration. */
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include "ssd.h"
 
 /* using namespace ssd; */
 namespace ssd {
 
-/* Define typedefs and error macros from ssd.h here instead of including
- * header file because we want to declare the global configuration variables
- * and set them in this file.  ssd.h declares the global configuration
- * variables as extern const, which would conflict this file's definitions.
- * This is not the best solution, but it is easy and it works. */
-
-/* some obvious typedefs for laziness */
-typedef unsigned int uint;
-typedef unsigned long ulong;
-
-/* define exit codes for errors */
-#define MEM_ERR -1
-#define FILE_ERR -2
-
 /* Simulator configuration
- * All configuration variables are set by reading ssd.conf and referenced with
- * 	as "extern const" in ssd.h
+ * All configuration values are set by reading ssd.conf into the Config of
+ * 	the active SimContext and referenced through the macros in ssd.h
  * Configuration variables are described below and are assigned default values
  * 	in case of config file error.  The values defined below are overwritten
- * 	when defined in the config file.
- * We do not want a class here because we want to use the configuration
- * 	variables in the same was as macros. */
-
-/* Ram class:
- * 	delay to read from and write to the RAM for 1 page of data */
-double RAM_READ_DELAY = 0.00000001;
-double RAM_WRITE_DELAY = 0.00000001;
-
-/* Bus class:
- * 	delay to communicate over bus
- * 	max number of connected devices allowed
- * 	number of time entries bus has to keep track of future schedule usage
- * 	value used as a flag to indicate channel is free
- * 		(use a value not used as a delay value - e.g. -1.0)
- * 	number of simultaneous communication channels - defined by SSD_SIZE */
-double BUS_CTRL_DELAY = 0.000000005;
-double BUS_DATA_DELAY = 0.00000001;
-uint BUS_MAX_CONNECT = 8;
-uint BUS_TABLE_SIZE = 64;
-double BUS_CHANNEL_FREE_FLAG = -1.0;
-/* uint BUS_CHANNELS = 4; same as # of Packages, defined by SSD_SIZE */
-
-/* Ssd class:
- * 	number of Packages per Ssd (size) */
-uint SSD_SIZE = 4;
-
-/* Package class:
- * 	number of Dies per Package (size) */
-uint PACKAGE_SIZE = 8;
-
-/* Die class:
- * 	number of Planes per Die (size) */
-uint DIE_SIZE = 2;
-
-/* Plane class:
- * 	number of Blocks per Plane (size)
- * 	delay for reading from plane register
- * 	delay for writing to plane register
- * 	delay for merging is based on read, write, reg_read, reg_write 
- * 		and does not need to be explicitly defined */
-uint PLANE_SIZE = 64;
-double PLANE_REG_READ_DELAY = 0.0000000001;
-double PLANE_REG_WRITE_DELAY = 0.0000000001;
-
-/* Block class:
- * 	number of Pages per Block (size)
- * 	number of erases in lifetime of block
- * 	delay for erasing block */
-uint BLOCK_SIZE = 16;
-uint BLOCK_ERASES = 1048675;
-double BLOCK_ERASE_DELAY = 0.001;
-
-/* Page class:
- * 	delay for Page reads
- * 	delay for Page writes */
-double PAGE_READ_DELAY = 0.000001;
-double PAGE_WRITE_DELAY = 0.00001;
-
-/* Page data memory allocation
- *
- */
-uint PAGE_SIZE = 4096;
-bool PAGE_ENABLE_DATA = true;
-
-/*
- * Memory area to support pages with data.
- */
-void *page_data;
-
-/*
- * Number of blocks to reserve for mappings. e.g. map directory in BAST.
- */
-uint MAP_DIRECTORY_SIZE = 0;
-
-/*
- * Implementation to use (0 -> Page, 1 -> BAST, 2 -> FAST, 3 -> DFTL, 4 -> BiModal
- */
-uint FTL_IMPLEMENTATION = 0;
-
-/*
- * Limit of LOG pages (for use in BAST)
- */
-uint BAST_LOG_BLOCK_LIMIT = 100;
-
-
-/*
- * Limit of LOG pages (for use in FAST)
- */
-uint FAST_LOG_BLOCK_LIMIT = 4;
-
-/*
- * Number of pages allowed to be in DFTL Cached Mapping Table.
- * (Size equals CACHE_BLOCK_LIMIT * block size * page size)
- *
- */
-uint CACHE_DFTL_LIMIT = 8;
-
-/*
- * MNFTL
- */
-uint MNFTL_OOB_SIZE = 128;
-uint MNFTL_ENTRY_SIZE = 4;
-uint OOB_READ_DELAY = 1700;
-uint OOB_WRITE_DELAY = 3300;
-
-/*
- * Parallelism mode.
- * 0 -> Normal
- * 1 -> Striping
- * 2 -> Logical Address Space Parallelism (LASP)
- */
-uint PARALLELISM_MODE = 0;
-
-/* Virtual block size (as a multiple of the physical block size) */
-uint VIRTUAL_BLOCK_SIZE = 1;
-
-/* Virtual page size (as a multiple of the physical page size) */
-uint VIRTUAL_PAGE_SIZE = 1;
-
-uint NUMBER_OF_ADDRESSABLE_BLOCKS = 0;
-
-/* RAISSDs: Number of physical SSDs */
-uint RAID_NUMBER_OF_PHYSICAL_SSDS = 0;
+ * 	when defined in the config file. */
+Config::Config(void)
+{
+	/* Ram class:
+	 * 	delay to read from and write to the RAM for 1 page of data */
+	ram_read_delay = 0.00000001;
+	ram_write_delay = 0.00000001;
+
+	/* Bus class:
+	 * 	delay to communicate over bus
+	 * 	max number of connected devices allowed
+	 * 	number of time entries bus has to keep track of future schedule usage
+	 * 	value used as a flag to indicate channel is free
+	 * 		(use a value not used as a delay value - e.g. -1.0)
+	 * 	number of simultaneous communication channels - defined by SSD_SIZE */
+	bus_ctrl_delay = 0.000000005;
+	bus_data_delay = 0.00000001;
+	bus_max_connect = 8;
+	bus_table_size = 64;
+	bus_channel_free_flag = -1.0;
+	/* uint BUS_CHANNELS = 4; same as # of Packages, defined by SSD_SIZE */
+
+	/* Ssd class:
+	 * 	number of Packages per Ssd (size) */
+	ssd_size = 4;
+
+	/* Package class:
+	 * 	number of Dies per Package (size) */
+	package_size = 8;
+
+	/* Die class:
+	 * 	number of Planes per Die (size)
+	 * 	operations do not queue behind each other by default */
+	die_size = 2;
+	die_queueing = false;
+
+	/* Plane class:
+	 * 	number of Blocks per Plane (size)
+	 * 	delay for reading from plane register
+	 * 	delay for writing to plane register
+	 * 	delay for merging is based on read, write, reg_read, reg_write 
+	 * 		and does not need to be explicitly defined */
+	plane_size = 64;
+	plane_reg_read_delay = 0.0000000001;
+	plane_reg_write_delay = 0.0000000001;
+
+	/* Block class:
+	 * 	number of Pages per Block (size)
+	 * 	number of erases in lifetime of block
+	 * 	delay for erasing block */
+	block_size = 16;
+	block_erases = 1048675;
+	block_erase_delay = 0.001;
+
+	/* Page class:
+	 * 	delay for Page reads
+	 * 	delay for Page writes */
+	page_read_delay = 0.000001;
+	page_write_delay = 0.00001;
+
+	/* Page data memory allocation
+	 *
+	 */
+	page_size = 4096;
+	page_enable_data = true;
+
+	/*
+	 * Number of blocks to reserve for mappings. e.g. map directory in BAST.
+	 */
+	map_directory_size = 0;
+
+	/*
+	 * Implementation to use (0 -> Page, 1 -> BAST, 2 -> FAST, 3 -> DFTL, 4 -> BiModal
+	 */
+	ftl_implementation = 0;
+
+	/*
+	 * Limit of LOG pages (for use in BAST)
+	 */
+	bast_log_block_limit = 100;
+
+
+	/*
+	 * Limit of LOG pages (for use in FAST)
+	 */
+	fast_log_block_limit = 4;
+
+	/*
+	 * Number of pages allowed to be in DFTL Cached Mapping Table.
+	 * (Size equals CACHE_BLOCK_LIMIT * block size * page size)
+	 *
+	 */
+	cache_dftl_limit = 8;
+
+	/*
+	 * Static wear leveling.
+	 * Erase count difference between most and least worn block that triggers
+	 * migration of the least worn block (0 -> disabled), and the minimum number
+	 * of erases between two migrations.
+	 */
+	wear_level_threshold = 0;
+	wear_level_interval = 64;
+
+	/*
+	 * MNFTL
+	 */
+	mnftl_oob_size = 128;
+	mnftl_entry_size = 4;
+	oob_read_delay = 1700;
+	oob_write_delay = 3300;
+
+	/*
+	 * Parallelism mode.
+	 * 0 -> Normal
+	 * 1 -> Striping
+	 * 2 -> Logical Address Space Parallelism (LASP)
+	 */
+	parallelism_mode = 0;
+
+	/* Virtual block size (as a multiple of the physical block size) */
+	virtual_block_size = 1;
+
+	/* Virtual page size (as a multiple of the physical page size) */
+	virtual_page_size = 1;
+
+	number_of_addressable_blocks = 0;
+
+	/* RAISSDs: Number of physical SSDs */
+	raid_number_of_physical_ssds = 0;
+
+	/* RAISSDs: Worker threads driving the member SSDs
+	 * (0 -> one per member up to the number of cores, 1 -> calling thread) */
+	raid_threads = 0;
+
+	/* Counting mode: skip all timing, keep states and statistics */
+	counting_mode = false;
+}
 
 void load_entry(char *name, double value, uint line_number) {
 	/* cheap implementation - go through all possibilities and match entry */
@@ -200,6 +200,8 @@ void load_entry(char *name, double value, uint line_number) {
 		PACKAGE_SIZE = (uint) value;
 	else if (!strcmp(name, "DIE_SIZE"))
 		DIE_SIZE = (uint) value;
+	else if (!strcmp(name, "DIE_QUEUEING"))
+		DIE_QUEUEING = (value == 1);
 	else if (!strcmp(name, "PLANE_SIZE"))
 		PLANE_SIZE = (uint) value;
 	else if (!strcmp(name, "PLANE_REG_READ_DELAY"))
@@ -232,6 +234,10 @@ void load_entry(char *name, double value, uint line_number) {
 		FAST_LOG_BLOCK_LIMIT = value;
 	else if (!strcmp(name, "CACHE_DFTL_LIMIT"))
 		CACHE_DFTL_LIMIT = value;
+	else if (!strcmp(name, "WEAR_LEVEL_THRESHOLD"))
+		WEAR_LEVEL_THRESHOLD = value;
+	else if (!strcmp(name, "WEAR_LEVEL_INTERVAL"))
+		WEAR_LEVEL_INTERVAL = value;
 	else if (!strcmp(name, "MNFTL_OOB_SIZE"))
     	MNFTL_OOB_SIZE = (uint)value;
 	else if (!strcmp(name, "OOB_READ_DELAY"))
@@ -248,13 +254,20 @@ void load_entry(char *name, double value, uint line_number) {
 		VIRTUAL_PAGE_SIZE = value;
 	else if (!strcmp(name, "RAID_NUMBER_OF_PHYSICAL_SSDS"))
 		RAID_NUMBER_OF_PHYSICAL_SSDS = value;
+	else if (!strcmp(name, "RAID_THREADS"))
+		RAID_THREADS = value;
+	else if (!strcmp(name, "COUNTING_MODE"))
+		COUNTING_MODE = (value == 1);
 	else
 		fprintf(stderr, "Config file parsing error on line %u\n", line_number);
 	return;
 }
 
 void load_config(void) {
-	const char * const config_name = "ssd.conf";
+	load_config("ssd.conf");
+}
+
+void load_config(const char *config_name) {
 	FILE *config_file = NULL;
 
 	/* update sscanf line below with max name length (%s) if changing sizes */
@@ -287,11 +300,17 @@ void load_config(void) {
 	}
 	fclose(config_file);
 
-	NUMBER_OF_ADDRESSABLE_BLOCKS = (SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE) / VIRTUAL_PAGE_SIZE;
+	derive_config();
 
 	return;
 }
 
+/* Recomputes the values that follow from other entries, for use after
+ * load_entry() calls outside load_config() */
+void derive_config(void) {
+	NUMBER_OF_ADDRESSABLE_BLOCKS = (SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE) / VIRTUAL_PAGE_SIZE;
+}
+
 void print_config(FILE *stream) {
 	if (stream == NULL)
 		stream = stdout;
@@ -304,6 +323,7 @@ void print_config(FILE *stream) {
 	fprintf(stream, "SSD_SIZE: %u\n", SSD_SIZE);
 	fprintf(stream, "PACKAGE_SIZE: %u\n", PACKAGE_SIZE);
 	fprintf(stream, "DIE_SIZE: %u\n", DIE_SIZE);
+	fprintf(stream, "DIE_QUEUEING: %i\n", DIE_QUEUEING);
 	fprintf(stream, "PLANE_SIZE: %u\n", PLANE_SIZE);
 	fprintf(stream, "PLANE_REG_READ_DELAY: %.16lf\n", PLANE_REG_READ_DELAY);
 	fprintf(stream, "PLANE_REG_WRITE_DELAY: %.16lf\n", PLANE_REG_WRITE_DELAY);
@@ -316,8 +336,21 @@ void print_config(FILE *stream) {
 	fprintf(stream, "PAGE_ENABLE_DATA: %i\n", PAGE_ENABLE_DATA);
 	fprintf(stream, "MAP_DIRECTORY_SIZE: %i\n", MAP_DIRECTORY_SIZE);
 	fprintf(stream, "FTL_IMPLEMENTATION: %i\n", FTL_IMPLEMENTATION);
+	fprintf(stream, "BAST_LOG_BLOCK_LIMIT: %u\n", BAST_LOG_BLOCK_LIMIT);
+	fprintf(stream, "FAST_LOG_BLOCK_LIMIT: %u\n", FAST_LOG_BLOCK_LIMIT);
+	fprintf(stream, "CACHE_DFTL_LIMIT: %u\n", CACHE_DFTL_LIMIT);
+	fprintf(stream, "MNFTL_OOB_SIZE: %u\n", MNFTL_OOB_SIZE);
+	fprintf(stream, "MNFTL_ENTRY_SIZE: %u\n", MNFTL_ENTRY_SIZE);
+	fprintf(stream, "OOB_READ_DELAY: %.16lf\n", OOB_READ_DELAY);
+	fprintf(stream, "OOB_WRITE_DELAY: %.16lf\n", OOB_WRITE_DELAY);
+	fprintf(stream, "WEAR_LEVEL_THRESHOLD: %u\n", WEAR_LEVEL_THRESHOLD);
+	fprintf(stream, "WEAR_LEVEL_INTERVAL: %u\n", WEAR_LEVEL_INTERVAL);
 	fprintf(stream, "PARALLELISM_MODE: %i\n", PARALLELISM_MODE);
+	fprintf(stream, "VIRTUAL_BLOCK_SIZE: %u\n", VIRTUAL_BLOCK_SIZE);
+	fprintf(stream, "VIRTUAL_PAGE_SIZE: %u\n", VIRTUAL_PAGE_SIZE);
 	fprintf(stream, "RAID_NUMBER_OF_PHYSICAL_SSDS: %i\n", RAID_NUMBER_OF_PHYSICAL_SSDS);
+	fprintf(stream, "RAID_THREADS: %u\n", RAID_THREADS);
+	fprintf(stream, "COUNTING_MODE: %i\n", COUNTING_MODE);
 
 	return;
 }
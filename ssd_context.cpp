@@ -0,0 +1,82 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_context.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* SimContext class
+ *
+ * Holds the configuration, Block_manager and page data of one simulated
+ * SSD.  The context active on the calling thread is the one the rest of the
+ * simulator sees through SimContext::current(). */
+
+#include "ssd.h"
+
+using namespace ssd;
+
+/* Timeline process numbers of the drives */
+static std::atomic<uint> num_drives(0);
+
+SimContext SimContext::process_context;
+thread_local SimContext *SimContext::active = &SimContext::process_context;
+
+SimContext::SimContext(void):
+	config(),
+	block_manager(NULL),
+	page_data(NULL),
+	global_buffer(NULL),
+	timeline_drive(num_drives++),
+	timeline_request(0),
+	timeline_request_start(0.0),
+	preconditioning(false)
+{}
+
+SimContext::SimContext(const Config &config):
+	config(config),
+	block_manager(NULL),
+	page_data(NULL),
+	global_buffer(NULL),
+	timeline_drive(num_drives++),
+	timeline_request(0),
+	timeline_request_start(0.0),
+	preconditioning(false)
+{}
+
+SimContext::~SimContext(void)
+{
+	Scope scope(*this);
+	delete block_manager;
+}
+
+SimContext::Scope::Scope(SimContext &context):
+	previous(SimContext::active),
+	released(false)
+{
+	SimContext::active = &context;
+}
+
+SimContext::Scope::~Scope(void)
+{
+	release();
+}
+
+void SimContext::Scope::release(void)
+{
+	if (released)
+		return;
+	SimContext::active = previous;
+	released = true;
+}
@@ -60,7 +60,7 @@ Controller::Controller(Ssd &parent):
 		break;
 
 	case 5:
-        ftl = new FtlImpl_Mnftl(*this);
+        ftl = new FtlImpl_MNftl(*this);
         break;
 	}
 	return;
@@ -89,39 +89,44 @@ enum status Controller::issue(Event &event_list)
 {
 	Event *cur;
 
+	/* in counting mode only the flash states are updated, the bus and RAM
+	 * are skipped */
+	const bool timed = !COUNTING_MODE;
+
 	/* go through event list and issue each to the hardware
 	 * stop processing events and return failure status if any event in the 
 	 *    list fails */
 	for(cur = &event_list; cur != NULL; cur = cur -> get_next()){
-		if(cur -> get_size() != 1){
+		if(cur -> get_size() != 1 && cur -> get_event_type() != TRIM){
 			fprintf(stderr, "Controller: %s: Received non-single-page-sized event from FTL.\n", __func__);
 			return FAILURE;
 		}
 		else if(cur -> get_event_type() == READ)
 		{
 			assert(cur -> get_address().valid > NONE);
-			if(ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY, *cur) == FAILURE
+			if((timed && ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY, *cur) == FAILURE)
 				|| ssd.read(*cur) == FAILURE
-				|| ssd.bus.lock(cur -> get_address().package, cur -> get_start_time()+cur -> get_time_taken(), BUS_CTRL_DELAY + BUS_DATA_DELAY, *cur) == FAILURE
-				|| ssd.ram.write(*cur) == FAILURE
-				|| ssd.ram.read(*cur) == FAILURE
+				|| (timed && (ssd.bus.lock(cur -> get_address().package, cur -> get_start_time()+cur -> get_time_taken(), BUS_CTRL_DELAY + BUS_DATA_DELAY, *cur) == FAILURE
+					|| ssd.ram.write(*cur) == FAILURE
+					|| ssd.ram.read(*cur) == FAILURE))
 				|| ssd.replace(*cur) == FAILURE)
 				return FAILURE;
 		}
 		else if(cur -> get_event_type() == WRITE)
 		{
 			assert(cur -> get_address().valid > NONE);
-			if(ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY + BUS_DATA_DELAY, *cur) == FAILURE
-				|| ssd.ram.write(*cur) == FAILURE
-				|| ssd.ram.read(*cur) == FAILURE
+			if((timed && (ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY + BUS_DATA_DELAY, *cur) == FAILURE
+					|| ssd.ram.write(*cur) == FAILURE
+					|| ssd.ram.read(*cur) == FAILURE))
 				|| ssd.write(*cur) == FAILURE
 				|| ssd.replace(*cur) == FAILURE)
 				return FAILURE;
+			stats.numFlashWrite++;
 		}
 		else if(cur -> get_event_type() == ERASE)
 		{
 			assert(cur -> get_address().valid > NONE);
-			if(ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY, *cur) == FAILURE
+			if((timed && ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY, *cur) == FAILURE)
 				|| ssd.erase(*cur) == FAILURE)
 				return FAILURE;
 		}
@@ -129,9 +134,11 @@ enum status Controller::issue(Event &event_list)
 		{
 			assert(cur -> get_address().valid > NONE);
 			assert(cur -> get_merge_address().valid > NONE);
-			if(ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY, *cur) == FAILURE
-				|| ssd.merge(*cur) == FAILURE)
+			if((timed && ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY, *cur) == FAILURE)
+				|| ssd.merge(*cur) == FAILURE
+				|| ssd.replace(*cur) == FAILURE)
 				return FAILURE;
+			stats.numFlashWrite++;
 		}
 		else if(cur -> get_event_type() == TRIM)
 		{
@@ -146,6 +153,19 @@ enum status Controller::issue(Event &event_list)
 	return SUCCESS;
 }
 
+/* Applies a write to the page and block states only, without bus, RAM or
+ * flash timing.  Used to precondition a fresh drive.  The dies neither
+ * queue nor trace these writes, so the drive starts idle. */
+enum status Controller::program(Event &event)
+{
+	assert(event.get_event_type() == WRITE && event.get_address().valid > NONE);
+	SimContext *context = SimContext::current();
+	context->preconditioning = true;
+	enum status status = ssd.write(event);
+	context->preconditioning = false;
+	return status;
+}
+
 void Controller::translate_address(Address &address)
 {
 	if (PARALLELISM_MODE != 1)
@@ -221,3 +241,22 @@ void Controller::print_ftl_statistics()
 {
 	ftl->print_ftl_statistics();
 }
+
+void Controller::save(Snapshot &snapshot) const
+{
+	snapshot.put(stats);
+	Block_manager::instance()->save(snapshot);
+	ftl->save(snapshot);
+}
+
+void Controller::load(Snapshot &snapshot)
+{
+	snapshot.get(stats);
+	Block_manager::instance()->load(snapshot);
+	ftl->load(snapshot);
+}
+
+enum status Controller::precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed)
+{
+	return ftl->precondition(pattern, fill_fraction, seed);
+}
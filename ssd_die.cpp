@@ -48,7 +48,9 @@ Die::Die(const Package &parent, Channel &channel, uint die_size, long physical_a
 	erases_remaining(BLOCK_ERASES),
 
 	/* assume hardware created at time 0 and had an implied free erasure */
-	last_erase_time(0.0)
+	last_erase_time(0.0),
+
+	ready_time(0.0)
 {
 	uint i;
 
@@ -88,18 +90,56 @@ Die::~Die(void)
 	return;
 }
 
+/* with DIE_QUEUEING, an operation starts when the die finished the operation
+ * issued before it, in the order the controller issues them.  Precondition
+ * writes take no time and leave the die idle. */
+void Die::wait(Event &event)
+{
+	if (!DIE_QUEUEING || COUNTING_MODE || SimContext::current()->preconditioning)
+		return;
+	double now = event.get_start_time() + event.get_time_taken();
+	if (ready_time > now)
+	{
+		event.incr_die_wait_time(ready_time - now);
+		event.incr_time_taken(ready_time - now);
+	}
+}
+
+void Die::occupy(const Event &event)
+{
+	if (DIE_QUEUEING && !COUNTING_MODE && !SimContext::current()->preconditioning)
+		ready_time = event.get_start_time() + event.get_time_taken();
+}
+
+/* records the array operation that started at begin on the timeline */
+void Die::trace(const Event &event, enum timeline_op op, double begin) const
+{
+	if (Timeline::enabled() && !SimContext::current()->preconditioning)
+		Timeline::span(TRACK_DIE, event.get_address().package, event.get_address().die, op, begin, event.get_start_time() + event.get_time_taken() - begin);
+}
+
 enum status Die::read(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE);
-	return data[event.get_address().plane].read(event);
+	wait(event);
+	double begin = event.get_start_time() + event.get_time_taken();
+	enum status status = data[event.get_address().plane].read(event);
+	occupy(event);
+	trace(event, TIMELINE_READ, begin);
+	return status;
 }
 
 enum status Die::write(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE);
-	return data[event.get_address().plane].write(event);
+	wait(event);
+	double begin = event.get_start_time() + event.get_time_taken();
+	enum status status = data[event.get_address().plane].write(event);
+	occupy(event);
+	trace(event, TIMELINE_PROGRAM, begin);
+	return status;
 }
 
 enum status Die::replace(Event &event)
@@ -117,7 +157,11 @@ enum status Die::erase(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE);
+	wait(event);
+	double begin = event.get_start_time() + event.get_time_taken();
 	enum status status = data[event.get_address().plane].erase(event);
+	occupy(event);
+	trace(event, TIMELINE_ERASE, begin);
 
 	/* update values if no errors */
 	if(status == SUCCESS)
@@ -131,9 +175,15 @@ enum status Die::merge(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE && event.get_merge_address().plane < size && event.get_merge_address().valid > DIE);
+	wait(event);
+	double begin = event.get_start_time() + event.get_time_taken();
+	enum status status;
 	if(event.get_address().plane != event.get_merge_address().plane)
-		return _merge(event);
-	else return data[event.get_address().plane]._merge(event);
+		status = _merge(event);
+	else status = data[event.get_address().plane]._merge(event);
+	occupy(event);
+	trace(event, TIMELINE_COPY_BACK, begin);
+	return status;
 }
 
 /* TODO: update stub as per Die::merge() comment above
@@ -243,3 +293,23 @@ Block *Die::get_block_pointer(const Address & address)
 	assert(address.valid >= PLANE);
 	return data[address.plane].get_block_pointer(address);
 }
+
+void Die::save(Snapshot &snapshot) const
+{
+	snapshot.put(least_worn);
+	snapshot.put(erases_remaining);
+	snapshot.put(last_erase_time);
+	snapshot.put(ready_time);
+	for (uint i = 0; i < size; i++)
+		data[i].save(snapshot);
+}
+
+void Die::load(Snapshot &snapshot)
+{
+	snapshot.get(least_worn);
+	snapshot.get(erases_remaining);
+	snapshot.get(last_erase_time);
+	snapshot.get(ready_time);
+	for (uint i = 0; i < size; i++)
+		data[i].load(snapshot);
+}
@@ -35,7 +35,6 @@ using namespace ssd;
 Event::Event(enum event_type type, ulong logical_address, uint size, double start_time):
 	start_time(start_time),
 	time_taken(0.0),
-	bus_wait_time(0.0),
 	type(type),
 	logical_address(logical_address),
 	size(size),
@@ -44,6 +43,8 @@ Event::Event(enum event_type type, ulong logical_address, uint size, double star
 	noop(false)
 {
 	assert(start_time >= 0.0);
+	for (uint i = 0; i < LATENCY_COMPONENTS; i++)
+		component_time[i] = 0.0;
 	return;
 }
 
@@ -54,7 +55,7 @@ Event::~Event(void)
 
 /* find the last event in the list to finish and use that event's finish time
  * 	to calculate time_taken
- * add bus_wait_time for all events in the list to bus_wait_time
+ * add the bus and die waits and the other components for all events in the list
  * all events in the list do not need to start at the same time
  * bus_wait_time can potentially exceed time_taken with long event lists
  * 	because bus_wait_time is a sum while time_taken is a max
@@ -74,12 +75,13 @@ void Event::consolidate_metaevent(Event &list)
 		tmp = start_time - cur -> start_time + cur -> time_taken;
 		if(tmp > max)
 			max = tmp;
-		bus_wait_time += cur -> get_bus_wait_time();
+		for (uint i = 0; i < LATENCY_COMPONENTS; i++)
+			component_time[i] += cur -> component_time[i];
 	}
 	time_taken = max;
 
 	assert(time_taken >= 0);
-	assert(bus_wait_time >= 0);
+	assert(component_time[COMPONENT_BUS_WAIT] >= 0);
 	return;
 }
 
@@ -141,10 +143,37 @@ double Event::get_time_taken(void) const
 	return time_taken;
 }
 
+/* Start time of an operation an FTL issues on behalf of this event.  With
+ * DIE_QUEUEING it follows the work the event has already done, so that the
+ * die wait of the operation does not count that work a second time. */
+double Event::get_sub_event_time(void) const
+{
+	return (DIE_QUEUEING && !COUNTING_MODE) ? get_start_time() + get_time_taken() : get_start_time();
+}
+
 double Event::get_bus_wait_time(void) const
 {
-	assert(bus_wait_time >= 0.0);
-	return bus_wait_time;
+	return get_component_time(COMPONENT_BUS_WAIT);
+}
+
+double Event::get_die_wait_time(void) const
+{
+	return get_component_time(COMPONENT_DIE_WAIT);
+}
+
+/* The flash component is the time no other component accounts for */
+double Event::get_component_time(enum latency_component component) const
+{
+	if (component != COMPONENT_FLASH)
+	{
+		assert(component_time[component] >= 0.0);
+		return component_time[component];
+	}
+	double flash = time_taken;
+	for (uint i = 0; i < LATENCY_COMPONENTS; i++)
+		if (i != COMPONENT_FLASH)
+			flash -= component_time[i];
+	return flash > 0.0 ? flash : 0.0;
 }
 
 bool Event::get_noop(void) const
@@ -198,8 +227,15 @@ void Event::set_next(Event &next)
 double Event::incr_bus_wait_time(double time_incr)
 {
 	if(time_incr > 0.0)
-		bus_wait_time += time_incr;
-	return bus_wait_time;
+		component_time[COMPONENT_BUS_WAIT] += time_incr;
+	return component_time[COMPONENT_BUS_WAIT];
+}
+
+double Event::incr_die_wait_time(double time_incr)
+{
+	if(time_incr > 0.0)
+		component_time[COMPONENT_DIE_WAIT] += time_incr;
+	return component_time[COMPONENT_DIE_WAIT];
 }
 
 double Event::incr_time_taken(double time_incr)
@@ -209,6 +245,15 @@ double Event::incr_time_taken(double time_incr)
 	return time_taken;
 }
 
+/* Adds time spent for the given component, e.g. the whole time of a
+ * sub-event issued for garbage collection */
+double Event::incr_time_taken(double time_incr, enum latency_component component)
+{
+	if(time_incr > 0.0)
+		component_time[component] += time_incr;
+	return incr_time_taken(time_incr);
+}
+
 void Event::print(FILE *stream)
 {
 	if(type == READ)
@@ -224,7 +269,8 @@ void Event::print(FILE *stream)
 	address.print(stream);
 	if(type == MERGE)
 		merge_address.print(stream);
-	fprintf(stream, " Time[%f, %f) Bus_wait: %f\n", start_time, start_time + time_taken, bus_wait_time);
+	fprintf(stream, " Time[%f, %f) Bus_wait: %f Die_wait: %f Mapping: %f GC: %f\n", start_time, start_time + time_taken,
+			component_time[COMPONENT_BUS_WAIT], component_time[COMPONENT_DIE_WAIT], component_time[COMPONENT_MAPPING], component_time[COMPONENT_GC]);
 	return;
 }
 
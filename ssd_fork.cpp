@@ -0,0 +1,183 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_fork.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Fork_runner class
+ *
+ * Every experiment runs in its own child process.  A child starts with a
+ * copy-on-write image of the parent, so a drive that was warmed up before
+ * run() is shared until a child modifies it.  The child writes the number
+ * of values and then the values to its pipe and exits; the parent reads all
+ * pipes as data arrives, so children never block on a full pipe. */
+
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+Fork_runner::Fork_runner(uint num_children):
+	num_children(num_children)
+{
+	if (this->num_children == 0)
+		this->num_children = std::thread::hardware_concurrency();
+	if (this->num_children == 0)
+		this->num_children = 1;
+}
+
+static bool write_all(int fd, const void *data, size_t size)
+{
+	const char *bytes = (const char *) data;
+	while (size > 0)
+	{
+		ssize_t written = write(fd, bytes, size);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		bytes += written;
+		size -= written;
+	}
+	return true;
+}
+
+enum status Fork_runner::run(uint count, std::function<std::vector<double>(uint index)> experiment, std::vector<std::vector<double> > &results)
+{
+	struct Child
+	{
+		pid_t pid;
+		int fd;
+		uint index;
+		std::string data;
+	};
+
+	enum status result = SUCCESS;
+	std::vector<Child> active;
+	uint next = 0;
+
+	results.assign(count, std::vector<double>());
+
+	/* anything still buffered would be printed again by every child */
+	fflush(stdout);
+	fflush(stderr);
+
+	while (next < count || !active.empty())
+	{
+		while (next < count && active.size() < num_children)
+		{
+			int fds[2];
+			if (pipe(fds) != 0)
+			{
+				fprintf(stderr, "Fork_runner error: %s: pipe: %s\n", __func__, strerror(errno));
+				return FAILURE;
+			}
+
+			pid_t pid = fork();
+			if (pid < 0)
+			{
+				fprintf(stderr, "Fork_runner error: %s: fork: %s\n", __func__, strerror(errno));
+				close(fds[0]);
+				close(fds[1]);
+				return FAILURE;
+			}
+			if (pid == 0)
+			{
+				close(fds[0]);
+				int code = 0;
+				try
+				{
+					std::vector<double> values = experiment(next);
+					ulong size = values.size();
+					if (!write_all(fds[1], &size, sizeof(size)) || !write_all(fds[1], values.data(), size * sizeof(double)))
+						code = 1;
+				}
+				catch (...)
+				{
+					code = 1;
+				}
+				fflush(stdout);
+				fflush(stderr);
+				_exit(code);
+			}
+
+			close(fds[1]);
+			Child child;
+			child.pid = pid;
+			child.fd = fds[0];
+			child.index = next++;
+			active.push_back(child);
+		}
+
+		std::vector<struct pollfd> polls(active.size());
+		for (uint i = 0; i < active.size(); i++)
+		{
+			polls[i].fd = active[i].fd;
+			polls[i].events = POLLIN;
+			polls[i].revents = 0;
+		}
+		if (poll(&polls[0], polls.size(), -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Fork_runner error: %s: poll: %s\n", __func__, strerror(errno));
+			return FAILURE;
+		}
+
+		for (int i = active.size() - 1; i >= 0; i--)
+		{
+			if (polls[i].revents == 0)
+				continue;
+
+			Child &child = active[i];
+			char buffer[4096];
+			ssize_t length = read(child.fd, buffer, sizeof(buffer));
+			if (length < 0 && errno == EINTR)
+				continue;
+			if (length > 0)
+			{
+				child.data.append(buffer, length);
+				continue;
+			}
+
+			/* end of file: the child is done */
+			close(child.fd);
+			int child_status = 0;
+			while (waitpid(child.pid, &child_status, 0) < 0 && errno == EINTR)
+				;
+
+			ulong size = 0;
+			if (child.data.size() >= sizeof(size))
+				memcpy(&size, child.data.data(), sizeof(size));
+			if (!WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0 || child.data.size() != sizeof(size) + size * sizeof(double))
+			{
+				fprintf(stderr, "Fork_runner error: %s: experiment %u failed\n", __func__, child.index);
+				result = FAILURE;
+			}
+			else
+			{
+				results[child.index].resize(size);
+				memcpy(results[child.index].data(), child.data.data() + sizeof(size), size * sizeof(double));
+			}
+			active.erase(active.begin() + i);
+		}
+	}
+	return result;
+}
@@ -21,12 +21,14 @@
  * Implements parent interface for all FTL implementations to use.
  */
 
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "ssd.h"
 
 using namespace ssd;
 
 // Initialization of the block layer.
-Block_manager *Block_manager::inst = NULL;
 
 FtlParent::FtlParent(Controller &controller) : controller(controller)
 {
@@ -63,6 +65,109 @@ Block *FtlParent::get_block_pointer(const Address &address)
 	return controller.get_block_pointer(address);
 }
 
+/*
+ * Moves the data of one page to an empty page.
+ * Pages within the same plane are moved with a copy-back (MERGE event), which
+ * keeps the data inside the plane register and only sends a command across the
+ * bus. Pages on different planes are read into the controller and written out
+ * again. The time of the move is added to the event.
+ */
+enum status FtlParent::copy_page(Event &event, const Address &source, const Address &target, bool invalidate_source)
+{
+	if (source.compare(target) >= PLANE)
+	{
+		Event mergeEvent = Event(MERGE, event.get_logical_address(), 1, event.get_sub_event_time());
+		mergeEvent.set_address(source);
+		mergeEvent.set_merge_address(target);
+		if (invalidate_source)
+			mergeEvent.set_replace_address(source);
+
+		if (controller.issue(mergeEvent) == FAILURE)
+			return FAILURE;
+
+		if (Timeline::enabled())
+			Timeline::span(TRACK_GC, 0, 0, TIMELINE_RELOCATE, mergeEvent.get_start_time(), mergeEvent.get_time_taken());
+		event.incr_time_taken(mergeEvent.get_time_taken(), COMPONENT_GC);
+		controller.stats.numFTLCopyBack++;
+		controller.stats.numGCCopy++;
+		return SUCCESS;
+	}
+
+	Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_sub_event_time());
+	readEvent.set_address(source);
+	if (controller.issue(readEvent) == FAILURE)
+		return FAILURE;
+
+	Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_sub_event_time()+readEvent.get_time_taken());
+	writeEvent.set_address(target);
+	writeEvent.set_payload((char*)SimContext::current()->page_data + source.get_linear_address() * PAGE_SIZE);
+	if (invalidate_source)
+		writeEvent.set_replace_address(source);
+
+	if (controller.issue(writeEvent) == FAILURE)
+		return FAILURE;
+
+	if (Timeline::enabled())
+		Timeline::span(TRACK_GC, 0, 0, TIMELINE_RELOCATE, readEvent.get_start_time(), writeEvent.get_time_taken() + readEvent.get_time_taken());
+	event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken(), COMPONENT_GC);
+	controller.stats.numGCCopy++;
+	return SUCCESS;
+}
+
+/*
+ * Invalidates a physical page released by a trim, so GC sees the space as
+ * reclaimable. A block left without valid pages is erased right away and
+ * returned to the free pool. Returns true if the block was erased.
+ */
+bool FtlParent::trim_page(Event &event, const Address &address, block_type btype)
+{
+	Block *block = controller.get_block_pointer(address);
+	block->invalidate_page(address.page);
+
+	if (block->get_state() != INACTIVE)
+		return false;
+
+	// All pages invalid, force an erase. PTRIM style.
+	Address blockAddress = Address(block->get_physical_address(), BLOCK);
+	Block_manager::instance()->erase_and_invalidate(event, blockAddress, btype);
+	return true;
+}
+
+/*
+ * Returns the logical pages a precondition fills, in the order they are
+ * written: the first fill_fraction of the logical address space, shuffled for
+ * the random pattern. Fails if the drive has already been written to.
+ */
+enum status FtlParent::precondition_order(enum precondition_pattern pattern, double fill_fraction, ulong seed, std::vector<ulong> &order) const
+{
+	if (!Block_manager::instance()->is_unused())
+	{
+		fprintf(stderr, "FtlParent error: %s: only a fresh drive can be preconditioned\n", __func__);
+		return FAILURE;
+	}
+
+	ulong count = (ulong) (fill_fraction * NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE + 0.5);
+	order.resize(count);
+	for (ulong i = 0; i < count; i++)
+		order[i] = i;
+
+	if (pattern == PRECONDITION_RANDOM)
+	{
+		Random random(seed);
+		for (ulong i = count; i > 1; i--)
+			std::swap(order[i - 1], order[random.below(i)]);
+	}
+	return SUCCESS;
+}
+
+/* Marks a page written by a precondition, no time is simulated */
+void FtlParent::precondition_page(const Address &address)
+{
+	Event event = Event(WRITE, 0, 1, 0.0);
+	event.set_address(address);
+	if (controller.program(event) == FAILURE) { assert(false); }
+}
+
 void FtlParent::cleanup_block(Event &event, Block *block)
 {
 	assert(false);
@@ -73,3 +178,111 @@ void FtlParent::print_ftl_statistics()
 {
 	return;
 }
+
+/* Registers a mapping structure and returns its number for set_memory() */
+uint FtlParent::add_memory(const char *name, bool cache)
+{
+	Ftl_memory structure = {name, cache, 0, 0, 0};
+	memory.push_back(structure);
+	return memory.size() - 1;
+}
+
+/* Sets the modelled SRAM of a structure; the Stats totals are summed again,
+ * so they also hold after a snapshot was loaded */
+void FtlParent::set_memory(uint structure, ulong sram)
+{
+	assert(structure < memory.size());
+	memory[structure].sram = sram;
+	memory[structure].peak_sram = std::max(memory[structure].peak_sram, sram);
+
+	long translation = 0;
+	long cache = 0;
+	for (uint i = 0; i < memory.size(); i++)
+		(memory[i].cache ? cache : translation) += memory[i].sram;
+	Stats &stats = controller.stats;
+	stats.numMemoryTranslation = translation;
+	stats.numMemoryCache = cache;
+	stats.peakMemoryTranslation = std::max(stats.peakMemoryTranslation, translation);
+	stats.peakMemoryCache = std::max(stats.peakMemoryCache, cache);
+}
+
+void FtlParent::grow_memory(uint structure, long sram)
+{
+	assert(structure < memory.size() && (long) memory[structure].sram + sram >= 0);
+	set_memory(structure, memory[structure].sram + sram);
+}
+
+/* FTLs fill in the heap bytes of their structures, which are only counted
+ * when asked for */
+void FtlParent::get_host_memory(std::vector<Ftl_memory> &usage) const
+{
+	return;
+}
+
+void FtlParent::get_memory(std::vector<Ftl_memory> &usage) const
+{
+	usage = memory;
+	get_host_memory(usage);
+}
+
+/* Prints the mapping structures, the flash state every FTL shares and the
+ * resident set of the whole process */
+void FtlParent::print_memory(FILE *stream) const
+{
+	std::vector<Ftl_memory> usage;
+	get_memory(usage);
+
+	ulong pages = (ulong) SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * BLOCK_SIZE;
+	ulong blocks = (ulong) SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE;
+	ulong sram = 0, host = 0;
+
+	fprintf(stream, "%-24s %14s %14s %14s\n", "Mapping memory (bytes)", "SRAM", "peak SRAM", "host");
+	for (uint i = 0; i < usage.size(); i++)
+	{
+		fprintf(stream, "%-24s %14lu %14lu %14lu%s\n", usage[i].name, usage[i].sram, usage[i].peak_sram, usage[i].host, usage[i].cache ? "  (cache)" : "");
+		sram += usage[i].sram;
+		host += usage[i].host;
+	}
+	/* the structures peak at different times, so the summed peak is tracked
+	 * by set_memory() rather than added up here */
+	const Stats &stats = controller.stats;
+	ulong peak_sram = stats.peakMemoryTranslation + stats.peakMemoryCache;
+	fprintf(stream, "%-24s %14lu %14lu %14lu\n", "total", sram, peak_sram, host);
+	fprintf(stream, "%-24s %14s %14s %14lu\n", "flash state", "", "", pages * sizeof(Page) + blocks * sizeof(Block));
+
+	/* page contents are only resident once written or copied */
+	void *page_data = SimContext::current()->page_data;
+	long system_page = sysconf(_SC_PAGESIZE);
+	if (page_data != NULL && system_page > 0)
+	{
+		std::vector<unsigned char> resident_pages((pages * PAGE_SIZE + system_page - 1) / system_page);
+		if (mincore(page_data, pages * PAGE_SIZE, &resident_pages[0]) == 0)
+		{
+			ulong count = 0;
+			for (ulong i = 0; i < resident_pages.size(); i++)
+				count += resident_pages[i] & 1;
+			fprintf(stream, "%-24s %14s %14s %14lu\n", "page data (mapped)", "", "", count * system_page);
+		}
+	}
+
+	long resident = 0;
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (statm != NULL)
+	{
+		if (fscanf(statm, "%*s %ld", &resident) != 1)
+			resident = 0;
+		fclose(statm);
+	}
+	if (resident > 0)
+		fprintf(stream, "%-24s %14s %14s %14lu\n", "process resident", "", "", (ulong) resident * sysconf(_SC_PAGESIZE));
+}
+
+void FtlParent::save(Snapshot &snapshot) const
+{
+	return;
+}
+
+void FtlParent::load(Snapshot &snapshot)
+{
+	return;
+}
@@ -0,0 +1,174 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_histogram.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Latency_histogram class
+ *
+ * HDR-style log-linear histogram.  Values are counted in units of `unit`;
+ * values below 2^precision_bits units get one bucket each, and every
+ * further power of two is split into 2^(precision_bits - 1) linear
+ * sub-buckets, so a reported percentile is within 2^-(precision_bits - 1)
+ * of the recorded value.  The counts cover the whole 64-bit range in a
+ * fixed array (about 60 KB with the default 8 bits). */
+
+#include <math.h>
+#include <algorithm>
+#include "ssd.h"
+
+using namespace ssd;
+
+Latency_histogram::Latency_histogram(uint precision_bits, double unit):
+	precision_bits(precision_bits),
+	unit(unit),
+	count(0),
+	sum(0.0),
+	minimum(0.0),
+	maximum(0.0)
+{
+	if (this->precision_bits < 2)
+		this->precision_bits = 2;
+	if (this->precision_bits > 16)
+		this->precision_bits = 16;
+	if (this->unit <= 0.0)
+		this->unit = 1.0;
+	counts.assign((ulong) (66 - this->precision_bits) << (this->precision_bits - 1), 0);
+}
+
+uint Latency_histogram::index(uint64_t value) const
+{
+	int exponent = 0;
+	if (value > 0)
+		exponent = 63 - __builtin_clzll(value) - (int) precision_bits + 1;
+	if (exponent < 0)
+		exponent = 0;
+	return ((uint) exponent << (precision_bits - 1)) + (uint) (value >> exponent);
+}
+
+/* Largest value counted in a bucket */
+uint64_t Latency_histogram::highest_equivalent(uint index) const
+{
+	uint exponent = index >> (precision_bits - 1);
+	if (exponent > 0)
+		exponent--;
+	uint64_t mantissa = index - ((uint64_t) exponent << (precision_bits - 1));
+	return ((mantissa + 1) << exponent) - 1;
+}
+
+void Latency_histogram::add(double value)
+{
+	if (value < 0.0)
+		value = 0.0;
+	double units = value / unit + 0.5;
+	uint64_t scaled = units >= 1.8e19 ? UINT64_MAX : (uint64_t) units;
+	counts[index(scaled)]++;
+
+	if (count == 0 || value < minimum)
+		minimum = value;
+	if (count == 0 || value > maximum)
+		maximum = value;
+	count++;
+	sum += value;
+}
+
+/* Adds the counts of another histogram with the same precision and unit,
+ * e.g. one filled by another thread */
+enum status Latency_histogram::merge(const Latency_histogram &other)
+{
+	if (other.precision_bits != precision_bits || other.unit != unit)
+	{
+		fprintf(stderr, "Latency_histogram error: %s: histograms differ in precision or unit\n", __func__);
+		return FAILURE;
+	}
+	if (other.count == 0)
+		return SUCCESS;
+
+	for (ulong i = 0; i < counts.size(); i++)
+		counts[i] += other.counts[i];
+	if (count == 0 || other.minimum < minimum)
+		minimum = other.minimum;
+	if (count == 0 || other.maximum > maximum)
+		maximum = other.maximum;
+	count += other.count;
+	sum += other.sum;
+	return SUCCESS;
+}
+
+void Latency_histogram::reset(void)
+{
+	std::fill(counts.begin(), counts.end(), 0);
+	count = 0;
+	sum = 0.0;
+	minimum = 0.0;
+	maximum = 0.0;
+}
+
+ulong Latency_histogram::size(void) const
+{
+	return count;
+}
+
+double Latency_histogram::min(void) const
+{
+	return minimum;
+}
+
+double Latency_histogram::max(void) const
+{
+	return maximum;
+}
+
+double Latency_histogram::mean(void) const
+{
+	return count > 0 ? sum / count : 0.0;
+}
+
+/* Smallest value that percent of the recorded values do not exceed, within
+ * the precision of the buckets */
+double Latency_histogram::percentile(double percent) const
+{
+	if (count == 0)
+		return 0.0;
+	if (percent >= 100.0)
+		return maximum;
+
+	ulong rank = (ulong) ceil(percent / 100.0 * count);
+	if (rank < 1)
+		rank = 1;
+	ulong seen = 0;
+	for (uint i = 0; i < counts.size(); i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+		{
+			double value = highest_equivalent(i) * unit;
+			return value < maximum ? (value > minimum ? value : minimum) : maximum;
+		}
+	}
+	return maximum;
+}
+
+void Latency_histogram::print_header(FILE *stream)
+{
+	fprintf(stream, "%-16s %10s %12s %12s %12s %12s %12s %12s\n", "", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+}
+
+void Latency_histogram::print(FILE *stream, const char *name) const
+{
+	fprintf(stream, "%-16s %10lu %12.2f %12.2f %12.2f %12.2f %12.2f %12.2f\n", name, count, mean(),
+			percentile(50.0), percentile(90.0), percentile(99.0), percentile(99.9), maximum);
+}
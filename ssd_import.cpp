@@ -0,0 +1,286 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_import.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Trace_importer class
+ *
+ * The parser thread owns the file; the replaying thread only pops from the
+ * ring.  Fields are split in place and converted with strtoull/strtold
+ * instead of sscanf.  Timestamps are kept as long double until the first one
+ * is subtracted, so MSR filetimes (~1.3e17 ticks) keep their resolution. */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+static const uint SECTOR_SIZE = 512;
+static const uint MAX_FIELDS = 12;
+
+Trace_importer::Trace_importer(size_t capacity):
+	file(NULL),
+	format(TRACE_UFLIP),
+	mode(TRACE_WRAP),
+	trace_pages(0),
+	device_pages(0),
+	page_size(0),
+	time_scale(1e6),
+	have_first(false),
+	first_time(0.0),
+	ring(capacity),
+	done(true),
+	stopping(false),
+	skipped(0)
+{}
+
+Trace_importer::~Trace_importer(void)
+{
+	close();
+}
+
+enum status Trace_importer::parse_format(const char *name, enum trace_format &format)
+{
+	static const struct { const char *name; enum trace_format format; } formats[] = {
+		{"uflip", TRACE_UFLIP}, {"msr", TRACE_MSR}, {"snia", TRACE_SNIA}, {"blkparse", TRACE_BLKPARSE}
+	};
+	for (uint i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+		if (strcmp(name, formats[i].name) == 0)
+		{
+			format = formats[i].format;
+			return SUCCESS;
+		}
+	fprintf(stderr, "Trace_importer error: %s: unknown trace format %s (uflip, msr, snia or blkparse)\n", __func__, name);
+	return FAILURE;
+}
+
+/* trace_pages is the size of the traced device in pages, needed to scale */
+enum status Trace_importer::open(const char *filename, enum trace_format format, enum trace_address_mode mode, ulong trace_pages, double time_scale)
+{
+	close();
+	if (mode == TRACE_SCALE && trace_pages == 0)
+	{
+		fprintf(stderr, "Trace_importer error: %s: scaling needs the size of the traced device\n", __func__);
+		return FAILURE;
+	}
+	if ((file = fopen(filename, "r")) == NULL)
+	{
+		fprintf(stderr, "Trace_importer error: %s: cannot open %s: %s\n", __func__, filename, strerror(errno));
+		return FAILURE;
+	}
+	setvbuf(file, NULL, _IOFBF, 1 << 20);
+	posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	/* the parser thread does not see the caller's context */
+	this->format = format;
+	this->mode = mode;
+	this->trace_pages = trace_pages;
+	this->time_scale = time_scale;
+	device_pages = (ulong) NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE;
+	page_size = PAGE_SIZE;
+	have_first = false;
+	skipped = 0;
+	stopping = false;
+	done = false;
+	parser = std::thread(&Trace_importer::parse, this);
+	return SUCCESS;
+}
+
+/* Waits for the next request; false once the whole trace was returned */
+bool Trace_importer::next(Trace_request &request)
+{
+	while (!ring.pop(request))
+	{
+		if (done.load(std::memory_order_acquire))
+			return ring.pop(request);
+		std::this_thread::yield();
+	}
+	return true;
+}
+
+void Trace_importer::close(void)
+{
+	stopping = true;
+	if (parser.joinable())
+		parser.join();
+	if (file != NULL)
+		fclose(file);
+	file = NULL;
+
+	Trace_request request;
+	while (ring.pop(request))
+		;
+	done = true;
+}
+
+ulong Trace_importer::get_skipped(void) const
+{
+	return skipped;
+}
+
+void Trace_importer::parse(void)
+{
+	char *line = NULL;
+	size_t capacity = 0;
+	while (!stopping && getline(&line, &capacity, file) != -1)
+	{
+		Trace_request request;
+		if (!parse_line(line, request))
+		{
+			skipped++;
+			continue;
+		}
+		while (!ring.push(request))
+		{
+			if (stopping)
+				break;
+			std::this_thread::yield();
+		}
+	}
+	free(line);
+	done.store(true, std::memory_order_release);
+}
+
+/* Splits line in place at any of separators, skipping empty fields */
+static uint split(char *line, const char *separators, char **fields)
+{
+	uint count = 0;
+	char *save = NULL;
+	for (char *field = strtok_r(line, separators, &save); field != NULL && count < MAX_FIELDS; field = strtok_r(NULL, separators, &save))
+		fields[count++] = field;
+	return count;
+}
+
+static bool to_ulong(const char *field, ulong &value)
+{
+	char *end;
+	errno = 0;
+	value = strtoull(field, &end, 10);
+	return end != field && errno == 0;
+}
+
+static bool to_time(const char *field, long double &value)
+{
+	char *end;
+	value = strtold(field, &end);
+	return end != field;
+}
+
+bool Trace_importer::parse_line(char *line, Trace_request &request)
+{
+	char *fields[MAX_FIELDS];
+	long double seconds;
+	ulong offset, bytes;
+
+	switch (format)
+	{
+	case TRACE_UFLIP:
+		/* pattern; type; page; query; pages; time */
+		if (split(line, "; \t\r\n", fields) < 6 || !to_ulong(fields[2], offset) || !to_ulong(fields[4], bytes) || !to_time(fields[5], seconds))
+			return false;
+		if (fields[1][0] == 'R')
+			request.type = READ;
+		else if (fields[1][0] == 'W')
+			request.type = WRITE;
+		else
+			return false;
+		offset *= page_size;
+		bytes *= page_size;
+		break;
+
+	case TRACE_MSR:
+		/* timestamp,host,disk,type,offset,size,response */
+		if (split(line, ",\r\n", fields) < 6 || !to_time(fields[0], seconds) || !to_ulong(fields[4], offset) || !to_ulong(fields[5], bytes))
+			return false;
+		seconds *= 1e-7L;
+		if (strcasecmp(fields[3], "Read") == 0)
+			request.type = READ;
+		else if (strcasecmp(fields[3], "Write") == 0)
+			request.type = WRITE;
+		else
+			return false;
+		break;
+
+	case TRACE_SNIA:
+		/* asu,lba,size,opcode,timestamp */
+		if (split(line, ", \t\r\n", fields) < 5 || !to_ulong(fields[1], offset) || !to_ulong(fields[2], bytes) || !to_time(fields[4], seconds))
+			return false;
+		offset *= SECTOR_SIZE;
+		if (fields[3][0] == 'r' || fields[3][0] == 'R')
+			request.type = READ;
+		else if (fields[3][0] == 'w' || fields[3][0] == 'W')
+			request.type = WRITE;
+		else
+			return false;
+		break;
+
+	case TRACE_BLKPARSE:
+		/* dev cpu sequence time pid action rwbs sector + sectors [process] */
+		if (split(line, " \t\r\n", fields) < 10 || strcmp(fields[5], "D") != 0 || strcmp(fields[8], "+") != 0
+				|| !to_time(fields[3], seconds) || !to_ulong(fields[7], offset) || !to_ulong(fields[9], bytes))
+			return false;
+		offset *= SECTOR_SIZE;
+		bytes *= SECTOR_SIZE;
+		if (strchr(fields[6], 'D') != NULL)
+			return false;
+		else if (strchr(fields[6], 'W') != NULL)
+			request.type = WRITE;
+		else if (strchr(fields[6], 'R') != NULL)
+			request.type = READ;
+		else
+			return false;
+		break;
+
+	default:
+		return false;
+	}
+
+	if (bytes == 0)
+		return false;
+	if (!fit(offset / page_size, (offset + bytes - 1) / page_size - offset / page_size + 1, request))
+		return false;
+
+	if (!have_first)
+	{
+		first_time = seconds;
+		have_first = true;
+	}
+	request.time = seconds > first_time ? (double) ((seconds - first_time) * time_scale) : 0.0;
+	return true;
+}
+
+/* Places pages starting at page on the drive; requests keep their size and
+ * are moved back where they would run past the last page */
+bool Trace_importer::fit(ulong page, ulong pages, Trace_request &request) const
+{
+	if (device_pages == 0)
+		return false;
+	if (mode == TRACE_WRAP)
+		page %= device_pages;
+	else
+		page = (ulong) ((long double) page * device_pages / trace_pages);
+
+	if (pages > device_pages)
+		pages = device_pages;
+	if (page > device_pages - pages)
+		page = device_pages - pages;
+	request.logical_address = page;
+	request.size = pages;
+	return true;
+}
@@ -209,3 +209,21 @@ Block *Package::get_block_pointer(const Address & address)
 	assert(address.valid >= DIE);
 	return data[address.die].get_block_pointer(address);
 }
+
+void Package::save(Snapshot &snapshot) const
+{
+	snapshot.put(least_worn);
+	snapshot.put(erases_remaining);
+	snapshot.put(last_erase_time);
+	for (uint i = 0; i < size; i++)
+		data[i].save(snapshot);
+}
+
+void Package::load(Snapshot &snapshot)
+{
+	snapshot.get(least_worn);
+	snapshot.get(erases_remaining);
+	snapshot.get(last_erase_time);
+	for (uint i = 0; i < size; i++)
+		data[i].load(snapshot);
+}
@@ -30,14 +30,6 @@
 
 #include "ssd.h"
 
-namespace ssd {
-	/*
-	 * Buffer used for accessing data pages.
-	 */
-	void *global_buffer;
-
-}
-
 using namespace ssd;
 
 Page::Page(const Block &parent, double read_delay, double write_delay):
@@ -70,7 +62,7 @@ enum status Page::_read(Event &event)
 	event.incr_time_taken(read_delay);
 
 	if (!event.get_noop() && PAGE_ENABLE_DATA)
-		global_buffer = (char*)page_data + event.get_address().get_linear_address() * PAGE_SIZE;
+		SimContext::current()->global_buffer = (char*)SimContext::current()->page_data + event.get_address().get_linear_address() * PAGE_SIZE;
 
 	return SUCCESS;
 }
@@ -83,7 +75,7 @@ enum status Page::_write(Event &event)
 
 	if (PAGE_ENABLE_DATA && event.get_payload() != NULL && event.get_noop() == false)
 	{
-		void *data = (char*)page_data + event.get_address().get_linear_address() * PAGE_SIZE;
+		void *data = (char*)SimContext::current()->page_data + event.get_address().get_linear_address() * PAGE_SIZE;
 		memcpy (data, event.get_payload(), PAGE_SIZE);
 	}
 
@@ -168,7 +168,9 @@ enum status Plane::erase(Event &event)
  * 	address.block and address_merge.block must be valid
  * 	move event::address valid pages to event::address_merge empty pages
  * creates own events for resulting read/write operations
- * supports blocks that have different sizes */
+ * supports blocks that have different sizes
+ * if both addresses are valid to the page, only that page is copied back
+ * 	through the plane register (see copy_back below) */
 enum status Plane::_merge(Event &event)
 {
 	assert(event.get_address().block < size && event.get_address().valid > PLANE);
@@ -182,8 +184,12 @@ enum status Plane::_merge(Event &event)
 	/* get and check address validity and size of blocks involved in the merge */
 	const Address &address = event.get_address();
 	const Address &merge_address = event.get_merge_address();
-	assert(address.compare(merge_address) >= BLOCK);
+	assert(address.compare(merge_address) >= PLANE);
 	assert(address.block < size && merge_address.block < size);
+
+	if(address.valid == PAGE && merge_address.valid == PAGE)
+		return copy_back(event);
+
 	uint block_size = data[address.block].get_size();
 	uint merge_block_size = data[merge_address.block].get_size();
 
@@ -213,8 +219,6 @@ enum status Plane::_merge(Event &event)
 	write.valid = PAGE;
 	Event read_event(READ, 0, 1, event.get_start_time());
 	Event write_event(WRITE, 0, 1, event.get_start_time());
-	read_event.set_address(read);
-	write_event.set_address(write);
 	
 	/* calculate merge delay and add to event time
 	 * use i as an error counter */
@@ -224,6 +228,8 @@ enum status Plane::_merge(Event &event)
 		if(data[read.block].get_state(read.page) == VALID)
 		{
 			/* read from page and set status to invalid */
+			read.set_linear_address(address.get_linear_address() - address.page + read.page, PAGE);
+			read_event.set_address(read);
 			if(data[read.block].read(read_event) == 0)
 			{
 				fprintf(stderr, "Plane error: %s: Read for merge block %d into %d failed\n", __func__, read.block, write.block);
@@ -242,7 +248,10 @@ enum status Plane::_merge(Event &event)
 				if(data[write.block].get_state(write.page) == EMPTY)
 				{
 					/* write to page (page::_write() sets status to valid) */
-					if(data[merge_address.block].write(write_event) == 0)
+					write.set_linear_address(merge_address.get_linear_address() - merge_address.page + write.page, PAGE);
+					write_event.set_address(write);
+					write_event.set_payload(PAGE_ENABLE_DATA ? (char*)SimContext::current()->page_data + read.get_linear_address() * PAGE_SIZE : NULL);
+					if(this -> write(write_event) == 0)
 					{
 						fprintf(stderr, "Plane error: %s: Write for merge block %d into %d failed\n", __func__, address.block, merge_address.block);
 						i++;
@@ -273,6 +282,38 @@ enum status Plane::_merge(Event &event)
 	}
 }
 
+/* copy back (plane-internal page move)
+ * 	the page at event::address is read into the plane register and programmed
+ * 	to the empty page at event::merge_address without crossing the bus
+ * the source page is not invalidated here, the controller does that through
+ * 	the replace address like for a regular write */
+enum status Plane::copy_back(Event &event)
+{
+	const Address &address = event.get_address();
+	const Address &merge_address = event.get_merge_address();
+
+	if(data[merge_address.block].get_state(merge_address.page) != EMPTY)
+	{
+		fprintf(stderr, "Plane error: %s: Copy back target page %d in block %d is not empty\n", __func__, merge_address.page, merge_address.block);
+		return FAILURE;
+	}
+
+	Event read_event(READ, event.get_logical_address(), 1, event.get_start_time());
+	Event write_event(WRITE, event.get_logical_address(), 1, event.get_start_time());
+	read_event.set_address(address);
+	write_event.set_address(merge_address);
+	write_event.set_payload(PAGE_ENABLE_DATA ? (char*)SimContext::current()->page_data + address.get_linear_address() * PAGE_SIZE : NULL);
+
+	if(data[address.block].read(read_event) == FAILURE || write(write_event) == FAILURE)
+	{
+		fprintf(stderr, "Plane error: %s: Copy back of block %d into %d failed\n", __func__, address.block, merge_address.block);
+		return FAILURE;
+	}
+
+	event.incr_time_taken(read_event.get_time_taken() + reg_write_delay + reg_read_delay + write_event.get_time_taken());
+	return SUCCESS;
+}
+
 ssd::uint Plane::get_size(void) const
 {
 	return size;
@@ -403,3 +444,25 @@ Block *Plane::get_block_pointer(const Address & address)
 	assert(address.valid >= PLANE);
 	return data[address.block].get_pointer();
 }
+
+void Plane::save(Snapshot &snapshot) const
+{
+	snapshot.put(least_worn);
+	snapshot.put(erases_remaining);
+	snapshot.put(last_erase_time);
+	snapshot.put(next_page);
+	snapshot.put(free_blocks);
+	for (uint i = 0; i < size; i++)
+		data[i].save(snapshot);
+}
+
+void Plane::load(Snapshot &snapshot)
+{
+	snapshot.get(least_worn);
+	snapshot.get(erases_remaining);
+	snapshot.get(last_erase_time);
+	snapshot.get(next_page);
+	snapshot.get(free_blocks);
+	for (uint i = 0; i < size; i++)
+		data[i].load(snapshot);
+}
@@ -0,0 +1,163 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_pool.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Thread_pool class
+ *
+ * Work-stealing pool used to run independent simulator instances (sweep
+ * points, replications) on all cores.  Every Ssd owns its SimContext, so
+ * tasks only have to create and drive their own Ssd. */
+
+#include <assert.h>
+#include <stdio.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+/* Pool and deque of the calling worker thread, used to keep tasks submitted
+ * from a task on the submitting worker */
+static thread_local Thread_pool *worker_pool = NULL;
+static thread_local uint worker_id = 0;
+
+Thread_pool::Thread_pool(uint num_threads):
+	queued(0),
+	pending(0),
+	steals(0),
+	next_queue(0),
+	stopping(false)
+{
+	if (num_threads == 0)
+		num_threads = std::thread::hardware_concurrency();
+	if (num_threads == 0)
+		num_threads = 1;
+
+	for (uint i = 0; i < num_threads; i++)
+		queues.push_back(new Task_queue());
+	for (uint i = 0; i < num_threads; i++)
+		workers.push_back(std::thread(&Thread_pool::work, this, i));
+}
+
+Thread_pool::~Thread_pool(void)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	work_available.notify_all();
+	for (uint i = 0; i < workers.size(); i++)
+		workers[i].join();
+	for (uint i = 0; i < queues.size(); i++)
+		delete queues[i];
+}
+
+void Thread_pool::submit(std::function<void()> task)
+{
+	uint id;
+	if (worker_pool == this)
+		id = worker_id;
+	else
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		id = next_queue++ % queues.size();
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(queues[id]->lock);
+		queues[id]->tasks.push_back(task);
+	}
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		queued++;
+		pending++;
+	}
+	work_available.notify_one();
+}
+
+/* Blocks until every submitted task has finished.  Must not be called from
+ * a task of the same pool. */
+void Thread_pool::wait(void)
+{
+	assert(worker_pool != this);
+	std::unique_lock<std::mutex> guard(lock);
+	all_done.wait(guard, [this]{ return pending == 0; });
+}
+
+uint Thread_pool::size(void) const
+{
+	return workers.size();
+}
+
+ulong Thread_pool::get_num_steals(void) const
+{
+	return steals;
+}
+
+void Thread_pool::work(uint id)
+{
+	worker_pool = this;
+	worker_id = id;
+
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			work_available.wait(guard, [this]{ return stopping || queued > 0; });
+			if (queued == 0)
+				return;
+			/* reserve a task; it is in one of the deques */
+			queued--;
+		}
+
+		while (!take(id, task))
+			std::this_thread::yield();
+		task();
+
+		std::lock_guard<std::mutex> guard(lock);
+		if (--pending == 0)
+			all_done.notify_all();
+	}
+}
+
+/* Own deque from the back (most recently submitted), others from the front */
+bool Thread_pool::take(uint id, std::function<void()> &task)
+{
+	{
+		std::lock_guard<std::mutex> guard(queues[id]->lock);
+		if (!queues[id]->tasks.empty())
+		{
+			task = queues[id]->tasks.back();
+			queues[id]->tasks.pop_back();
+			return true;
+		}
+	}
+
+	for (uint i = 1; i < queues.size(); i++)
+	{
+		Task_queue *victim = queues[(id + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(victim->lock);
+		if (!victim->tasks.empty())
+		{
+			task = victim->tasks.front();
+			victim->tasks.pop_front();
+			steals++;
+			return true;
+		}
+	}
+	return false;
+}
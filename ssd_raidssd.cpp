@@ -31,6 +31,8 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <chrono>
+#include <algorithm>
 
 using namespace ssd;
 
@@ -38,7 +40,15 @@ using namespace ssd;
  * occurs in the order of declaration in the class definition and not in the
  * order listed here */
 RaidSsd::RaidSsd(uint ssd_size):
-	size(ssd_size)
+	size(ssd_size),
+	last_ssd(0),
+	pool(NULL),
+	member_requests(RAID_NUMBER_OF_PHYSICAL_SSDS),
+	member_timings(RAID_NUMBER_OF_PHYSICAL_SSDS),
+	member_ops(RAID_NUMBER_OF_PHYSICAL_SSDS, 0),
+	member_busy(RAID_NUMBER_OF_PHYSICAL_SSDS, 0.0),
+	member_wall(RAID_NUMBER_OF_PHYSICAL_SSDS, 0.0),
+	dispatches(0)
 {
 /*
  * Idea
@@ -51,13 +61,28 @@ RaidSsd::RaidSsd(uint ssd_size):
  * 2. Address splitting.
  * 3. Complete control
  */
+	/* each member SSD owns its own context, and thereby its own
+	 * Block_manager and page data */
 	Ssds = new Ssd[RAID_NUMBER_OF_PHYSICAL_SSDS];
 
+	/* members share no state, so each can be driven by its own thread */
+	uint threads = RAID_THREADS;
+	if (threads == 0)
+	{
+		threads = std::thread::hardware_concurrency();
+		if (threads > RAID_NUMBER_OF_PHYSICAL_SSDS)
+			threads = RAID_NUMBER_OF_PHYSICAL_SSDS;
+	}
+	if (threads > 1)
+		pool = new Thread_pool(threads);
+
 	return;
 }
 
 RaidSsd::~RaidSsd(void)
 {
+	delete pool;
+	delete[] Ssds;
 	return;
 }
 
@@ -74,49 +99,142 @@ double RaidSsd::event_arrive(enum event_type type, ulong logical_address, uint s
  * 	request.  Remember to use the same time units as in the config file. */
 double RaidSsd::event_arrive(enum event_type type, ulong logical_address, uint size, double start_time, void *buffer)
 {
-	if (type == WRITE)
-		printf("Writing to logical address: %lu\n", logical_address);
-	else if (type == READ)
-		printf("Read from logical address: %lu\n", logical_address);
+	std::vector<Raid_request> batch(1);
+	batch[0].type = type;
+	batch[0].logical_address = logical_address;
+	batch[0].size = size;
+	batch[0].start_time = start_time;
+	batch[0].buffer = buffer;
+	event_arrive(batch);
+	return batch[0].time_taken;
+}
 
-	if (PARALLELISM_MODE == 1) // Striping
-	{
-		double timings[RAID_NUMBER_OF_PHYSICAL_SSDS];
-		for (int i=0;i<RAID_NUMBER_OF_PHYSICAL_SSDS;i++)
-		{
-			if (buffer == NULL)
-			{
-				printf("Executing stage: %i\n", i);
-				timings[i] = Ssds[i].event_arrive(type, logical_address, size, start_time, NULL);
-			}
+/* Serves a batch of host requests with one dispatch to the members.
+ * Each member processes its share of the batch in order on its own thread;
+ * a striped request takes as long as its slowest member. */
+void RaidSsd::event_arrive(std::vector<Raid_request> &batch)
+{
+	const uint members = RAID_NUMBER_OF_PHYSICAL_SSDS;
+	/* striped requests hand each member its own page of the buffer */
+	const uint buffer_stride = PARALLELISM_MODE == 1 ? PAGE_SIZE : 0;
 
-			else
-				timings[i] = Ssds[i].event_arrive(type, logical_address, size, start_time, (char*)buffer +(i*PAGE_SIZE));
+	for (uint m = 0; m < members; m++)
+		member_requests[m].clear();
 
+	for (uint i = 0; i < batch.size(); i++)
+	{
+		batch[i].time_taken = 0;
+		if (PARALLELISM_MODE == 1) // Striping
+		{
+			for (uint m = 0; m < members; m++)
+				member_requests[m].push_back(i);
+			last_ssd = 0;
 		}
-
-		for (int i=0;i<RAID_NUMBER_OF_PHYSICAL_SSDS-1;i++)
+		else if (PARALLELISM_MODE == 2) // Splitted address space
 		{
-			if (timings[i] != timings[i+1])
-				fprintf(stderr, "ERROR: Timings are not the same. %d %d\n", timings[i], timings[i+1]);
+			last_ssd = batch[i].logical_address % members;
+			member_requests[last_ssd].push_back(i);
 		}
-
-		return timings[0];
 	}
-	else if (PARALLELISM_MODE == 2) // Splitted address space
+
+	for (uint m = 0; m < members; m++)
 	{
-		return Ssds[logical_address%RAID_NUMBER_OF_PHYSICAL_SSDS].event_arrive(type, logical_address, size, start_time, (char*)buffer);
+		if (member_requests[m].empty())
+			continue;
+		if (pool == NULL)
+			run_member(m, batch, buffer_stride);
+		else
+			pool->submit([this, m, &batch, buffer_stride]{ run_member(m, batch, buffer_stride); });
 	}
+	if (pool != NULL)
+		pool->wait();
+	dispatches++;
 
-	return 0;
+	for (uint m = 0; m < members; m++)
+		for (uint k = 0; k < member_requests[m].size(); k++)
+		{
+			Raid_request &request = batch[member_requests[m][k]];
+			if (member_timings[m][k] > request.time_taken)
+				request.time_taken = member_timings[m][k];
+		}
+}
+
+/* Runs the requests of one member in batch order.  Touches only that member
+ * and does not read the configuration, since workers run without a context. */
+void RaidSsd::run_member(uint member, std::vector<Raid_request> &batch, uint buffer_stride)
+{
+	std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+	std::vector<uint> &requests = member_requests[member];
+	std::vector<double> &timings = member_timings[member];
+	timings.resize(requests.size());
+
+	for (uint k = 0; k < requests.size(); k++)
+	{
+		const Raid_request &request = batch[requests[k]];
+		void *buffer = request.buffer;
+		if (buffer != NULL)
+			buffer = (char*)buffer + member * buffer_stride;
+		timings[k] = Ssds[member].event_arrive(request.type, request.logical_address, request.size, request.start_time, buffer);
+		member_busy[member] += timings[k];
+	}
+	member_ops[member] += requests.size();
+	member_wall[member] += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
 }
 
 /*
- * Returns a pointer to the global buffer of the Ssd.
+ * Returns a pointer to the result buffer of the Ssd that served the last
+ * request (the first one when striping).
  * It is up to the user to not read out of bound and only
  * read the intended size. i.e. the page size.
  */
 void *RaidSsd::get_result_buffer()
 {
-	return global_buffer;
+	return Ssds[last_ssd].get_result_buffer();
+}
+
+void RaidSsd::print_statistics()
+{
+	for (uint m = 0; m < RAID_NUMBER_OF_PHYSICAL_SSDS; m++)
+	{
+		printf("Member SSD %u\n", m);
+		Ssds[m].print_statistics();
+	}
+	print_imbalance();
+}
+
+/* Load per member and the imbalance (max / mean) of each measure */
+void RaidSsd::print_imbalance(FILE *stream)
+{
+	const uint members = RAID_NUMBER_OF_PHYSICAL_SSDS;
+	double max_ops = 0, max_busy = 0, max_wall = 0;
+	double sum_ops = 0, sum_busy = 0, sum_wall = 0;
+
+	fprintf(stream, "RAID members: %u dispatches: %lu threads: %u\n", members, dispatches, pool == NULL ? 1 : pool->size());
+	for (uint m = 0; m < members; m++)
+	{
+		fprintf(stream, "  member %u: ops %lu busy %f wall %f s\n", m, member_ops[m], member_busy[m], member_wall[m]);
+		max_ops = std::max(max_ops, (double) member_ops[m]);
+		max_busy = std::max(max_busy, member_busy[m]);
+		max_wall = std::max(max_wall, member_wall[m]);
+		sum_ops += member_ops[m];
+		sum_busy += member_busy[m];
+		sum_wall += member_wall[m];
+	}
+	fprintf(stream, "Imbalance (max/mean): ops %f busy %f wall %f\n",
+			sum_ops > 0 ? max_ops * members / sum_ops : 0.0,
+			sum_busy > 0 ? max_busy * members / sum_busy : 0.0,
+			sum_wall > 0 ? max_wall * members / sum_wall : 0.0);
+}
+
+void RaidSsd::reset_statistics()
+{
+	for (uint m = 0; m < RAID_NUMBER_OF_PHYSICAL_SSDS; m++)
+	{
+		Ssds[m].reset_statistics();
+		member_ops[m] = 0;
+		member_busy[m] = 0.0;
+		member_wall[m] = 0.0;
+	}
+	dispatches = 0;
 }
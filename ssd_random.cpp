@@ -0,0 +1,83 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_random.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Random class
+ *
+ * xoshiro256** by Blackman and Vigna, seeded through splitmix64 so that
+ * consecutive seeds give unrelated streams. */
+
+#include "ssd.h"
+
+using namespace ssd;
+
+static inline uint64_t rotl(const uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+Random::Random(uint64_t seed)
+{
+	this->seed(seed);
+}
+
+void Random::seed(uint64_t seed)
+{
+	for (uint i = 0; i < 4; i++)
+	{
+		uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		state[i] = z ^ (z >> 31);
+	}
+}
+
+uint64_t Random::next(void)
+{
+	const uint64_t result = rotl(state[1] * 5, 7) * 9;
+	const uint64_t t = state[1] << 17;
+
+	state[2] ^= state[0];
+	state[3] ^= state[1];
+	state[1] ^= state[2];
+	state[0] ^= state[3];
+	state[2] ^= t;
+	state[3] = rotl(state[3], 45);
+
+	return result;
+}
+
+/* uniform in [0, 1) with 53 bits of precision */
+double Random::uniform(void)
+{
+	return (next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* uniform in [0, n) without modulo bias */
+uint64_t Random::below(uint64_t n)
+{
+	if (n == 0)
+		return 0;
+	const uint64_t threshold = -n % n;
+	for (;;)
+	{
+		uint64_t r = next();
+		if (r >= threshold)
+			return r % n;
+	}
+}
@@ -0,0 +1,102 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_replication.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Replication class
+ *
+ * Runs an experiment with several seeds in parallel and summarizes every
+ * metric it reports with a mean and 95% confidence interval. */
+
+#include <assert.h>
+#include <stdio.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+Replication::Replication(const std::vector<std::string> &metrics):
+	names(metrics),
+	samples(metrics.size()),
+	runs(0)
+{}
+
+/* Workers pick runs in increasing order, so the early stop rarely wastes
+ * more than one run per thread */
+void Replication::run(std::function<std::vector<double>(uint run)> experiment, uint max_runs, uint min_runs, double ci_target, uint num_threads)
+{
+	std::vector<std::vector<double> > results(max_runs);
+	std::vector<char> finished(max_runs, 0);
+	std::mutex lock;
+	std::atomic<uint> next_run(0);
+	std::atomic<bool> stop(false);
+
+	Thread_pool pool(num_threads);
+	std::function<void()> task = [&]{
+		uint run = next_run++;
+		if (run >= max_runs || stop)
+			return;
+
+		std::vector<double> values = experiment(run);
+		assert(values.size() == names.size());
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			results[run] = values;
+			finished[run] = 1;
+			while (runs < max_runs && finished[runs] && !stop)
+			{
+				for (uint i = 0; i < names.size(); i++)
+					samples[i].add(results[runs][i]);
+				runs++;
+				if (runs >= min_runs && ci_target > 0.0 && converged(ci_target))
+					stop = true;
+			}
+		}
+		pool.submit(task);
+	};
+
+	for (uint i = 0; i < pool.size(); i++)
+		pool.submit(task);
+	pool.wait();
+}
+
+bool Replication::converged(double ci_target) const
+{
+	for (uint i = 0; i < samples.size(); i++)
+		if (samples[i].ci_relative() > ci_target)
+			return false;
+	return true;
+}
+
+const Sample_stats &Replication::get_metric(uint metric) const
+{
+	return samples[metric];
+}
+
+uint Replication::size(void) const
+{
+	return runs;
+}
+
+void Replication::print(FILE *stream) const
+{
+	fprintf(stream, "Replications: %u (mean +- 95%% CI half width)\n", runs);
+	for (uint i = 0; i < names.size(); i++)
+		fprintf(stream, "%-22s: %.4f +- %.4f (%.2f%%)  stddev %.4f\n", names[i].c_str(),
+				samples[i].mean(), samples[i].ci_half_width(),
+				100.0 * samples[i].ci_relative(), samples[i].stddev());
+}
@@ -0,0 +1,206 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_sampler.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Sampler class
+ *
+ * Each period of requests is laid out as
+ *   | fast-forward (counting mode) | warm-up (timed) | window (measured) |
+ * The drive leaves counting mode warmup requests before every window, so the
+ * bus channels have the queues of a timed run again when measuring starts.
+ * A window cut short by the end of the trace is still measured. */
+
+#include "ssd.h"
+
+using namespace ssd;
+
+Sampler::Sampler(Ssd &ssd, ulong period, ulong warmup, ulong window):
+	ssd(ssd),
+	period(period),
+	warmup(warmup),
+	window(window),
+	forced(false),
+	counting(false)
+{
+	if (this->window == 0)
+	{
+		fprintf(stderr, "Sampler error: %s: the measurement window must hold at least one request\n", __func__);
+		this->window = 1;
+	}
+	if (this->period < this->warmup + this->window)
+	{
+		fprintf(stderr, "Sampler error: %s: period %lu is shorter than warm-up and window, measuring every request\n", __func__, period);
+		this->period = this->warmup + this->window;
+	}
+	reset();
+}
+
+uint Sampler::kind(enum event_type type)
+{
+	if (type == READ)
+		return 0;
+	if (type == WRITE)
+		return 1;
+	return ALL;
+}
+
+void Sampler::set_counting(bool counting)
+{
+	if (counting == this->counting)
+		return;
+	ssd.set_counting_mode(counting);
+	this->counting = counting;
+}
+
+/* Passes a request to the drive in the mode of its place in the period and
+ * returns the time the drive took (0 in counting mode) */
+double Sampler::event_arrive(enum event_type type, ulong logical_address, uint size, double start_time)
+{
+	if (forced)
+		return ssd.event_arrive(type, logical_address, size, start_time);
+
+	ulong fast_forward = period - warmup - window;
+	bool measure = position >= period - window;
+	set_counting(position < fast_forward);
+
+	double time = ssd.event_arrive(type, logical_address, size, start_time);
+
+	uint k = kind(type);
+	requests[k]++;
+	if (k != ALL)
+		requests[ALL]++;
+	if (measure)
+	{
+		window_requests[k]++;
+		window_time[k] += time;
+		if (k != ALL)
+		{
+			window_requests[ALL]++;
+			window_time[ALL] += time;
+		}
+		measured++;
+	}
+
+	if (++position == period)
+	{
+		close_window();
+		position = 0;
+	}
+	return counting ? 0.0 : time;
+}
+
+/* Runs every request in counting mode until disabled, e.g. to prepare a
+ * drive; these requests are not counted */
+void Sampler::fast_forward(bool enabled)
+{
+	forced = enabled;
+	set_counting(enabled);
+}
+
+void Sampler::close_window(void)
+{
+	for (uint k = 0; k < KINDS; k++)
+	{
+		if (window_requests[k] > 0)
+			latency[k].add(window_time[k] / window_requests[k]);
+		window_requests[k] = 0;
+		window_time[k] = 0.0;
+	}
+}
+
+/* Ends the trace: measures a partial window and restores timed mode */
+void Sampler::finish(void)
+{
+	close_window();
+	position = 0;
+	forced = false;
+	set_counting(false);
+}
+
+/* Forgets all measurements, e.g. between traces replayed on one drive */
+void Sampler::reset(void)
+{
+	position = 0;
+	measured = 0;
+	for (uint k = 0; k < KINDS; k++)
+	{
+		requests[k] = 0;
+		window_requests[k] = 0;
+		window_time[k] = 0.0;
+		latency[k] = Sample_stats();
+	}
+}
+
+ulong Sampler::get_measured(void) const
+{
+	return measured;
+}
+
+ulong Sampler::get_requests(void) const
+{
+	return requests[ALL];
+}
+
+ulong Sampler::get_requests(enum event_type type) const
+{
+	return requests[kind(type)];
+}
+
+const Sample_stats &Sampler::get_latency(void) const
+{
+	return latency[ALL];
+}
+
+const Sample_stats &Sampler::get_latency(enum event_type type) const
+{
+	return latency[kind(type)];
+}
+
+double Sampler::estimate_total(void) const
+{
+	return latency[ALL].mean() * requests[ALL];
+}
+
+double Sampler::estimate_total(enum event_type type) const
+{
+	uint k = kind(type);
+	return latency[k].mean() * requests[k];
+}
+
+double Sampler::estimate_total_ci(void) const
+{
+	return latency[ALL].ci_half_width() * requests[ALL];
+}
+
+double Sampler::estimate_total_ci(enum event_type type) const
+{
+	uint k = kind(type);
+	return latency[k].ci_half_width() * requests[k];
+}
+
+void Sampler::print(FILE *stream) const
+{
+	static const char *names[KINDS] = {"Read", "Write", "All"};
+
+	fprintf(stream, "Sampled %lu of %lu requests in %lu windows (mean +- 95%% CI half width)\n",
+			measured, requests[ALL], latency[ALL].size());
+	for (uint k = 0; k < KINDS; k++)
+		fprintf(stream, "%-6s: %lu requests, latency %.4f +- %.4f (%.2f%%), total %.4f +- %.4f\n", names[k],
+				requests[k], latency[k].mean(), latency[k].ci_half_width(), 100.0 * latency[k].ci_relative(),
+				latency[k].mean() * requests[k], latency[k].ci_half_width() * requests[k]);
+}
@@ -0,0 +1,277 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_snapshot.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Snapshot class
+ *
+ * Snapshots are written with stdio and read back from a read-only mapping of
+ * the file, so that restoring a drive costs little more than the copies into
+ * the simulator objects.  Values are stored in the native byte order; a
+ * snapshot is only meant to be loaded on the machine that wrote it. */
+
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+static const char SNAPSHOT_MAGIC[8] = {'F', 'S', 'S', 'N', 'A', 'P', '0', '8'};
+
+Snapshot::Snapshot(void):
+	file(NULL),
+	data(NULL),
+	size(0),
+	offset(0),
+	failed(false)
+{}
+
+Snapshot::~Snapshot(void)
+{
+	close();
+}
+
+enum status Snapshot::create(const char *filename)
+{
+	close();
+	failed = false;
+	if ((file = fopen(filename, "wb")) == NULL)
+	{
+		fprintf(stderr, "Snapshot error: %s: cannot create %s: %s\n", __func__, filename, strerror(errno));
+		failed = true;
+		return FAILURE;
+	}
+	write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	return good() ? SUCCESS : FAILURE;
+}
+
+enum status Snapshot::open(const char *filename)
+{
+	close();
+	failed = false;
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		failed = true;
+		return FAILURE;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(SNAPSHOT_MAGIC))
+	{
+		fprintf(stderr, "Snapshot error: %s: %s is not a snapshot\n", __func__, filename);
+		::close(fd);
+		failed = true;
+		return FAILURE;
+	}
+
+	void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		fprintf(stderr, "Snapshot error: %s: cannot map %s: %s\n", __func__, filename, strerror(errno));
+		failed = true;
+		return FAILURE;
+	}
+	data = (char *) mapping;
+	size = info.st_size;
+	offset = 0;
+
+	char magic[sizeof(SNAPSHOT_MAGIC)];
+	read(magic, sizeof(magic));
+	if (memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0)
+	{
+		fprintf(stderr, "Snapshot error: %s: %s is not a snapshot of this version\n", __func__, filename);
+		close();
+		failed = true;
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+/* Flushes a snapshot being written or unmaps one being read */
+enum status Snapshot::close(void)
+{
+	if (file != NULL)
+	{
+		if (fclose(file) != 0)
+			failed = true;
+		file = NULL;
+	}
+	if (data != NULL)
+	{
+		munmap(data, size);
+		data = NULL;
+		size = 0;
+		offset = 0;
+	}
+	return failed ? FAILURE : SUCCESS;
+}
+
+bool Snapshot::good(void) const
+{
+	return !failed;
+}
+
+bool Snapshot::is_loading(void) const
+{
+	return data != NULL;
+}
+
+void Snapshot::write(const void *values, size_t length)
+{
+	if (failed || file == NULL)
+	{
+		failed = true;
+		return;
+	}
+	if (length > 0 && fwrite(values, length, 1, file) != 1)
+	{
+		fprintf(stderr, "Snapshot error: %s: %s\n", __func__, strerror(errno));
+		failed = true;
+	}
+}
+
+void Snapshot::read(void *values, size_t length)
+{
+	if (failed || data == NULL || length > size - offset)
+	{
+		if (!failed)
+			fprintf(stderr, "Snapshot error: %s: snapshot is truncated\n", __func__);
+		failed = true;
+		memset(values, 0, length);
+		return;
+	}
+	memcpy(values, data + offset, length);
+	offset += length;
+}
+
+void Snapshot::put(const std::vector<bool> &values)
+{
+	put((ulong) values.size());
+	unsigned char byte = 0;
+	for (ulong i = 0; i < values.size(); i++)
+	{
+		if (values[i])
+			byte |= 1 << (i % 8);
+		if (i % 8 == 7 || i + 1 == values.size())
+		{
+			put(byte);
+			byte = 0;
+		}
+	}
+}
+
+void Snapshot::get(std::vector<bool> &values)
+{
+	ulong count = 0;
+	get(count);
+	values.assign(count, false);
+	unsigned char byte = 0;
+	for (ulong i = 0; i < count && good(); i++)
+	{
+		if (i % 8 == 0)
+			get(byte);
+		values[i] = (byte >> (i % 8)) & 1;
+	}
+}
+
+void Snapshot::put(const std::map<double, double> &values)
+{
+	put((ulong) values.size());
+	for (std::map<double, double>::const_iterator it = values.begin(); it != values.end(); ++it)
+	{
+		put(it->first);
+		put(it->second);
+	}
+}
+
+void Snapshot::get(std::map<double, double> &values)
+{
+	ulong count = 0;
+	get(count);
+	values.clear();
+	for (ulong i = 0; i < count && good(); i++)
+	{
+		double key, value;
+		get(key);
+		get(value);
+		values.insert(values.end(), std::make_pair(key, value));
+	}
+}
+
+void Snapshot::put(const std::string &value)
+{
+	put((ulong) value.size());
+	write(value.data(), value.size());
+}
+
+void Snapshot::get(std::string &value)
+{
+	ulong length = 0;
+	get(length);
+	value.clear();
+	if (failed || length > size - offset)
+	{
+		if (!failed)
+			fprintf(stderr, "Snapshot error: %s: snapshot is truncated\n", __func__);
+		failed = true;
+		return;
+	}
+	value.assign(data + offset, length);
+	offset += length;
+}
+
+void Snapshot::put(const Address &address)
+{
+	put(address.package);
+	put(address.die);
+	put(address.plane);
+	put(address.block);
+	put(address.page);
+	put(address.real_address);
+	put(address.valid);
+}
+
+void Snapshot::get(Address &address)
+{
+	get(address.package);
+	get(address.die);
+	get(address.plane);
+	get(address.block);
+	get(address.page);
+	get(address.real_address);
+	get(address.valid);
+}
+
+void Snapshot::put_block(const Block *block)
+{
+	put(block == NULL ? -1L : block->get_physical_address());
+}
+
+Block *Snapshot::get_block(FtlParent &ftl)
+{
+	long physical_address = -1;
+	get(physical_address);
+	if (physical_address < 0 || !good())
+		return NULL;
+	return ftl.get_block_pointer(Address(physical_address, BLOCK));
+}
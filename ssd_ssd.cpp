@@ -35,6 +35,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <limits.h>
+#include <algorithm>
 
 using namespace ssd;
 
@@ -42,6 +43,11 @@ using namespace ssd;
  * occurs in the order of declaration in the class definition and not in the
  * order listed here */
 Ssd::Ssd(uint ssd_size): 
+	/* each Ssd gets its own copy of the active configuration, and is built
+	 * with that context active so that its FTL and Blocks register with it */
+	context(SimContext::current()->config),
+	construction(context),
+
 	size(ssd_size), 
 	controller(*this), 
 	ram(RAM_READ_DELAY, RAM_WRITE_DELAY), 
@@ -60,10 +66,16 @@ Ssd::Ssd(uint ssd_size):
 	least_worn(0), 
 
 	/* assume hardware created at time 0 and had an implied free erasure */
-	last_erase_time(0.0)
+	last_erase_time(0.0),
+
+	last_queue_wait(0.0),
+	last_reclaimed(false)
 {
 	uint i;
 
+	for (i = 0; i < LATENCY_COMPONENTS; i++)
+		last_component_time[i] = 0.0;
+
 	/* new cannot initialize an array with constructor args so
 	 *		malloc the array
 	 *		then use placement new to call the constructor for each element
@@ -92,12 +104,12 @@ Ssd::Ssd(uint ssd_size):
 		/* Allocate memory for data pages */
 		ulong pageSize = ((ulong)(SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * BLOCK_SIZE)) * (ulong)PAGE_SIZE;
 #ifdef __APPLE__
-		page_data = mmap(NULL, pageSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+		context.page_data = mmap(NULL, pageSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
 #else
-		page_data = mmap64(NULL, pageSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1 ,0);
+		context.page_data = mmap64(NULL, pageSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1 ,0);
 #endif
 
-		if (page_data == MAP_FAILED)
+		if (context.page_data == MAP_FAILED)
 		{
 			fprintf(stderr, "Ssd error: %s: constructor unable to allocate page data.\n", __func__);
 			switch (errno)
@@ -113,11 +125,14 @@ Ssd::Ssd(uint ssd_size):
 	assert(VIRTUAL_BLOCK_SIZE > 0);
 	assert(VIRTUAL_PAGE_SIZE > 0);
 
+	construction.release();
 	return;
 }
 
 Ssd::~Ssd(void)
 {
+	SimContext::Scope scope(context);
+
 	/* explicitly call destructors and use free
 	 * since we used malloc and placement new */
 	for (uint i = 0; i < size; i++)
@@ -126,7 +141,8 @@ Ssd::~Ssd(void)
 	}
 	free(data);
 	ulong pageSize = ((ulong)(SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * BLOCK_SIZE)) * (ulong)PAGE_SIZE;
-	munmap(page_data, pageSize);
+	if (context.page_data != NULL)
+		munmap(context.page_data, pageSize);
 
 	return;
 }
@@ -136,6 +152,13 @@ double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size,
 	return event_arrive(type, logical_address, size, start_time, NULL);
 }
 
+/* Flash work done to reclaim space: garbage collection, merges and erases */
+static long reclaimed(const Stats &stats)
+{
+	return stats.numGCWrite + stats.numGCErase + stats.numFTLErase + stats.numWLErase +
+		stats.numLogMergeSwitch + stats.numLogMergePartial + stats.numLogMergeFull;
+}
+
 /* This is the function that will be called by DiskSim
  * Provide the event (request) type (see enum in ssd.h),
  * 	logical_address (page number), size of request in pages, and the start
@@ -144,6 +167,8 @@ double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size,
  * 	request.  Remember to use the same time units as in the config file. */
 double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size, double start_time, void *buffer)
 {
+	SimContext::Scope scope(context);
+
 	assert(start_time >= 0.0);
 
 	if (VIRTUAL_PAGE_SIZE == 1)
@@ -151,6 +176,9 @@ double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size,
 	else
 		assert((long long int) logical_address*VIRTUAL_PAGE_SIZE <= (long long int) SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * BLOCK_SIZE);
 
+	// Trims cover an extent of pages and are handled by the FTL in one request.
+	assert(type != TRIM || (long long int) (logical_address + size) * VIRTUAL_PAGE_SIZE <= (long long int) SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * BLOCK_SIZE);
+
 	/* allocate the event and address dynamically so that the allocator can
 	 * handle efficiency issues for us */
 	Event *event = NULL;
@@ -162,6 +190,13 @@ double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size,
 	}
 
 	event->set_payload(buffer);
+	context.global_buffer = NULL;
+	if (Timeline::enabled())
+	{
+		context.timeline_request = Timeline::next_request();
+		context.timeline_request_start = start_time;
+	}
+	long reclaim_work = reclaimed(controller.stats);
 
 	if(controller.event_arrive(*event) != SUCCESS)
 	{
@@ -171,6 +206,26 @@ double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size,
 
 	/* use start_time as a temporary for returning time taken to service event */
 	start_time = event -> get_time_taken();
+
+	/* the waits are summed over the event list, so they can exceed the time */
+	last_queue_wait = std::min(event -> get_bus_wait_time() + event -> get_die_wait_time(), start_time);
+	last_reclaimed = reclaimed(controller.stats) != reclaim_work;
+
+	/* scale the other components down when their sums exceed the time */
+	double accounted = 0.0;
+	for (uint i = 0; i < LATENCY_COMPONENTS; i++)
+		if (i != COMPONENT_FLASH)
+			accounted += event -> get_component_time((enum latency_component) i);
+	double scale = accounted > start_time ? start_time / accounted : 1.0;
+	for (uint i = 0; i < LATENCY_COMPONENTS; i++)
+		last_component_time[i] = event -> get_component_time((enum latency_component) i) * scale;
+	last_component_time[COMPONENT_FLASH] = accounted > start_time ? 0.0 : start_time - accounted;
+
+	if (context.timeline_request != 0)
+	{
+		Timeline::span(TRACK_HOST, 0, 0, type == READ ? TIMELINE_HOST_READ : type == WRITE ? TIMELINE_HOST_WRITE : TIMELINE_HOST_TRIM, context.timeline_request_start, start_time);
+		context.timeline_request = 0;
+	}
 	delete event;
 	return start_time;
 }
@@ -182,7 +237,7 @@ double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size,
  */
 void *Ssd::get_result_buffer()
 {
-	return global_buffer;
+	return context.global_buffer;
 }
 
 /* read write erase and merge should only pass on the event
@@ -319,28 +374,81 @@ ssd::uint Ssd::get_num_invalid(const Address &address) const
 	return data[address.package].get_num_invalid(address);
 }
 
+/* Free blocks the block manager can still allocate */
+int Ssd::get_num_free_blocks(void)
+{
+	SimContext::Scope scope(context);
+	Block_manager *block_manager = Block_manager::instance();
+	return block_manager == NULL ? 0 : block_manager->get_num_free_blocks();
+}
+
 void Ssd::print_statistics()
 {
+	SimContext::Scope scope(context);
 	controller.stats.print_statistics();
 }
 
 void Ssd::reset_statistics()
 {
+	SimContext::Scope scope(context);
 	controller.stats.reset_statistics();
 }
 
+/* Switches this drive between timed and counting mode (COUNTING_MODE) */
+void Ssd::set_counting_mode(bool counting)
+{
+	context.config.counting_mode = counting;
+}
+
+/* Time the last request spent waiting for bus channels and busy dies, part
+ * of the time event_arrive() returned for it */
+double Ssd::get_last_queue_wait(void) const
+{
+	return last_queue_wait;
+}
+
+/* Whether the last request had to wait for garbage collection, a merge or
+ * an erase */
+bool Ssd::get_last_reclaimed(void) const
+{
+	return last_reclaimed;
+}
+
+/* Part of the time event_arrive() returned for the last request; the
+ * components add up to that time */
+double Ssd::get_last_component_time(enum latency_component component) const
+{
+	return last_component_time[component];
+}
+
 void Ssd::write_statistics(FILE *stream)
 {
+	SimContext::Scope scope(context);
 	controller.stats.write_statistics(stream);
 }
 
+/* Modelled SRAM and simulator memory of the FTL mapping structures */
+void Ssd::print_memory(FILE *stream)
+{
+	SimContext::Scope scope(context);
+	controller.get_ftl().print_memory(stream);
+}
+
+void Ssd::get_memory(std::vector<Ftl_memory> &usage)
+{
+	SimContext::Scope scope(context);
+	controller.get_ftl().get_memory(usage);
+}
+
 void Ssd::print_ftl_statistics()
 {
+	SimContext::Scope scope(context);
 	controller.print_ftl_statistics();
 }
 
 void Ssd::write_header(FILE *stream)
 {
+	SimContext::Scope scope(context);
 	controller.stats.write_header(stream);
 }
 
@@ -360,6 +468,7 @@ const Controller &Ssd::get_controller(void) const
  */
 double Ssd::ready_at(void)
 {
+	SimContext::Scope scope(context);
 	double next_ready_time = std::numeric_limits<double>::max();
 
 	for (int i=0;i<size;i++)
@@ -375,3 +484,95 @@ double Ssd::ready_at(void)
 	else
 		return next_ready_time;
 }
+
+/* The configuration as print_config() writes it, to check that a snapshot
+ * is loaded into a drive of the same geometry and FTL */
+static std::string config_text(void)
+{
+	char *text = NULL;
+	size_t length = 0;
+	FILE *stream = open_memstream(&text, &length);
+	if (stream == NULL)
+		return std::string();
+	print_config(stream);
+	fclose(stream);
+	std::string result(text, length);
+	free(text);
+	return result;
+}
+
+/*
+ * Writes the state of the drive to a snapshot created with
+ * Snapshot::create().  Page data contents are not included.
+ */
+enum status Ssd::save(Snapshot &snapshot)
+{
+	SimContext::Scope scope(context);
+
+	snapshot.put(config_text());
+	snapshot.put(erases_remaining);
+	snapshot.put(least_worn);
+	snapshot.put(last_erase_time);
+	bus.save(snapshot);
+	for (uint i = 0; i < size; i++)
+		data[i].save(snapshot);
+	controller.save(snapshot);
+
+	if (!snapshot.good())
+	{
+		fprintf(stderr, "Ssd error: %s: could not write snapshot\n", __func__);
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+/*
+ * Restores a drive saved with save().  The drive must have been built with
+ * the same configuration; it is left untouched if it was not.  A drive whose
+ * load fails part way must not be used any further.
+ */
+enum status Ssd::load(Snapshot &snapshot)
+{
+	SimContext::Scope scope(context);
+
+	std::string config;
+	snapshot.get(config);
+	if (!snapshot.good() || config != config_text())
+	{
+		fprintf(stderr, "Ssd error: %s: snapshot was taken with a different configuration\n", __func__);
+		return FAILURE;
+	}
+
+	snapshot.get(erases_remaining);
+	snapshot.get(least_worn);
+	snapshot.get(last_erase_time);
+	bus.load(snapshot);
+	for (uint i = 0; i < size; i++)
+		data[i].load(snapshot);
+	controller.load(snapshot);
+
+	if (!snapshot.good())
+	{
+		fprintf(stderr, "Ssd error: %s: could not read snapshot\n", __func__);
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+/*
+ * Brings a fresh drive to the state it has after the first fill_fraction of
+ * its logical pages is written once in the given pattern.  The FTL builds its
+ * mapping and the page states directly, so no time passes and no statistics
+ * are counted.  Steady-state experiments use it instead of a simulated fill.
+ */
+enum status Ssd::precondition(enum precondition_pattern pattern, double fill_fraction, ulong seed)
+{
+	SimContext::Scope scope(context);
+
+	if (fill_fraction < 0.0 || fill_fraction > 1.0)
+	{
+		fprintf(stderr, "Ssd error: %s: fill fraction %f is not between 0 and 1\n", __func__, fill_fraction);
+		return FAILURE;
+	}
+	return controller.precondition(pattern, fill_fraction, seed);
+}
@@ -41,6 +41,7 @@ void Stats::reset()
 	numFTLWrite = 0;
 	numFTLErase = 0;
 	numFTLTrim = 0;
+	numFTLCopyBack = 0;
 
 	//GC
 	numGCRead = 0;
@@ -67,14 +68,60 @@ void Stats::reset()
 	// Memory consumptions (Bytes)
 	numMemoryTranslation = 0;
 	numMemoryCache = 0;
+	peakMemoryTranslation = 0;
+	peakMemoryCache = 0;
 
 	numMemoryRead = 0;
 	numMemoryWrite = 0;
+
+	valid_page_copies = 0;
+	numFlashWrite = 0;
+	numGCCopy = 0;
+
+	// Log merge latencies
+	for (uint t=0;t<3;t++)
+	{
+		mergeLatencySum[t] = 0;
+		for (uint i=0;i<MERGE_LATENCY_BUCKETS;i++)
+			mergeLatency[t][i] = 0;
+	}
 }
 
+/*
+ * Registers a log block merge and its latency. Bucket i holds merges that took
+ * [2^i, 2^(i+1)) time units, bucket 0 also holds everything below 1.
+ */
+void Stats::add_merge(enum merge_type type, double latency)
+{
+	switch (type)
+	{
+	case MERGE_SWITCH:
+		numLogMergeSwitch++;
+		break;
+	case MERGE_PARTIAL:
+		numLogMergePartial++;
+		break;
+	case MERGE_FULL:
+		numLogMergeFull++;
+		break;
+	}
+
+	uint bucket = 0;
+	while (bucket < MERGE_LATENCY_BUCKETS-1 && latency >= (double)(2UL << bucket))
+		bucket++;
+
+	mergeLatency[type][bucket]++;
+	mergeLatencySum[type] += latency;
+}
+
+/* The FTL still holds its mapping structures, so their size is kept */
 void Stats::reset_statistics()
 {
+	long translation = numMemoryTranslation;
+	long cache = numMemoryCache;
 	reset();
+	numMemoryTranslation = peakMemoryTranslation = translation;
+	numMemoryCache = peakMemoryCache = cache;
 }
 
 void Stats::write_header(FILE *stream)
@@ -103,13 +150,99 @@ void Stats::print_statistics()
 	printf("Statistics:\n");
 	printf("-----------\n");
 	printf("FTL Reads: %li\t Writes: %li\t Erases: %li\t Trims: %li\n", numFTLRead, numFTLWrite, numFTLErase, numFTLTrim);
+	printf("FTL Copy-backs: %li\n", numFTLCopyBack);
 	printf("GC  Reads: %li\t Writes: %li\t Erases: %li\n", numGCRead, numGCWrite, numGCErase);
 	printf("WL  Reads: %li\t Writes: %li\t Erases: %li\n", numWLRead, numWLWrite, numWLErase);
 	printf("Log FTL Switch: %li Partial: %li Full: %li\n", numLogMergeSwitch, numLogMergePartial, numLogMergeFull);
+	print_merge_latency("Switch", MERGE_SWITCH);
+	print_merge_latency("Partial", MERGE_PARTIAL);
+	print_merge_latency("Full", MERGE_FULL);
 	printf("Page FTL Convertions: %li\n", numPageBlockToPageConversion);
 	printf("Cache Hits: %li Faults: %li Hit Ratio: %f\n", numCacheHits, numCacheFaults, (double)numCacheHits/(double)(numCacheHits+numCacheFaults));
 	printf("Memory Consumption:\n");
-	printf("Tranlation: %li Cache: %li\n", numMemoryTranslation, numMemoryCache);
+	printf("Tranlation: %li Cache: %li (peak %li, %li) bytes of SRAM\n", numMemoryTranslation, numMemoryCache, peakMemoryTranslation, peakMemoryCache);
 	printf("Reads: %li \tWrites: %li\n", numMemoryRead, numMemoryWrite);
 	printf("-----------\n");
 }
+
+void Stats::print_merge_latency(const char *name, enum merge_type type)
+{
+	long count = 0;
+	for (uint i=0;i<MERGE_LATENCY_BUCKETS;i++)
+		count += mergeLatency[type][i];
+
+	if (count == 0)
+		return;
+
+	printf("%s merge latency: avg %f\n", name, mergeLatencySum[type] / count);
+	for (uint i=0;i<MERGE_LATENCY_BUCKETS;i++)
+	{
+		if (mergeLatency[type][i] == 0)
+			continue;
+		printf("  [%lu, %lu): %li\n", i == 0 ? 0UL : 1UL << i, 2UL << i, mergeLatency[type][i]);
+	}
+}
+
+/* Welford's update, stable for long runs of similar values */
+Sample_stats::Sample_stats(void):
+	count(0),
+	running_mean(0.0),
+	squared_deviations(0.0)
+{}
+
+void Sample_stats::add(double value)
+{
+	count++;
+	double delta = value - running_mean;
+	running_mean += delta / count;
+	squared_deviations += delta * (value - running_mean);
+}
+
+ulong Sample_stats::size(void) const
+{
+	return count;
+}
+
+double Sample_stats::mean(void) const
+{
+	return running_mean;
+}
+
+double Sample_stats::stddev(void) const
+{
+	return count > 1 ? sqrt(squared_deviations / (count - 1)) : 0.0;
+}
+
+/* Student's t quantile for a two-sided 95% interval.  Tabulated up to 30
+ * degrees of freedom, beyond that the Cornish-Fisher expansion around the
+ * normal quantile, which is within 1e-4 of the exact value there. */
+double Sample_stats::ci_half_width(void) const
+{
+	static const double t95[] = {0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+			2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+			2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+	if (count < 2)
+		return 0.0;
+	ulong df = count - 1;
+	double t;
+	if (df < sizeof(t95) / sizeof(t95[0]))
+		t = t95[df];
+	else
+	{
+		const double z = 1.959964;
+		const double z3 = z * z * z, z5 = z3 * z * z, z7 = z5 * z * z;
+		const double n = (double) df;
+		t = z + (z3 + z) / (4 * n) + (5 * z5 + 16 * z3 + 3 * z) / (96 * n * n)
+				+ (3 * z7 + 19 * z5 + 17 * z3 - 15 * z) / (384 * n * n * n);
+	}
+	return t * stddev() / sqrt((double) count);
+}
+
+/* Half width relative to the mean; 0 when both are 0 */
+double Sample_stats::ci_relative(void) const
+{
+	double half = ci_half_width();
+	if (half == 0.0)
+		return 0.0;
+	return running_mean != 0.0 ? half / fabs(running_mean) : INFINITY;
+}
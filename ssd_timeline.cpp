@@ -0,0 +1,339 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_timeline.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Timeline class
+ *
+ * Spans are appended to a buffer owned by the calling thread without
+ * locking.  A full buffer is queued for the writer thread, which formats its
+ * spans as Chrome trace events and returns it to the free list, so the
+ * simulation only waits on the lock when it swaps buffers.  At most
+ * TIMELINE_BUFFERS buffers exist; the simulation drops spans rather than
+ * wait for the writer.  stop() takes the buffers of all threads once no
+ * thread is appending to one (Timeline_sink::appending). */
+
+#include <string.h>
+#include <errno.h>
+#include <set>
+#include <algorithm>
+#include "ssd.h"
+
+using namespace ssd;
+
+static const uint TIMELINE_BUFFER_SPANS = 8192;
+static const uint TIMELINE_BUFFERS = 64;
+
+struct Timeline_span
+{
+	double start;
+	double duration;
+	double request_start;
+	ulong request;
+	uint drive;
+	uint index;
+	uint sub_index;
+	unsigned char track;
+	unsigned char op;
+};
+
+struct Timeline_buffer
+{
+	std::vector<Timeline_span> spans;
+};
+
+static const char *op_names[] = {"read", "program", "erase", "copy-back", "bus", "relocate", "host read", "host write", "host trim"};
+
+/* State shared by the simulation threads and the writer thread */
+struct Timeline_sink
+{
+	std::mutex lock;
+	std::condition_variable full_available;
+	std::deque<Timeline_buffer *> full;
+	std::vector<Timeline_buffer *> free;
+	std::vector<Timeline_buffer *> in_use;
+	uint num_buffers;
+	bool stopping;
+	std::thread writer;
+
+	FILE *file;
+	double begin;
+	double end;
+	std::atomic<ulong> generation;
+	std::atomic<ulong> requests;
+	std::atomic<ulong> spans;
+	std::atomic<ulong> dropped;
+
+	/* threads inside span() that saw recording on */
+	std::atomic<uint> appending;
+
+	/* writer thread only */
+	std::set<std::pair<uint, uint> > named_tracks;
+	ulong flows;
+	bool first;
+};
+
+static Timeline_sink sink;
+
+/* buffer of the calling thread, valid while generation matches */
+static thread_local Timeline_buffer *local_buffer = NULL;
+static thread_local ulong local_generation = 0;
+
+static uint track_id(const Timeline_span &span)
+{
+	switch (span.track)
+	{
+	case TRACK_HOST:
+		return 0;
+	case TRACK_GC:
+		return 1;
+	case TRACK_CHANNEL:
+		return 1000 + span.index;
+	default:
+		return 100000 + span.index * 1000 + span.sub_index;
+	}
+}
+
+static void write_event_prefix(void)
+{
+	fputs(sink.first ? "\n" : ",\n", sink.file);
+	sink.first = false;
+}
+
+static void name_track(const Timeline_span &span, uint tid)
+{
+	if (sink.named_tracks.insert(std::make_pair(span.drive, tid)).second == false)
+		return;
+
+	if (sink.named_tracks.insert(std::make_pair(span.drive, ~0u)).second)
+	{
+		write_event_prefix();
+		fprintf(sink.file, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%u,\"args\":{\"name\":\"ssd %u\"}}", span.drive, span.drive);
+	}
+
+	write_event_prefix();
+	fprintf(sink.file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"", span.drive, tid);
+	if (span.track == TRACK_HOST)
+		fprintf(sink.file, "host requests");
+	else if (span.track == TRACK_GC)
+		fprintf(sink.file, "gc relocations");
+	else if (span.track == TRACK_CHANNEL)
+		fprintf(sink.file, "channel %u", span.index);
+	else
+		fprintf(sink.file, "die %u.%u", span.index, span.sub_index);
+	fprintf(sink.file, "\"}}");
+	write_event_prefix();
+	fprintf(sink.file, "{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":%u,\"tid\":%u,\"args\":{\"sort_index\":%u}}", span.drive, tid, tid);
+}
+
+/* One complete event per span; an operation done for a host request also
+ * gets a flow arrow from the request */
+static void write_span(const Timeline_span &span)
+{
+	uint tid = track_id(span);
+	name_track(span, tid);
+
+	write_event_prefix();
+	fprintf(sink.file, "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", op_names[span.op], span.drive, tid, span.start, span.duration);
+	if (span.request != 0)
+		fprintf(sink.file, ",\"args\":{\"request\":%lu}", span.request);
+	fputc('}', sink.file);
+
+	if (span.request == 0 || span.track == TRACK_HOST)
+		return;
+	sink.flows++;
+	write_event_prefix();
+	fprintf(sink.file, "{\"ph\":\"s\",\"name\":\"request\",\"cat\":\"request\",\"id\":%lu,\"pid\":%u,\"tid\":0,\"ts\":%.3f}", sink.flows, span.drive, span.request_start);
+	write_event_prefix();
+	fprintf(sink.file, "{\"ph\":\"f\",\"bp\":\"e\",\"name\":\"request\",\"cat\":\"request\",\"id\":%lu,\"pid\":%u,\"tid\":%u,\"ts\":%.3f}", sink.flows, span.drive, tid, span.start);
+}
+
+static void write_buffers(void)
+{
+	std::unique_lock<std::mutex> guard(sink.lock);
+	for (;;)
+	{
+		sink.full_available.wait(guard, [] { return !sink.full.empty() || sink.stopping; });
+		if (sink.full.empty())
+			return;
+
+		Timeline_buffer *buffer = sink.full.front();
+		sink.full.pop_front();
+		guard.unlock();
+		for (uint i = 0; i < buffer->spans.size(); i++)
+			write_span(buffer->spans[i]);
+		buffer->spans.clear();
+		guard.lock();
+		sink.free.push_back(buffer);
+	}
+}
+
+/* Returns a free buffer, or NULL when all of them are in use */
+static Timeline_buffer *take_buffer(void)
+{
+	std::lock_guard<std::mutex> guard(sink.lock);
+	Timeline_buffer *buffer = NULL;
+	if (!sink.free.empty())
+	{
+		buffer = sink.free.back();
+		sink.free.pop_back();
+	}
+	else if (sink.num_buffers < TIMELINE_BUFFERS)
+	{
+		buffer = new Timeline_buffer;
+		buffer->spans.reserve(TIMELINE_BUFFER_SPANS);
+		sink.num_buffers++;
+	}
+	if (buffer != NULL)
+		sink.in_use.push_back(buffer);
+	return buffer;
+}
+
+static void queue_buffer(Timeline_buffer *buffer)
+{
+	std::lock_guard<std::mutex> guard(sink.lock);
+	sink.in_use.erase(std::find(sink.in_use.begin(), sink.in_use.end(), buffer));
+	sink.full.push_back(buffer);
+	sink.full_available.notify_one();
+}
+
+std::atomic<bool> Timeline::recording(false);
+
+enum status Timeline::start(const char *filename, double begin, double end)
+{
+	if (recording || sink.file != NULL)
+	{
+		fprintf(stderr, "Timeline error: %s: a timeline is already being recorded\n", __func__);
+		return FAILURE;
+	}
+	if ((sink.file = fopen(filename, "w")) == NULL)
+	{
+		fprintf(stderr, "Timeline error: %s: cannot create %s: %s\n", __func__, filename, strerror(errno));
+		return FAILURE;
+	}
+	fprintf(sink.file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+	sink.begin = begin;
+	sink.end = end;
+	sink.generation++;
+	sink.requests = 0;
+	sink.spans = 0;
+	sink.dropped = 0;
+	sink.named_tracks.clear();
+	sink.flows = 0;
+	sink.first = true;
+	sink.stopping = false;
+	sink.writer = std::thread(write_buffers);
+	recording = true;
+	return SUCCESS;
+}
+
+/* Writes the spans still buffered and closes the file */
+enum status Timeline::stop(void)
+{
+	if (sink.file == NULL)
+		return FAILURE;
+	recording = false;
+	while (sink.appending != 0)
+		std::this_thread::yield();
+	{
+		std::lock_guard<std::mutex> guard(sink.lock);
+		for (uint i = 0; i < sink.in_use.size(); i++)
+			sink.full.push_back(sink.in_use[i]);
+		sink.in_use.clear();
+		sink.generation++;
+		sink.stopping = true;
+		sink.full_available.notify_one();
+	}
+	sink.writer.join();
+
+	fprintf(sink.file, "\n]}\n");
+	enum status status = fclose(sink.file) == 0 ? SUCCESS : FAILURE;
+	if (status == FAILURE)
+		fprintf(stderr, "Timeline error: %s: %s\n", __func__, strerror(errno));
+	sink.file = NULL;
+
+	for (uint i = 0; i < sink.free.size(); i++)
+		delete sink.free[i];
+	sink.free.clear();
+	sink.num_buffers = 0;
+	return status;
+}
+
+ulong Timeline::next_request(void)
+{
+	return ++sink.requests;
+}
+
+/* Appends a span to the buffer of the calling thread */
+static void append_span(enum timeline_track track, uint index, uint sub_index, enum timeline_op op, double start, double duration)
+{
+	if (local_generation != sink.generation)
+	{
+		local_buffer = NULL;
+		local_generation = sink.generation;
+	}
+	if (local_buffer == NULL && (local_buffer = take_buffer()) == NULL)
+	{
+		sink.dropped++;
+		return;
+	}
+
+	const SimContext *context = SimContext::current();
+	Timeline_span span;
+	span.start = start;
+	span.duration = duration;
+	span.request_start = context->timeline_request_start;
+	span.request = context->timeline_request;
+	span.drive = context->timeline_drive;
+	span.index = index;
+	span.sub_index = sub_index;
+	span.track = track;
+	span.op = op;
+	local_buffer->spans.push_back(span);
+	sink.spans++;
+
+	if (local_buffer->spans.size() >= TIMELINE_BUFFER_SPANS)
+	{
+		queue_buffer(local_buffer);
+		local_buffer = NULL;
+	}
+}
+
+/* Records a span of the drive active on the calling thread.  Once stop()
+ * has cleared recording, it waits for the threads counted in appending;
+ * a thread that counts itself in later sees recording off and leaves. */
+void Timeline::span(enum timeline_track track, uint index, uint sub_index, enum timeline_op op, double start, double duration)
+{
+	if (!enabled() || COUNTING_MODE || start < sink.begin || (sink.end >= 0.0 && start >= sink.end))
+		return;
+
+	sink.appending++;
+	if (recording.load())
+		append_span(track, index, sub_index, op, start, duration);
+	sink.appending--;
+}
+
+ulong Timeline::get_num_spans(void)
+{
+	return sink.spans;
+}
+
+ulong Timeline::get_num_dropped(void)
+{
+	return sink.dropped;
+}
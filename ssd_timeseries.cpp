@@ -0,0 +1,159 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_timeseries.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Time_series class
+ *
+ * Windowed metrics of a run.  Requests only add to a few window counters;
+ * the controller statistics are compared with a copy taken at the start of
+ * the window when it closes, so a request costs O(1) however long the run.
+ * Rows are written as ';' separated text, like Stats::write_statistics. */
+
+#include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include "ssd.h"
+
+using namespace ssd;
+
+Time_series::Time_series(Ssd &ssd, double interval, ulong request_interval):
+	ssd(ssd),
+	interval(interval),
+	request_interval(request_interval),
+	file(NULL),
+	rows(0),
+	started(false),
+	window_start(0.0),
+	window_end(0.0),
+	last_completion(0.0),
+	requests(0),
+	read_pages(0),
+	write_pages(0),
+	latency(0.0)
+{
+	if (this->interval <= 0.0 && this->request_interval == 0)
+		this->request_interval = 1;
+}
+
+Time_series::~Time_series(void)
+{
+	finish();
+}
+
+enum status Time_series::open(const char *filename)
+{
+	finish();
+	if ((file = fopen(filename, "w")) == NULL)
+	{
+		fprintf(stderr, "Time_series error: %s: cannot create %s: %s\n", __func__, filename, strerror(errno));
+		return FAILURE;
+	}
+	fprintf(file, "start;end;requests;read_MBps;write_MBps;mean_latency;waf;free_blocks;gc_copies;erases;cache_hit_ratio\n");
+	rows = 0;
+	started = false;
+	return SUCCESS;
+}
+
+double Time_series::event_arrive(enum event_type type, ulong logical_address, uint size, double start_time)
+{
+	double time = ssd.event_arrive(type, logical_address, size, start_time);
+	add(type, size, start_time, time);
+	return time;
+}
+
+/* Counts a request the caller issued to the drive itself */
+void Time_series::add(enum event_type type, uint size, double start_time, double time_taken)
+{
+	if (file == NULL)
+		return;
+
+	if (!started)
+		start_window(start_time);
+	else if (interval > 0.0 && start_time >= window_end)
+	{
+		write_row(window_end);
+		/* empty windows are skipped */
+		start_window(window_end + floor((start_time - window_end) / interval) * interval);
+	}
+	else if (interval <= 0.0 && requests >= request_interval)
+	{
+		/* a window of requests ends where the next one arrives */
+		write_row(start_time);
+		start_window(start_time);
+	}
+
+	requests++;
+	if (type == READ)
+		read_pages += size;
+	else if (type == WRITE)
+		write_pages += size;
+	latency += time_taken;
+	last_completion = std::max(last_completion, start_time + time_taken);
+}
+
+/* Writes the open window and closes the file */
+void Time_series::finish(void)
+{
+	if (file == NULL)
+		return;
+	if (started && requests > 0)
+		write_row(interval > 0.0 ? std::min(window_end, std::max(last_completion, window_start)) : last_completion);
+	fclose(file);
+	file = NULL;
+	started = false;
+}
+
+ulong Time_series::size(void) const
+{
+	return rows;
+}
+
+void Time_series::start_window(double start)
+{
+	started = true;
+	window_start = start;
+	window_end = start + interval;
+	last_completion = start;
+	requests = 0;
+	read_pages = 0;
+	write_pages = 0;
+	latency = 0.0;
+	window_stats = ssd.get_controller().stats;
+}
+
+void Time_series::write_row(double end)
+{
+	const Stats &stats = ssd.get_controller().stats;
+	double span = (end - window_start) / 1e6;
+	double megabytes = (double) PAGE_SIZE / (1024.0 * 1024.0);
+	long flash_writes = stats.numFlashWrite - window_stats.numFlashWrite;
+	long hits = stats.numCacheHits - window_stats.numCacheHits;
+	long lookups = hits + stats.numCacheFaults - window_stats.numCacheFaults;
+
+	fprintf(file, "%.3f;%.3f;%lu;%.4f;%.4f;%.3f;%.4f;%d;%ld;%ld;%.4f\n", window_start, end, requests,
+			span > 0.0 ? read_pages * megabytes / span : 0.0,
+			span > 0.0 ? write_pages * megabytes / span : 0.0,
+			requests > 0 ? latency / requests : 0.0,
+			write_pages > 0 ? (double) flash_writes / write_pages : 0.0,
+			ssd.get_num_free_blocks(),
+			stats.numGCCopy - window_stats.numGCCopy,
+			stats.numFTLErase - window_stats.numFTLErase,
+			lookups > 0 ? (double) hits / lookups : 0.0);
+	rows++;
+}
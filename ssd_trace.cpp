@@ -0,0 +1,288 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_trace.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Trace_writer and Trace_reader classes
+ *
+ * A binary trace is parsed once, when it is written; replaying it only walks
+ * the mapped records.  The reader advises sequential access for the whole
+ * file and asks for the next READ_AHEAD bytes whenever it gets close to the
+ * end of the last request, so multi-GB traces stream from disk while the
+ * simulator runs. */
+
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+static const char TRACE_MAGIC[8] = {'F', 'S', 'T', 'R', 'A', 'C', 'E', '1'};
+static const size_t TRACE_HEADER = sizeof(TRACE_MAGIC) + sizeof(uint64_t);
+static const size_t READ_AHEAD = 8 << 20;
+
+Trace_writer::Trace_writer(void):
+	file(NULL),
+	count(0),
+	last_time(0.0),
+	failed(false)
+{}
+
+Trace_writer::~Trace_writer(void)
+{
+	close();
+}
+
+enum status Trace_writer::create(const char *filename)
+{
+	close();
+	count = 0;
+	last_time = 0.0;
+	failed = false;
+	if ((file = fopen(filename, "wb")) == NULL)
+	{
+		fprintf(stderr, "Trace_writer error: %s: cannot create %s: %s\n", __func__, filename, strerror(errno));
+		failed = true;
+		return FAILURE;
+	}
+
+	/* the record count is filled in by close() */
+	uint64_t records = 0;
+	if (fwrite(TRACE_MAGIC, sizeof(TRACE_MAGIC), 1, file) != 1 || fwrite(&records, sizeof(records), 1, file) != 1)
+		failed = true;
+	return failed ? FAILURE : SUCCESS;
+}
+
+/* Appends a request arriving at time, which must not precede the previous
+ * request */
+void Trace_writer::write(enum event_type type, ulong logical_address, uint size, double time)
+{
+	if (failed || file == NULL)
+	{
+		failed = true;
+		return;
+	}
+
+	Trace_record record;
+	record.type = type;
+	record.size = size;
+	record.logical_address = logical_address;
+	record.delta = time - last_time;
+	if (fwrite(&record, sizeof(record), 1, file) != 1)
+	{
+		fprintf(stderr, "Trace_writer error: %s: %s\n", __func__, strerror(errno));
+		failed = true;
+		return;
+	}
+	last_time = time;
+	count++;
+}
+
+enum status Trace_writer::append_uflip(const char *filename)
+{
+	FILE *text = fopen(filename, "r");
+	if (text == NULL)
+	{
+		fprintf(stderr, "Trace_writer error: %s: cannot open %s: %s\n", __func__, filename, strerror(errno));
+		failed = true;
+		return FAILURE;
+	}
+
+	char *line = NULL;
+	size_t capacity = 0;
+	ulong line_number = 0;
+	ulong skipped = 0;
+	while (getline(&line, &capacity, text) != -1 && !failed)
+	{
+		char pattern, io_type;
+		long address;
+		uint query_time;
+		int size;
+		double time;
+
+		line_number++;
+		if (sscanf(line, "%c; %c; %li; %u; %i; %lf", &pattern, &io_type, &address, &query_time, &size, &time) != 6
+				|| (io_type != 'R' && io_type != 'W') || size <= 0)
+		{
+			if (skipped++ == 0)
+				fprintf(stderr, "Trace_writer error: %s: %s:%lu: skipping malformed request\n", __func__, filename, line_number);
+			continue;
+		}
+		write(io_type == 'R' ? READ : WRITE, address, size, time);
+	}
+	free(line);
+	fclose(text);
+
+	if (skipped > 1)
+		fprintf(stderr, "Trace_writer error: %s: %s: skipped %lu malformed requests\n", __func__, filename, skipped);
+	return failed ? FAILURE : SUCCESS;
+}
+
+enum status Trace_writer::close(void)
+{
+	if (file == NULL)
+		return failed ? FAILURE : SUCCESS;
+
+	uint64_t records = count;
+	if (!failed && (fseek(file, sizeof(TRACE_MAGIC), SEEK_SET) != 0 || fwrite(&records, sizeof(records), 1, file) != 1))
+		failed = true;
+	if (fclose(file) != 0)
+		failed = true;
+	file = NULL;
+	if (failed)
+		fprintf(stderr, "Trace_writer error: %s: trace is incomplete\n", __func__);
+	return failed ? FAILURE : SUCCESS;
+}
+
+ulong Trace_writer::size(void) const
+{
+	return count;
+}
+
+Trace_reader::Trace_reader(void):
+	data(NULL),
+	length(0),
+	records(NULL),
+	count(0),
+	position(0),
+	advised(0),
+	time(0.0)
+{}
+
+Trace_reader::~Trace_reader(void)
+{
+	close();
+}
+
+/* Whether filename starts like a binary trace */
+bool Trace_reader::is_trace(const char *filename)
+{
+	char magic[sizeof(TRACE_MAGIC)];
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL)
+		return false;
+	bool match = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0;
+	fclose(file);
+	return match;
+}
+
+enum status Trace_reader::open(const char *filename)
+{
+	close();
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Trace_reader error: %s: cannot open %s: %s\n", __func__, filename, strerror(errno));
+		return FAILURE;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t) info.st_size < TRACE_HEADER)
+	{
+		fprintf(stderr, "Trace_reader error: %s: %s is not a trace\n", __func__, filename);
+		::close(fd);
+		return FAILURE;
+	}
+
+	void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		fprintf(stderr, "Trace_reader error: %s: cannot map %s: %s\n", __func__, filename, strerror(errno));
+		return FAILURE;
+	}
+	data = (char *) mapping;
+	length = info.st_size;
+
+	uint64_t records;
+	memcpy(&records, data + sizeof(TRACE_MAGIC), sizeof(records));
+	if (memcmp(data, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || records > (length - TRACE_HEADER) / sizeof(Trace_record))
+	{
+		fprintf(stderr, "Trace_reader error: %s: %s is not a trace of this version or is truncated\n", __func__, filename);
+		close();
+		return FAILURE;
+	}
+	this->records = (const Trace_record *) (data + TRACE_HEADER);
+	count = records;
+
+	madvise(data, length, MADV_SEQUENTIAL);
+	rewind();
+	return SUCCESS;
+}
+
+void Trace_reader::close(void)
+{
+	if (data != NULL)
+		munmap(data, length);
+	data = NULL;
+	length = 0;
+	records = NULL;
+	count = 0;
+	position = 0;
+	advised = 0;
+	time = 0.0;
+}
+
+ulong Trace_reader::size(void) const
+{
+	return count;
+}
+
+/* Starts over at the first record */
+void Trace_reader::rewind(void)
+{
+	position = 0;
+	advised = 0;
+	time = 0.0;
+	if (data != NULL)
+		read_ahead();
+}
+
+/* Returns the next record, or NULL after the last one */
+const Trace_record *Trace_reader::next(void)
+{
+	if (position >= count)
+		return NULL;
+	if (position >= advised)
+		read_ahead();
+	const Trace_record *record = &records[position++];
+	time += record->delta;
+	return record;
+}
+
+double Trace_reader::get_time(void) const
+{
+	return time;
+}
+
+/* Asks for the READ_AHEAD bytes after the current record; the next call
+ * comes when half of them are consumed */
+void Trace_reader::read_ahead(void)
+{
+	static const size_t page_size = sysconf(_SC_PAGESIZE);
+
+	size_t start = TRACE_HEADER + position * sizeof(Trace_record);
+	size_t end = std::min(start + READ_AHEAD, length);
+	start -= start % page_size;
+	madvise(data + start, end - start, MADV_WILLNEED);
+	advised = position + READ_AHEAD / 2 / sizeof(Trace_record);
+}
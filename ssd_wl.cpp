@@ -20,9 +20,14 @@
 /* Wear_leveler class
  * Brendan Tauras 2009-11-04
  *
- * This class is a stub class for the user to use as a template for implementing
- * his/her wear leveler scheme.  The wear leveler class was added to simplify
- * and modularize the wear-leveling in FTL schemes. */
+ * The wear leveler class was added to simplify and modularize the
+ * wear-leveling in FTL schemes.
+ *
+ * Dynamic wear leveling: erased blocks are kept ordered by erases_remaining,
+ * both globally and per plane, and the block with the most erases remaining
+ * is handed out on allocation (the one with the fewest for static wear
+ * leveling).  Blocks do not change wear while they are in the free pool, so
+ * the order stays valid without re-sorting. */
 
 #include <new>
 #include <assert.h>
@@ -31,9 +36,11 @@
 
 using namespace ssd;
 
-Wear_leveler::Wear_leveler(FtlParent &ftl)
+Wear_leveler::Wear_leveler(FtlParent &ftl):
+	num_allocations(0),
+	num_index_operations(0),
+	num_index_levels(0)
 {
-
 	return;
 }
 
@@ -42,7 +49,133 @@ Wear_leveler::~Wear_leveler(void)
 	return;
 }
 
-enum status Wear_leveler::insert(const Address &address)
+ulong Wear_leveler::get_plane(const Block &block)
+{
+	return block.get_physical_address() / (BLOCK_SIZE * PLANE_SIZE);
+}
+
+/* Counts lookups and updates of the ordered indices and the tree levels
+ * they walk, a balanced tree of the pool's size being assumed.  This is the
+ * allocation path's cost, independent of the host machine. */
+void Wear_leveler::count_index_operations(uint operations)
+{
+	uint levels = 0;
+	for (ulong n = free_blocks.size(); n > 0; n >>= 1)
+		levels++;
+	num_index_operations += operations;
+	num_index_levels += operations * levels;
+}
+
+void Wear_leveler::insert(Block *block)
+{
+	// One update per index
+	count_index_operations(2);
+	free_blocks.insert(block);
+}
+
+/*
+ * Removes and returns the least worn free block, or the most worn one for
+ * cold data moved by static wear leveling.  When a plane is given, only
+ * blocks on that plane are considered and NULL is returned if the plane has
+ * no free block.
+ */
+Block *Wear_leveler::get_free_block(const Address *plane, bool most_worn)
+{
+	Block *block = NULL;
+
+	if (plane == NULL)
+	{
+		FreeByWear &by_wear = free_blocks.get<0>();
+		if (!by_wear.empty())
+		{
+			FreeByWear::iterator it = by_wear.begin();
+			if (!most_worn)
+			{
+				// Take the oldest entry among the least worn to keep FIFO order on ties.
+				count_index_operations(1);
+				it = by_wear.lower_bound((*by_wear.rbegin())->get_erases_remaining());
+			}
+			// An update of each index
+			count_index_operations(2);
+			block = *it;
+			by_wear.erase(it);
+		}
+	}
+	else
+	{
+		FreeByPlane &by_plane = free_blocks.get<1>();
+		ulong plane_index = plane->get_linear_address() / (BLOCK_SIZE * PLANE_SIZE);
+		count_index_operations(1);
+		FreeByPlane::iterator end = by_plane.upper_bound(plane_index);
+		if (end != by_plane.begin())
+		{
+			FreeByPlane::iterator it = end;
+			--it;
+			if (get_plane(**it) == plane_index)
+			{
+				count_index_operations(3);
+				if (most_worn)
+					it = by_plane.lower_bound(plane_index);
+				else
+					it = by_plane.lower_bound(boost::make_tuple(plane_index, (*it)->get_erases_remaining()));
+				block = *it;
+				by_plane.erase(it);
+			}
+		}
+	}
+
+	if (block != NULL)
+		num_allocations++;
+
+	return block;
+}
+
+ulong Wear_leveler::size(void) const
+{
+	return free_blocks.size();
+}
+
+ulong Wear_leveler::get_num_allocations(void) const
+{
+	return num_allocations;
+}
+
+ulong Wear_leveler::get_num_index_operations(void) const
+{
+	return num_index_operations;
+}
+
+ulong Wear_leveler::get_num_index_levels(void) const
+{
+	return num_index_levels;
+}
+
+/* Blocks are stored in wear order.  Both indices break ties by insertion
+ * order and free blocks never change while in the pool, so inserting them
+ * back in this order gives the same hand-out order. */
+void Wear_leveler::save(Snapshot &snapshot) const
+{
+	const FreeByWear &by_wear = free_blocks.get<0>();
+	snapshot.put((ulong) by_wear.size());
+	for (FreeByWear::const_iterator it = by_wear.begin(); it != by_wear.end(); ++it)
+		snapshot.put_block(*it);
+	snapshot.put(num_allocations);
+	snapshot.put(num_index_operations);
+	snapshot.put(num_index_levels);
+}
+
+void Wear_leveler::load(Snapshot &snapshot, FtlParent &ftl)
 {
-	return SUCCESS;
+	free_blocks.clear();
+	ulong count = 0;
+	snapshot.get(count);
+	for (ulong i = 0; i < count && snapshot.good(); i++)
+	{
+		Block *block = snapshot.get_block(ftl);
+		if (block != NULL)
+			free_blocks.insert(block);
+	}
+	snapshot.get(num_allocations);
+	snapshot.get(num_index_operations);
+	snapshot.get(num_index_levels);
 }
@@ -0,0 +1,252 @@
+/* Copyright 2009, 2010 Brendan Tauras */
+
+/* ssd_workload.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Generator classes
+ *
+ * Synthetic workloads for the benchmark drivers.  Addresses are 64-bit and
+ * drawn without modulo bias, so working sets past 2^31 pages are fine. */
+
+#include <math.h>
+#include <assert.h>
+#include <algorithm>
+#include "ssd.h"
+
+using namespace ssd;
+
+Generator::Generator(ulong pages, double write_ratio, uint64_t seed, double gap):
+	random(seed),
+	pages(pages),
+	write_ratio(write_ratio),
+	trim_ratio(0.0),
+	gap(gap),
+	time(0.0)
+{}
+
+Generator::~Generator(void)
+{}
+
+void Generator::next_batch(std::vector<Trace_request> &batch, uint n)
+{
+	batch.resize(n);
+	for (uint i = 0; i < n; i++)
+	{
+		Trace_request &request = batch[i];
+		request.logical_address = next_address();
+		/* one draw picks the type, so without trims the stream is unchanged */
+		double u = random.uniform();
+		request.type = u < write_ratio ? WRITE : (u < write_ratio + trim_ratio ? TRIM : READ);
+		request.size = 1;
+		request.time = time;
+		time += gap;
+	}
+}
+
+/* Arrival time of the next request */
+void Generator::set_time(double time)
+{
+	this->time = time;
+}
+
+double Generator::get_time(void) const
+{
+	return time;
+}
+
+/* Changes the mix of later requests without restarting the address stream */
+void Generator::set_write_ratio(double write_ratio)
+{
+	this->write_ratio = write_ratio;
+}
+
+/* Trims take their share from the reads; write_ratio + trim_ratio <= 1 */
+void Generator::set_trim_ratio(double trim_ratio)
+{
+	this->trim_ratio = trim_ratio;
+}
+
+ulong Generator::get_pages(void) const
+{
+	return pages;
+}
+
+Uniform_generator::Uniform_generator(ulong pages, double write_ratio, uint64_t seed, double gap):
+	Generator(pages, write_ratio, seed, gap)
+{}
+
+ulong Uniform_generator::next_address(void)
+{
+	return random.below(pages);
+}
+
+/* helper1(x) = log(1 + x) / x and helper2(x) = (exp(x) - 1) / x, with
+ * Taylor series near 0 where the quotients lose precision */
+static double helper1(double x)
+{
+	if (fabs(x) > 1e-8)
+		return log1p(x) / x;
+	return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+static double helper2(double x)
+{
+	if (fabs(x) > 1e-8)
+		return expm1(x) / x;
+	return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+}
+
+Zipf_generator::Zipf_generator(ulong pages, double exponent, double write_ratio, uint64_t seed, double gap):
+	Generator(pages, write_ratio, seed, gap),
+	exponent(exponent)
+{
+	assert(pages > 0 && exponent > 0.0);
+	h_integral_x1 = h_integral(1.5) - 1.0;
+	h_integral_n = h_integral(pages + 0.5);
+	s = 2.0 - h_integral_inverse(h_integral(2.5) - h(2.0));
+}
+
+/* h(x) = 1 / x^exponent, the unnormalized probability of rank x */
+double Zipf_generator::h(double x) const
+{
+	return exp(-exponent * log(x));
+}
+
+/* integral of h from 1 to x, shifted so that it is continuous in exponent */
+double Zipf_generator::h_integral(double x) const
+{
+	double log_x = log(x);
+	return helper2((1.0 - exponent) * log_x) * log_x;
+}
+
+double Zipf_generator::h_integral_inverse(double x) const
+{
+	double t = x * (1.0 - exponent);
+	if (t < -1.0)
+		t = -1.0;
+	return exp(helper1(t) * x);
+}
+
+/* draws a rank in [1, pages] by inverting h_integral at a uniform point and
+ * accepting it if the point falls under the histogram bar of the rank */
+ulong Zipf_generator::next_address(void)
+{
+	for (;;)
+	{
+		double u = h_integral_n + random.uniform() * (h_integral_x1 - h_integral_n);
+		double x = h_integral_inverse(u);
+		double k = floor(x + 0.5);
+		if (k < 1.0)
+			k = 1.0;
+		else if (k > pages)
+			k = pages;
+		if (k - x <= s || u >= h_integral(k + 0.5) - h(k))
+			return (ulong) k - 1;
+	}
+}
+
+Hot_cold_generator::Hot_cold_generator(ulong pages, double hot_fraction, double hot_access, double write_ratio, uint64_t seed, double gap):
+	Generator(pages, write_ratio, seed, gap),
+	hot_pages((ulong) (hot_fraction * pages)),
+	hot_access(hot_access)
+{
+	if (hot_pages < 1)
+		hot_pages = 1;
+	if (hot_pages > pages)
+		hot_pages = pages;
+}
+
+ulong Hot_cold_generator::next_address(void)
+{
+	if (hot_pages == pages || random.uniform() < hot_access)
+		return random.below(hot_pages);
+	return hot_pages + random.below(pages - hot_pages);
+}
+
+Stride_generator::Stride_generator(ulong pages, ulong stride, double write_ratio, uint64_t seed, double gap, ulong start):
+	Generator(pages, write_ratio, seed, gap),
+	stride(stride % pages),
+	position(start % pages)
+{}
+
+ulong Stride_generator::next_address(void)
+{
+	ulong address = position;
+	position = stride < pages - position ? position + stride : position - (pages - stride);
+	return address;
+}
+
+Phase_generator::Phase_generator(void):
+	Generator(0, 0.0, 1),
+	phase(0),
+	done(0)
+{}
+
+Phase_generator::~Phase_generator(void)
+{
+	for (uint i = 0; i < phases.size(); i++)
+		delete phases[i];
+}
+
+void Phase_generator::add_phase(Generator *generator, ulong requests)
+{
+	if (generator == NULL || requests == 0)
+	{
+		fprintf(stderr, "Phase_generator error: %s: a phase needs a generator and at least one request\n", __func__);
+		delete generator;
+		return;
+	}
+	phases.push_back(generator);
+	lengths.push_back(requests);
+	pages = std::max(pages, generator->get_pages());
+}
+
+void Phase_generator::next_batch(std::vector<Trace_request> &batch, uint n)
+{
+	batch.resize(n);
+	if (phases.empty())
+	{
+		fprintf(stderr, "Phase_generator error: %s: no phases\n", __func__);
+		batch.clear();
+		return;
+	}
+
+	uint filled = 0;
+	while (filled < n)
+	{
+		uint count = (uint) std::min((ulong) (n - filled), lengths[phase] - done);
+		phases[phase]->set_time(time);
+		phases[phase]->next_batch(chunk, count);
+		time = phases[phase]->get_time();
+		std::copy(chunk.begin(), chunk.end(), batch.begin() + filled);
+		filled += count;
+
+		done += count;
+		if (done == lengths[phase])
+		{
+			done = 0;
+			phase = (phase + 1) % phases.size();
+		}
+	}
+}
+
+/* the phases draw the addresses */
+ulong Phase_generator::next_address(void)
+{
+	assert(false);
+	return 0;
+}